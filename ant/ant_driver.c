@@ -2,6 +2,7 @@
 #include "ant_driver.h"
 #include <ant_interface.h>
 #include <ant_parameters.h>
+#include <app_util.h>
 #include "util.h"
 #include "app.h"
 
@@ -10,6 +11,8 @@
 #define HLO_ANT_NETWORK_PERIOD 128
 #define HLO_ANT_NETWORK_PERIOD_BIAS 8
 #define HLO_ANT_CHANNEL_EXT_OPT 0
+//pages per burst transfer, the buffer stays with the softdevice until the transfer ends
+#define HLO_ANT_BURST_MAX_PACKETS 8
 typedef struct{
     //cached status
     uint8_t reserved;
@@ -27,6 +30,11 @@ static struct{
     hlo_ant_role role;
     volatile bool reliable_mode;
     const hlo_ant_event_listener_t * event_listener;
+#ifdef ANT_PACKET_BURST
+    uint8_t burst_buf[HLO_ANT_BURST_MAX_PACKETS * 8];
+    //bit per channel with a burst in flight, set on request, cleared when the transfer ends
+    volatile uint8_t burst_busy;
+#endif
 }self;
 
 static void _handle_tx(uint8_t channel, const hlo_ant_device_t * dev);
@@ -101,6 +109,9 @@ int32_t hlo_ant_init(hlo_ant_role role, const hlo_ant_event_listener_t * user){
     }
     self.role = role;
     self.event_listener = user;
+#ifdef ANT_PACKET_BURST
+    self.burst_busy = 0;
+#endif
     if(role == HLO_ANT_ROLE_CENTRAL){
         APP_OK(sd_ant_lib_config_set(ANT_LIB_CONFIG_MESG_OUT_INC_DEVICE_ID | ANT_LIB_CONFIG_MESG_OUT_INC_RSSI | ANT_LIB_CONFIG_MESG_OUT_INC_TIME_STAMP));
         PRINTS("Configured as ANT Central\r\n");
@@ -224,9 +235,41 @@ _handle_rx(uint8_t * msg_buffer, const hlo_ant_device_t * device, bool * ack){
     self.event_listener->on_rx_event(device, rx_payload, 8, self.role, ack);
 }
 
+#ifdef ANT_PACKET_BURST
+static void
+_set_burst_busy(uint8_t channel, bool busy){
+    CRITICAL_REGION_ENTER();
+    if(busy){
+        self.burst_busy |= (1 << channel);
+    }else{
+        self.burst_busy &= ~(1 << channel);
+    }
+    CRITICAL_REGION_EXIT();
+}
+#endif
+
 static void  //peripheral tx mode
 _handle_tx(uint8_t channel, const hlo_ant_device_t * dev){
     uint8_t out_buf[8] = {0};
+#ifdef ANT_PACKET_BURST
+    //the channel is busy until the burst ends, and the packet layer hears how it went first
+    if(self.burst_busy & (1 << channel)){
+        return;
+    }
+    //bursts need the peer listening, only on full duplex channels
+    //the one buffer stays with the softdevice, one burst at a time
+    if(self.reliable_mode && self.event_listener->on_burst_event && !self.burst_busy){
+        uint8_t count = self.event_listener->on_burst_event(dev, self.burst_buf, HLO_ANT_BURST_MAX_PACKETS);
+        if(count){
+            if(NRF_SUCCESS == sd_ant_burst_handler_request(channel, count * 8, self.burst_buf, BURST_SEGMENT_START | BURST_SEGMENT_END)){
+                _set_burst_busy(channel, true);
+                return;
+            }
+            //the packet layer goes back to lockstep on the same pages
+            self.event_listener->on_error_event(dev, HLO_ANT_EVENT_TX_FAILED);
+        }
+    }
+#endif
     if(self.event_listener->on_tx_event(dev, out_buf, self.role, self.reliable_mode)){
         if(self.reliable_mode){
             sd_ant_acknowledge_message_tx(channel, 8, out_buf);
@@ -271,13 +314,29 @@ void ant_handler(ant_evt_t * p_ant_evt){
                 }
             }
             break;
+        case EVENT_TRANSFER_TX_COMPLETED:
+            DEBUGS("TDONE\r\n");
+#ifdef ANT_PACKET_BURST
+            _set_burst_busy(ant_channel, false);
+#endif
+            break;
         case EVENT_TRANSFER_TX_FAILED:
+            DEBUGS("TFAIL\r\n");
+#ifdef ANT_PACKET_BURST
+            _set_burst_busy(ant_channel, false);
+#endif
+            if( _parse_device(ant_channel, event_message_buffer, &dev, self.role) ){
+                self.event_listener->on_error_event(&dev, HLO_ANT_EVENT_TX_FAILED);
+            }
             break;
         case EVENT_CHANNEL_COLLISION:
             DEBUGS("XX\r\n");
             break;
         case EVENT_CHANNEL_CLOSED:
             DEBUGS("X");
+#ifdef ANT_PACKET_BURST
+            _set_burst_busy(ant_channel, false);
+#endif
             sd_ant_channel_unassign(ant_channel);
             break;
         default:
@@ -30,8 +30,18 @@ typedef struct{
      */
     void (*on_rx_event)(const hlo_ant_device_t * device, uint8_t * buffer, uint8_t buffer_len, hlo_ant_role role, bool * ack);
     void (*on_error_event)(const hlo_ant_device_t * device, uint32_t event);
+    /* optional, tx opportunity for a burst (ANT_PACKET_BURST, full duplex only) */
+    /* while a burst is in flight the channel gets no tx events of either kind,
+     * it ends with the transfer completing or with HLO_ANT_EVENT_TX_FAILED
+     * @param   out_buffer  room for max_packets packets of 8 bytes
+     * @return  packets written, 0 sends the single packet of on_tx_event instead
+     */
+    uint8_t (*on_burst_event)(const hlo_ant_device_t * device, uint8_t * out_buffer, uint8_t max_packets);
 }hlo_ant_event_listener_t;
 
+/* events passed to on_error_event */
+#define HLO_ANT_EVENT_TX_FAILED 1   //acknowledged or burst transfer never acknowledged by the peer
+
 int32_t hlo_ant_init(hlo_ant_role role, const hlo_ant_event_listener_t * callbacks);
 int32_t hlo_ant_connect(const hlo_ant_device_t * device, bool full_duplex);
 int32_t hlo_ant_disconnect(const hlo_ant_device_t * device);
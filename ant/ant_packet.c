@@ -8,8 +8,16 @@
 #define UID2CID(uid) ((uint16_t)uid)
 #define DEFAULT_ANT_RETRANSMIT_COUNT 4
 
-//defines how old a session can be before getting swept
-#define ANT_SESSION_AGE_LIMIT 4
+//defines how many packets (of any device) a session with an unfinished rx object is kept for
+//before another device can take it over
+#define ANT_SESSION_AGE_LIMIT (16 * ANT_PACKET_MAX_CONCURRENT_SESSIONS)
+
+//open addressed index from device number to session, twice the sessions keeps probes short
+#define ANT_SESSION_SLOTS (2 * ANT_PACKET_MAX_CONCURRENT_SESSIONS)
+#define ANT_SESSION_NONE 0xFF
+#if ANT_SESSION_SLOTS >= ANT_SESSION_NONE
+#error "ANT_PACKET_MAX_CONCURRENT_SESSIONS too large for the session index"
+#endif
 
 typedef struct{
     uint8_t page;
@@ -20,12 +28,34 @@ typedef struct{
 typedef struct{
     uint8_t page;
     uint8_t page_count;
-    uint8_t reserved0;
+    uint8_t flags;          //HLO_ANT_HEADER_FLAG_*, legacy peers send and ignore 0
     uint8_t reserved1;
     uint16_t size;
     uint16_t checksum;
 }hlo_ant_header_packet_t;
 
+//header asks for the payload as burst transfers, the central echoes it back on page 0 to agree
+#define HLO_ANT_HEADER_FLAG_BURST 0x01
+//header asks for missing page reports, the central agrees the same way and from then on every echo
+//is {page, 0, flag, first missing page, 32 bit bitmap of missing pages from there}
+#define HLO_ANT_HEADER_FLAG_SELECTIVE 0x02
+//sender listens for the echoes (full duplex), so a central echoes even a pill's pages
+//and the sender only calls the message sent once the central has echoed it all
+#define HLO_ANT_HEADER_FLAG_ACK 0x04
+
+//flags this build agrees to as central
+#ifdef ANT_PACKET_BURST
+#define HLO_ANT_HEADER_FLAG_BURST_AGREED HLO_ANT_HEADER_FLAG_BURST
+#else
+#define HLO_ANT_HEADER_FLAG_BURST_AGREED 0
+#endif
+#ifdef ANT_PACKET_SELECTIVE
+#define HLO_ANT_HEADER_FLAG_SELECTIVE_AGREED HLO_ANT_HEADER_FLAG_SELECTIVE
+#else
+#define HLO_ANT_HEADER_FLAG_SELECTIVE_AGREED 0
+#endif
+#define HLO_ANT_HEADER_FLAGS_AGREED (HLO_ANT_HEADER_FLAG_BURST_AGREED | HLO_ANT_HEADER_FLAG_SELECTIVE_AGREED)
+
 typedef struct{
     uint16_t cid;
     struct{
@@ -37,6 +67,26 @@ typedef struct{
     MSG_Data_t * rx_obj;
     MSG_Data_t * tx_obj;
     uint32_t age;
+    uint8_t newer;      //lru list, ANT_SESSION_NONE at the ends
+    uint8_t older;
+    struct{
+        uint8_t accepted;   //peer agreed to bursts for tx_obj
+        uint8_t start;      //first page of the burst in flight, 0 if none
+    }burst;
+    struct{
+        uint8_t accepted;   //peer reports missing pages for tx_obj
+        uint8_t base;       //first page of the peer's last report, 0 before the first
+        uint8_t last;       //last gap page sent
+        uint8_t silent;     //gap pages sent since the last report
+        uint32_t missing;   //bit n set if page base + n is missing at the peer
+    }selective;
+    struct{
+        uint8_t pages[(ANT_PACKET_MAX_PAGES + 7) / 8];//bit (n - 1) set once page n is in rx_obj
+        uint8_t count;      //distinct pages received
+        uint8_t crc_pages;  //leading pages already run through crc
+        uint16_t crc;       //crc of the first crc_pages pages
+        uint8_t report;     //delivered, the report telling the peer so is still owed
+    }rx;
 }hlo_ant_packet_session_t;
 
 static struct{
@@ -44,10 +94,23 @@ static struct{
     hlo_ant_packet_session_t entries[ANT_PACKET_MAX_CONCURRENT_SESSIONS];
     const hlo_ant_packet_listener * user;
     uint32_t global_age;
+    uint8_t slots[ANT_SESSION_SLOTS];   //session index or ANT_SESSION_NONE
+    uint8_t newest;
+    uint8_t oldest;
+    hlo_ant_packet_stats_t stats;
 }self;
 
 static inline uint16_t _calc_checksum(const MSG_Data_t * data){
-    return (crc16_compute(data->buf, data->len, NULL));
+    uint16_t len;
+    const uint8_t * seg = MSG_Base_Segment(data, 0, &len);
+    uint16_t crc = crc16_compute(seg, len, NULL);
+    uint8_t i;
+    //crc16 carries over between segments of a chain
+    for(i = 1; i < MSG_Base_SegmentCount(data); i++){
+        seg = MSG_Base_Segment(data, i, &len);
+        crc = crc16_compute(seg, len, &crc);
+    }
+    return crc;
 }
 
 static inline void
@@ -70,63 +133,164 @@ _reset_rx_obj(hlo_ant_packet_session_t * session){
     }
     session->rx_obj = NULL;
 }
-//finds session, if not exist allocates one
+static inline uint8_t _home_slot(uint16_t cid){
+    //fibonacci hash of the device number scaled onto the slots
+    return ((uint32_t)(uint16_t)(cid * 40503u) * ANT_SESSION_SLOTS) >> 16;
+}
+//slot holding cid, or the empty slot where it goes
+static uint8_t _find_slot(uint16_t cid){
+    uint8_t i = _home_slot(cid);
+    while(self.slots[i] != ANT_SESSION_NONE && self.entries[self.slots[i]].cid != cid){
+        if(++i == ANT_SESSION_SLOTS){
+            i = 0;
+        }
+    }
+    return i;
+}
+//empties slot i, moving later entries of the probe run back so no tombstones are needed
+static void _unhash(uint8_t i){
+    uint8_t j = i;
+    self.slots[i] = ANT_SESSION_NONE;
+    while(1){
+        uint8_t home;
+        if(++j == ANT_SESSION_SLOTS){
+            j = 0;
+        }
+        if(self.slots[j] == ANT_SESSION_NONE){
+            return;
+        }
+        home = _home_slot(self.entries[self.slots[j]].cid);
+        //entry stays unless its home lies cyclically in (i, j]
+        if( (i <= j) ? (home <= i || home > j) : (home <= i && home > j) ){
+            self.slots[i] = self.slots[j];
+            self.slots[j] = ANT_SESSION_NONE;
+            i = j;
+        }
+    }
+}
+//moves session idx to the newest end of the lru list
+static void _touch(uint8_t idx){
+    hlo_ant_packet_session_t * s = &self.entries[idx];
+    if(self.newest == idx){
+        return;
+    }
+    if(s->older != ANT_SESSION_NONE){
+        self.entries[s->older].newer = s->newer;
+    }else{
+        self.oldest = s->newer;
+    }
+    self.entries[s->newer].older = s->older;
+    s->older = self.newest;
+    s->newer = ANT_SESSION_NONE;
+    self.entries[self.newest].newer = idx;
+    self.newest = idx;
+}
+//moves a session holding nothing to the oldest end, the first one to hand to a new device
+//one still owing the final report stays in lru order, only eviction takes it early
+static void _release_session(hlo_ant_packet_session_t * session){
+    uint8_t idx = session - self.entries;
+    if(session->rx_obj || session->tx_obj || session->rx.report || self.oldest == idx){
+        return;
+    }
+    if(session->newer != ANT_SESSION_NONE){
+        self.entries[session->newer].older = session->older;
+    }else{
+        self.newest = session->older;
+    }
+    self.entries[session->older].newer = session->newer;
+    session->newer = self.oldest;
+    session->older = ANT_SESSION_NONE;
+    self.entries[self.oldest].older = idx;
+    self.oldest = idx;
+}
+static inline hlo_ant_packet_session_t * _use_session(uint8_t idx){
+    self.entries[idx].age = self.global_age;
+    _touch(idx);
+    return &self.entries[idx];
+}
+//finds session, NULL if the device has none
+static inline hlo_ant_packet_session_t *
+_find_session(const hlo_ant_device_t * device){
+    uint8_t idx = self.slots[_find_slot(device->device_number)];
+    ++self.global_age;
+    return (idx == ANT_SESSION_NONE) ? NULL : _use_session(idx);
+}
+//finds session, if not exist takes over the least recently used one
 static inline hlo_ant_packet_session_t *
 _acquire_session(const hlo_ant_device_t * device){
-    int i;
     uint16_t cid = device->device_number;
+    uint8_t slot = _find_slot(cid);
+    uint8_t idx = self.slots[slot];
+    hlo_ant_packet_session_t * session = NULL;
     ++self.global_age;
-    //look for existing session
-    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
-        if(self.entries[i].cid == cid){
-            self.entries[i].age = self.global_age;
-            return &(self.entries[i]);
-        }
+    if(idx != ANT_SESSION_NONE){
+        return _use_session(idx);
     }
-    //look for new session
-    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
-        if(self.entries[i].cid == 0){
-            self.entries[i].cid = cid;
-            self.entries[i].age = self.global_age;
-            _reset_tx_obj(&(self.entries[i]));
-            _reset_rx_obj(&(self.entries[i]));
-            return &(self.entries[i]);
+    //oldest first, sessions still sending are skipped, an unfinished rx object only goes once it is stale
+    for(idx = self.oldest; idx != ANT_SESSION_NONE; idx = self.entries[idx].newer){
+        session = &self.entries[idx];
+        if(!session->tx_obj){
+            break;
         }
     }
-    //look for sessions with no tx or rx objects(expired session)
-    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
-        if(self.entries[i].cid != 0 && !self.entries[i].rx_obj && !self.entries[i].tx_obj){
-            self.entries[i].age = self.global_age;
-            self.entries[i].cid = cid;
-            return &(self.entries[i]);
-        }
+    if(idx == ANT_SESSION_NONE
+            || (session->rx_obj && self.global_age - session->age < ANT_SESSION_AGE_LIMIT)){
+        self.stats.full++;
+        return NULL;
     }
-    //lastly, try look for session with rx object that has age exceeds AGE limit
-    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
-        if(self.entries[i].cid != 0 && !self.entries[i].tx_obj){
-            if(self.global_age - self.entries[i].age >= ANT_SESSION_AGE_LIMIT){
-                _reset_rx_obj(&(self.entries[i]));
-                self.entries[i].age = self.global_age;
-                self.entries[i].cid = cid;
-                return &(self.entries[i]);
-            }
-        }
+    if(session->cid){
+        self.stats.evictions++;
+        _unhash(_find_slot(session->cid));
+        //the slot for cid may have moved up
+        slot = _find_slot(cid);
     }
-    return NULL;
+    if(session->rx_obj){
+        self.stats.dropped++;
+        _reset_rx_obj(session);
+    }
+    memset(&session->rx_header, 0, sizeof(session->rx_header));
+    memset(&session->rx, 0, sizeof(session->rx));
+    session->cid = cid;
+    self.slots[slot] = idx;
+    return _use_session(idx);
 }
 
-static uint8_t _assemble_rx_payload(MSG_Data_t * payload, const hlo_ant_payload_packet_t * packet){
-   uint16_t offset = (packet->page - 1) * 6; 
-   //make sure the offset does not exceed the length
-   uint8_t i;
-   uint8_t len = MIN(6, payload->len - offset);
-   for(i = 0; i < len; i++){
-       payload->buf[offset + i] = packet->payload[i];
-   }
-   return 0;
+static inline bool _has_page(const hlo_ant_packet_session_t * session, uint8_t page){
+    return session->rx.pages[(page - 1) >> 3] & (1 << ((page - 1) & 7));
+}
+static inline void _reset_rx_pages(hlo_ant_packet_session_t * session){
+    memset(&session->rx, 0, sizeof(session->rx));
+}
+//returns false for a copy of a page that is already in
+static bool _assemble_rx_payload(hlo_ant_packet_session_t * session, const hlo_ant_payload_packet_t * packet){
+    MSG_Data_t * payload = session->rx_obj;
+    uint16_t offset = (packet->page - 1) * 6;
+    //the header check makes sure the last page is the only short one
+    uint8_t len = MIN(6, payload->len - offset);
+    if(_has_page(session, packet->page)){
+        if(!memcmp(&payload->buf[offset], packet->payload, len)){
+            return false;
+        }
+        //a different copy means one of them was bad, redo the crc from the start
+        if(session->rx.crc_pages >= packet->page){
+            session->rx.crc_pages = 0;
+        }
+    }else{
+        session->rx.pages[(packet->page - 1) >> 3] |= 1 << ((packet->page - 1) & 7);
+        session->rx.count++;
+    }
+    memcpy(&payload->buf[offset], packet->payload, len);
+    //extend the crc over whatever is contiguous now, every byte normally goes through it once
+    while(session->rx.crc_pages < session->rx_header.page_count && _has_page(session, session->rx.crc_pages + 1)){
+        offset = session->rx.crc_pages * 6;
+        len = MIN(6, payload->len - offset);
+        session->rx.crc = crc16_compute(&payload->buf[offset], len, session->rx.crc_pages ? &session->rx.crc : NULL);
+        session->rx.crc_pages++;
+    }
+    return true;
 }
 static MSG_Data_t * _assemble_rx(hlo_ant_packet_session_t * session, uint8_t * buffer, uint8_t len, bool * out_has_new_obj){
-    //this function still uses the legacy way of counting packets (total received >= header max -> crc check -> produce object)
+    //this function still uses the legacy way of counting packets (all pages received -> crc check -> produce object)
     //rather than using lockstep mode (rx page == header max) for backward compatibility reasons
     hlo_ant_payload_packet_t * packet = (hlo_ant_payload_packet_t*)buffer;
 
@@ -134,43 +298,125 @@ static MSG_Data_t * _assemble_rx(hlo_ant_packet_session_t * session, uint8_t * b
     //1. check if it's a header packet
         //1.a now check if it's the same object as before
         uint16_t new_crc = (uint16_t)(buffer[7] << 8) | buffer[6];
-        if( new_crc != session->rx_header.checksum ){
+        //a taken over session has a zeroed header, a message whose crc is 0 is new to it too
+        if( new_crc != session->rx_header.checksum || !session->rx_header.page_count ){
             memcpy(&session->rx_header, buffer, sizeof(hlo_ant_header_packet_t));
-            if(session->rx_header.size <= MSG_Base_FreeCount() && session->rx_header.size != 0){
-                _reset_rx_obj(session);//this is just to refresh any stale objects that hasn't been completed
+            _reset_rx_pages(session);
+            _reset_rx_obj(session);//this is just to refresh any stale objects that hasn't been completed
+            if(session->rx_header.size <= MSG_Base_LargestFree() && session->rx_header.size != 0
+                    && session->rx_header.page_count <= ANT_PACKET_MAX_PAGES
+                    && session->rx_header.page_count == (session->rx_header.size + 5) / 6){
                 session->rx_obj = MSG_Base_AllocateDataAtomic(session->rx_header.size);
                 if ( out_has_new_obj ){
                     *out_has_new_obj = true;
                 }
             }
+            if(!session->rx_obj){
+                //its copies and pages are ignored until another header comes
+                self.stats.refused++;
+            }
+        }else{
+            //the same object sent again, it may want the echo this time
+            session->rx_header.flags = (session->rx_header.flags & ~HLO_ANT_HEADER_FLAG_ACK)
+                | (buffer[2] & HLO_ANT_HEADER_FLAG_ACK);
         }
     }else if(session->rx_obj && packet->page && packet->page_count && packet->page <= session->rx_header.page_count){
     //2. if an object already exists, and the bounds make sense
-        _assemble_rx_payload(session->rx_obj,packet);
-        if(_calc_checksum(session->rx_obj) == session->rx_header.checksum){
-            return session->rx_obj;
+        //retransmitted copies cost a compare, no crc
+        if(_assemble_rx_payload(session, packet) && session->rx.count == session->rx_header.page_count){
+            if(session->rx.crc == session->rx_header.checksum){
+                return session->rx_obj;
+            }
+#ifdef ANT_PACKET_SELECTIVE
+            //a reporting peer only resends what is missing, so all of it is
+            if(session->rx_header.flags & HLO_ANT_HEADER_FLAG_SELECTIVE){
+                _reset_rx_pages(session);
+            }
+#endif
         }
     }
     return NULL;
 }
-static void _write_buffer(const hlo_ant_packet_session_t * session, uint8_t * out_buffer){
-    int i;
-    if(session->lockstep.page == 0){
+static void _write_buffer(const hlo_ant_packet_session_t * session, uint8_t page, uint8_t * out_buffer){
+    if(page == 0){
         memcpy(out_buffer, &session->tx_header, 8);
     }else{
-        out_buffer[0] = session->lockstep.page;
+        out_buffer[0] = page;
         out_buffer[1] = session->tx_header.page_count;
-        uint16_t offset = (session->lockstep.page - 1) * 6;
-        for(i = 0; i < 6; i++){
-            if(offset + i < session->tx_obj->len){
-                out_buffer[2+i] = session->tx_obj->buf[offset+i];
-            }else{
-                out_buffer[2+i] = 0;
+        uint16_t offset = (page - 1) * 6;
+        uint16_t copied = MSG_Base_Read(session->tx_obj, offset, &out_buffer[2], 6);
+        //unused payload must be set to 0
+        memset(&out_buffer[2 + copied], 0, 6 - copied);
+    }
+
+}
+#ifdef ANT_PACKET_SELECTIVE
+//central side report of the pages still missing, the first page past the end once delivered
+static void _write_missing(const hlo_ant_packet_session_t * session, uint8_t * out_buffer){
+    uint8_t base, i;
+    uint32_t missing = 0;
+    if(!session->rx_obj){
+        //nothing to report on a header we could not take
+        if(!session->rx_header.page_count || session->rx.count != session->rx_header.page_count){
+            return;
+        }
+        base = session->rx_header.page_count + 1;
+    }else{
+        for(base = 1; base <= session->rx_header.page_count && _has_page(session, base); base++){
+        }
+        for(i = 0; i < 32 && base + i <= session->rx_header.page_count; i++){
+            if(!_has_page(session, base + i)){
+                missing |= 1UL << i;
             }
         }
     }
-
+    out_buffer[2] |= HLO_ANT_HEADER_FLAG_SELECTIVE;
+    out_buffer[3] = base;
+    out_buffer[4] = missing & 0xFF;
+    out_buffer[5] = (missing >> 8) & 0xFF;
+    out_buffer[6] = (missing >> 16) & 0xFF;
+    out_buffer[7] = missing >> 24;
 }
+//next page the peer reported missing after the last one sent, pages past the bitmap count as missing
+static uint8_t _next_missing(hlo_ant_packet_session_t * session){
+    uint8_t base = session->selective.base;
+    uint8_t page = session->selective.last;
+    uint8_t i;
+    if(!base){
+        //no report yet, the last page asks for one
+        return session->tx_header.page_count;
+    }
+    for(i = 0; i < session->tx_header.page_count; i++){
+        if(++page < base || page > session->tx_header.page_count){
+            page = base;
+        }
+        if(page - base >= 32 || (session->selective.missing & (1UL << (page - base)))){
+            break;
+        }
+    }
+    session->selective.last = page;
+    return page;
+}
+//every page once, then only the gaps until the peer reports it all in
+static bool _handle_selective_tx(const hlo_ant_device_t * device, hlo_ant_packet_session_t * session, uint8_t * out_buffer){
+    if(session->lockstep.page <= session->tx_header.page_count){
+        _write_buffer(session, session->lockstep.page++, out_buffer);
+        return true;
+    }
+    if(session->selective.base > session->tx_header.page_count){
+        self.user->on_message_sent(device, session->tx_obj);
+        _reset_tx_obj(session);
+        return false;
+    }
+    if(session->selective.silent++ >= DEFAULT_ANT_RETRANSMIT_COUNT){
+        self.user->on_message_failed(device, session->tx_obj);
+        _reset_tx_obj(session);
+        return false;
+    }
+    _write_buffer(session, _next_missing(session), out_buffer);
+    return true;
+}
+#endif
 static bool _handle_tx(const hlo_ant_device_t * device, uint8_t * out_buffer, hlo_ant_role role, bool lockstep){
     hlo_ant_packet_session_t * session = _acquire_session(device);
     if(!session){
@@ -184,13 +430,35 @@ static bool _handle_tx(const hlo_ant_device_t * device, uint8_t * out_buffer, hl
 
     if(role == HLO_ANT_ROLE_CENTRAL){
         if(session->tx_obj){
-            _write_buffer(session, out_buffer);
+            _write_buffer(session, session->lockstep.page, out_buffer);
+        }
+#if defined(ANT_PACKET_BURST) || defined(ANT_PACKET_SELECTIVE)
+        else{
+            //agree only without a message of our own, its pages follow the peer's page counter
+            if(session->lockstep.page == 0 && session->rx_obj){
+                out_buffer[2] = session->rx_header.flags & HLO_ANT_HEADER_FLAGS_AGREED;
+            }
+#ifdef ANT_PACKET_SELECTIVE
+            if(session->rx_header.flags & HLO_ANT_HEADER_FLAG_SELECTIVE){
+                _write_missing(session, out_buffer);
+                if(session->rx.report){
+                    session->rx.report = 0;
+                    _release_session(session);
+                }
+            }
+#endif
         }
+#endif
     }else if(role == HLO_ANT_ROLE_PERIPHERAL){
+#ifdef ANT_PACKET_SELECTIVE
+        if(session->tx_obj && session->selective.accepted){
+            return _handle_selective_tx(device, session, out_buffer);
+        }
+#endif
         if(session->lockstep.retry--){
             if(session->tx_obj){
                 if( session->lockstep.page <= session->tx_header.page_count ){
-                    _write_buffer(session, out_buffer);
+                    _write_buffer(session, session->lockstep.page, out_buffer);
                 }else{
                     self.user->on_message_sent(device, session->tx_obj);
                     _reset_tx_obj(session);
@@ -212,6 +480,35 @@ static bool _handle_tx(const hlo_ant_device_t * device, uint8_t * out_buffer, hl
     return true;
 }
 
+#ifdef ANT_PACKET_BURST
+//streams the pages from the lockstep page on, the peer's echo of the last one moves lockstep past them
+static uint8_t _handle_burst(const hlo_ant_device_t * device, uint8_t * out_buffer, uint8_t max_packets){
+    hlo_ant_packet_session_t * session = _find_session(device);
+    uint8_t i, count;
+    if(!session || !session->tx_obj || !session->burst.accepted || session->burst.start
+            || session->lockstep.page == 0 || session->lockstep.page > session->tx_header.page_count){
+        return 0;
+    }
+    count = MIN(max_packets, session->tx_header.page_count - session->lockstep.page + 1);
+    if(count < 2){
+        return 0;
+    }
+    for(i = 0; i < count; i++){
+        _write_buffer(session, session->lockstep.page + i, &out_buffer[i * 8]);
+    }
+    session->burst.start = session->lockstep.page;
+#ifdef ANT_PACKET_SELECTIVE
+    if(session->selective.accepted){
+        //the peer's report says what made it, no echo to wait for
+        session->lockstep.page += count;
+    }else
+#endif
+    session->lockstep.page += count - 1;
+    session->lockstep.retry = DEFAULT_ANT_RETRANSMIT_COUNT;
+    return count;
+}
+#endif
+
 static void _set_header(hlo_ant_header_packet_t * header, const MSG_Data_t * msg){
     memset(header, 0, sizeof(*header));
     header->size = msg->len;
@@ -221,8 +518,9 @@ static void _set_header(hlo_ant_header_packet_t * header, const MSG_Data_t * msg
 }
 
 static void _handle_rx(const hlo_ant_device_t * device, uint8_t * buffer, uint8_t buffer_len, hlo_ant_role role, bool * ack){
-    hlo_ant_packet_session_t * session = _acquire_session(device);
     hlo_ant_payload_packet_t * packet = (hlo_ant_payload_packet_t*)buffer;
+    //pages can't complete a message whose header was missed, only a header takes a session over
+    hlo_ant_packet_session_t * session = packet->page ? _find_session(device) : _acquire_session(device);
     bool new_obj = false;//flag that indicates a new object is allocated(connected)
     if(!session){
         return;
@@ -237,10 +535,19 @@ static void _handle_rx(const hlo_ant_device_t * device, uint8_t * buffer, uint8_
     if ( ret_obj ){
         self.user->on_message(device, ret_obj);
         _reset_rx_obj(session);
+#ifdef ANT_PACKET_SELECTIVE
+        //the peer only calls it sent on the report past the last page, which needs this session
+        if(role == HLO_ANT_ROLE_CENTRAL && (session->rx_header.flags & HLO_ANT_HEADER_FLAG_SELECTIVE)){
+            session->rx.report = 1;
+        }
+#endif
     }
+    //retransmits of a delivered message should not keep the session from the next device
+    _release_session(session);
 
     if(role == HLO_ANT_ROLE_CENTRAL){//central receives first, then transmits
-        if( device->device_type == HLO_ANT_DEVICE_TYPE_PILL ){//don't bother acking pill as it decreases rx sensitivity (runs in async mode)
+        //don't bother acking a broadcasting pill as it decreases rx sensitivity (runs in async mode)
+        if( device->device_type == HLO_ANT_DEVICE_TYPE_PILL && !(session->rx_header.flags & HLO_ANT_HEADER_FLAG_ACK) ){
             *ack = false;
             return;
         }
@@ -265,7 +572,35 @@ static void _handle_rx(const hlo_ant_device_t * device, uint8_t * buffer, uint8_
         //as central, we always ack back what we receive
         session->lockstep.page = packet->page;
     }else if(role == HLO_ANT_ROLE_PERIPHERAL) {
+#ifdef ANT_PACKET_SELECTIVE
+        if(session->selective.accepted){
+            //reports replace the lockstep echo, the page counter only runs the first pass
+            if(!packet->page_count && (buffer[2] & HLO_ANT_HEADER_FLAG_SELECTIVE)){
+                session->selective.base = buffer[3];
+                session->selective.missing = buffer[4] | ((uint32_t)buffer[5] << 8)
+                    | ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[7] << 24);
+                session->selective.silent = 0;
+#ifdef ANT_PACKET_BURST
+                session->burst.start = 0;
+#endif
+            }
+            return;
+        }
+#endif
         if( packet->page == session->lockstep.page ){
+#ifdef ANT_PACKET_SELECTIVE
+            if(!packet->page && !packet->page_count && (buffer[2] & HLO_ANT_HEADER_FLAG_SELECTIVE)
+                    && (session->tx_header.flags & HLO_ANT_HEADER_FLAG_SELECTIVE)){
+                session->selective.accepted = 1;
+            }
+#endif
+#ifdef ANT_PACKET_BURST
+            if(!packet->page && !packet->page_count && (buffer[2] & HLO_ANT_HEADER_FLAG_BURST)
+                    && (session->tx_header.flags & HLO_ANT_HEADER_FLAG_BURST)){
+                session->burst.accepted = 1;
+            }
+            session->burst.start = 0;
+#endif
             session->lockstep.page++;
             session->lockstep.retry = DEFAULT_ANT_RETRANSMIT_COUNT;
         }
@@ -273,13 +608,48 @@ static void _handle_rx(const hlo_ant_device_t * device, uint8_t * buffer, uint8_
 
 }
 static void _handle_error(const hlo_ant_device_t * device, uint32_t event){
-
+#ifdef ANT_PACKET_BURST
+    hlo_ant_packet_session_t * session = _find_session(device);
+#ifdef ANT_PACKET_SELECTIVE
+    //the next report names the pages the failed burst lost
+    if(event == HLO_ANT_EVENT_TX_FAILED && session && session->selective.accepted){
+        session->burst.start = 0;
+        return;
+    }
+#endif
+    //a failed burst goes back to its first page in lockstep, the peer's page bitmap keeps what made it
+    if(event == HLO_ANT_EVENT_TX_FAILED && session && session->burst.start){
+        session->lockstep.page = session->burst.start;
+        session->lockstep.retry = DEFAULT_ANT_RETRANSMIT_COUNT;
+        session->burst.start = 0;
+        session->burst.accepted = 0;
+    }
+#endif
 }
 
 hlo_ant_event_listener_t * hlo_ant_packet_init(const hlo_ant_packet_listener * user_listener){
+    uint8_t i;
+    //starts from an empty table, whatever an earlier init left is dropped
+    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
+        _reset_rx_obj(&self.entries[i]);
+        _reset_tx_obj(&self.entries[i]);
+    }
+    memset(self.entries, 0, sizeof(self.entries));
+    memset(&self.stats, 0, sizeof(self.stats));
+    self.global_age = 0;
+    memset(self.slots, ANT_SESSION_NONE, sizeof(self.slots));
+    for(i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++){
+        self.entries[i].older = i ? (i - 1) : ANT_SESSION_NONE;
+        self.entries[i].newer = (i + 1 < ANT_PACKET_MAX_CONCURRENT_SESSIONS) ? (i + 1) : ANT_SESSION_NONE;
+    }
+    self.oldest = 0;
+    self.newest = ANT_PACKET_MAX_CONCURRENT_SESSIONS - 1;
     self.cbs.on_tx_event = _handle_tx;
     self.cbs.on_rx_event = _handle_rx;
     self.cbs.on_error_event = _handle_error;
+#ifdef ANT_PACKET_BURST
+    self.cbs.on_burst_event = _handle_burst;
+#endif
     self.user = user_listener;
     return &self.cbs;
 }
@@ -292,6 +662,21 @@ int hlo_ant_packet_send_message(const hlo_ant_device_t * device, MSG_Data_t * ms
             session->tx_obj = msg;
             MSG_Base_AcquireDataAtomic(msg);
             _set_header(&session->tx_header, msg);
+            memset(&session->burst, 0, sizeof(session->burst));
+            memset(&session->selective, 0, sizeof(session->selective));
+            if(reliable){
+                session->tx_header.flags |= HLO_ANT_HEADER_FLAG_ACK;
+            }
+#ifdef ANT_PACKET_BURST
+            if(reliable && session->tx_header.page_count > 1){
+                session->tx_header.flags |= HLO_ANT_HEADER_FLAG_BURST;
+            }
+#endif
+#ifdef ANT_PACKET_SELECTIVE
+            if(reliable && session->tx_header.page_count > 1){
+                session->tx_header.flags |= HLO_ANT_HEADER_FLAG_SELECTIVE;
+            }
+#endif
             return hlo_ant_connect(device, reliable);
         }else{
             PRINTS("Session Full \r\n");
@@ -300,3 +685,6 @@ int hlo_ant_packet_send_message(const hlo_ant_device_t * device, MSG_Data_t * ms
     }
     return -1;
 }
+void hlo_ant_packet_get_stats(hlo_ant_packet_stats_t * out_stats){
+    *out_stats = self.stats;
+}
@@ -5,17 +5,37 @@
 #include "ant_driver.h"
 #include "message_base.h"
 
+//sessions are looked up by device number through a hash and recycled least recently used first,
+//apps that see many devices raise this in message_config.h
 #ifndef ANT_PACKET_MAX_CONCURRENT_SESSIONS
 #define ANT_PACKET_MAX_CONCURRENT_SESSIONS 2
 #endif
 
+//largest message received, in 6 byte pages, sizes the per session page bitmap
+//the default takes any page count a header can carry (32 bytes a session), the heap is what limits
+//in practice, headers over either are refused and counted in hlo_ant_packet_stats_t.refused
+#ifndef ANT_PACKET_MAX_PAGES
+#define ANT_PACKET_MAX_PAGES 255
+#endif
+#if ANT_PACKET_MAX_PAGES > 255
+#error "ANT page counts are 8 bit"
+#endif
+
 typedef struct{
     MSG_Data_t* INCREF (*on_connect)(const hlo_ant_device_t * device);                          //called when central receives a header packet
     void (*on_message)(const hlo_ant_device_t * device, MSG_Data_t * message);                  //called when device receives a complete message
-    void DECREF (*on_message_sent)(const hlo_ant_device_t * device, MSG_Data_t * message);      //called when messag has been sent
+    void DECREF (*on_message_sent)(const hlo_ant_device_t * device, MSG_Data_t * message);      //called when messag has been sent, full duplex only once the central echoed every page
     void DECREF (*on_message_failed)(const hlo_ant_device_t * device, MSG_Data_t * message);    //called on failed transmission
 }hlo_ant_packet_listener;
 
+typedef struct{
+    uint32_t evictions;     //sessions taken over by another device
+    uint32_t dropped;       //unfinished rx objects released by an eviction
+    uint32_t full;          //packets dropped with every session busy
+    uint32_t refused;       //message headers not taken, malformed, over ANT_PACKET_MAX_PAGES or out of heap
+}hlo_ant_packet_stats_t;
+
 hlo_ant_event_listener_t * hlo_ant_packet_init(const hlo_ant_packet_listener * user_listener);
 //no queue enabled, returns error if sending
 int INCREF hlo_ant_packet_send_message(const hlo_ant_device_t * device, MSG_Data_t * msg, bool full_duplex);
+void hlo_ant_packet_get_stats(hlo_ant_packet_stats_t * out_stats);
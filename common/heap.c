@@ -93,7 +93,7 @@
 
 #define configASSERT(...)
 
-#define portPOINTER_SIZE_TYPE uint32_t
+#define portPOINTER_SIZE_TYPE uintptr_t
 
 #include <stdlib.h>
 
@@ -488,6 +488,33 @@ size_t xPortGetMinimumEverFreeHeapSize( void )
 }
 /*-----------------------------------------------------------*/
 
+size_t xPortGetLargestFreeBlockSize( void )
+{
+BlockLink_t *pxBlock;
+size_t xLargest = 0;
+
+	vTaskSuspendAll();
+	{
+		if( pxEnd == NULL )
+		{
+			prvHeapInit();
+		}
+
+		for( pxBlock = xStart.pxNextFreeBlock; pxBlock != pxEnd; pxBlock = pxBlock->pxNextFreeBlock )
+		{
+			if( pxBlock->xBlockSize > xLargest )
+			{
+				xLargest = pxBlock->xBlockSize;
+			}
+		}
+	}
+	xTaskResumeAll();
+
+	/* Block sizes are aligned, anything up to the block less its header fits. */
+	return ( xLargest > heapSTRUCT_SIZE ) ? ( xLargest - heapSTRUCT_SIZE ) : 0;
+}
+/*-----------------------------------------------------------*/
+
 static void prvHeapInit( void )
 {
 BlockLink_t *pxFirstFreeBlock;
@@ -71,7 +71,7 @@
  * See heap_1.c, heap_2.c and heap_3.c for alternative implementations, and the
  * memory management pages of http://www.FreeRTOS.org for more information.
  */
-typedef unsigned int size_t;
+#include <stddef.h>
 #include "platform.h"
 
 void *pvPortRealloc( void *pv, size_t xWantedSize );
@@ -80,3 +80,5 @@ void vPortFree( void *pv );
 
 size_t xPortGetFreeHeapSize( void );
 size_t xPortGetMinimumEverFreeHeapSize( void );
+/* largest request pvPortMalloc() can serve right now, unlike the free size this sees fragmentation */
+size_t xPortGetLargestFreeBlockSize( void );
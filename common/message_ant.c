@@ -1,23 +1,29 @@
+#include <app_util.h>
 #include "message_ant.h"
 #include "util.h"
-#include "hlo_queue.h"
+#include "message_queue.h"
 #include <string.h>
+#include <stddef.h>
 
 static struct{
     MSG_Central_t * parent;
     MSG_Base_t base;
     const MSG_ANTHandler_t * user_handler;
     hlo_ant_packet_listener message_listener;
-    hlo_queue_t * tx_queue;
+    MSG_Queue_t * tx_queue;
     hlo_ant_role role;
     hlo_ant_device_t local_device;
+    //received messages waiting for the scheduler, shared by the ant event path and the handler
+    MSG_ANT_Message_t rx_pending[MSG_ANT_RX_PENDING];
+    uint8_t rx_head;
+    uint8_t rx_count;
+    MSG_ANT_RxStats_t rx_stats;
+    //submodule the open channel was opened for, failures go again the same way
+    uint8_t tx_mode;
+    uint8_t tx_open;
 }self;
 static char * name = "ANT";
 
-typedef struct{
-    MSG_Data_t * msg;
-}queue_message_t;
-
 static MSG_Data_t INCREF * _AllocateAntPacket(MSG_ANT_PillDataType_t type, size_t payload_size);
 
 static MSG_Status
@@ -31,21 +37,44 @@ _flush(void){
 static void _handle_message(const hlo_ant_device_t * device, MSG_Data_t * message){
     self.user_handler->on_message(device, message);
 }
+/*
+ * periodic status only matters in its latest version, queued ones are replaced
+ * motion data is never coalesced
+ */
+static uint8_t
+_coalesce_tag(uint8_t type){
+    switch(type){
+        case ANT_PILL_HEARTBEAT:
+        case ANT_PILL_PROX_ENCRYPTED:
+        case ANT_PILL_PROX_PLAINTEXT:
+            return type;
+        default:
+            return MSG_QUEUE_NO_TAG;
+    }
+}
 static uint32_t
-_queue_tx(MSG_Data_t * o){
-    queue_message_t msg = (queue_message_t){
-        .msg = o,
-    };
-    if( hlo_queue_empty_size(self.tx_queue) >= sizeof(msg) ){
+_queue_tx(MSG_Data_t * o, MSG_Address_t dst){
+    uint8_t type = 0xFF;
+    MSG_Base_Read(o, offsetof(MSG_ANT_PillData_t, type), &type, sizeof(type));
+    if( MSG_Queue_PushTagged(self.tx_queue, o, dst, _coalesce_tag(type)) ){
         PRINTS("Queue\r\n");
-        return hlo_queue_write(self.tx_queue, (unsigned char*)&msg, sizeof(msg));
-    }else{
-        return 1;
+        return 0;
     }
-    return 0;
+    return 1;
 }
 static int32_t _try_send_ant_peripheral(MSG_Data_t * data, bool reliable){
-    return hlo_ant_packet_send_message(&self.local_device, data, reliable);
+    int32_t ret;
+    //the channel keeps its mode until the queue runs dry and it closes, a full duplex
+    //message on a broadcast channel is not reported delivered and its sender tries again
+    if(self.tx_open){
+        reliable = (self.tx_mode == MSG_ANT_TRANSMIT_RECEIVE);
+    }
+    ret = hlo_ant_packet_send_message(&self.local_device, data, reliable);
+    if(ret >= 0){
+        self.tx_mode = reliable ? MSG_ANT_TRANSMIT_RECEIVE : MSG_ANT_TRANSMIT;
+        self.tx_open = 1;
+    }
+    return ret;
 }
 static MSG_Status
 _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
@@ -55,9 +84,30 @@ _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
             break;
         case MSG_ANT_HANDLE_MESSAGE:
             if(data){
-                MSG_ANT_Message_t * msg = (MSG_ANT_Message_t *)data->buf;
-                _handle_message(&msg->device, msg->message);
-                MSG_Base_ReleaseDataAtomic(msg->message);
+                hlo_ant_device_t device;
+                uint8_t lost = 0;
+                bool match = false;
+                //entries are dispatched in ring order, any ahead of this one had their dispatch lost
+                CRITICAL_REGION_ENTER();
+                while(self.rx_count && !match){
+                    MSG_ANT_Message_t * msg = &self.rx_pending[self.rx_head];
+                    match = (msg->message == data);
+                    if(match){
+                        device = msg->device;
+                    }else{
+                        lost++;
+                    }
+                    self.rx_head = (self.rx_head + 1) % MSG_ANT_RX_PENDING;
+                    self.rx_count--;
+                }
+                self.rx_stats.lost += lost;
+                CRITICAL_REGION_EXIT();
+                if(lost){
+                    PRINTS("ANT rx lost\r\n");
+                }
+                if(match){
+                    _handle_message(&device, data);
+                }
             }
             break;
         case MSG_ANT_TRANSMIT:
@@ -68,10 +118,18 @@ _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
                 PRINTS("\r\n");
                 if( ret == -2 ){
                     MSG_Base_AcquireDataAtomic(data);
-                    APP_ASSERT( (NRF_SUCCESS == _queue_tx(data)) );
+                    if( 0 != _queue_tx(data, dst) ){
+                        PRINTS("ANT tx full, dropped\r\n");
+                        MSG_Base_ReleaseDataAtomic(data);
+                    }
                 }
             }
             break;
+        case MSG_ANT_USER_TICK:
+            if(self.user_handler->on_tick){
+                self.user_handler->on_tick(data);
+            }
+            break;
         case MSG_ANT_TRANSMIT_RECEIVE:
             if(self.role == HLO_ANT_ROLE_PERIPHERAL){
                 int32_t ret = _try_send_ant_peripheral(data, true);
@@ -80,7 +138,10 @@ _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
                 PRINTS("\r\n");
                 if( ret == -2 ){
                     MSG_Base_AcquireDataAtomic(data);
-                    APP_ASSERT( (NRF_SUCCESS == _queue_tx(data)) );
+                    if( 0 != _queue_tx(data, dst) ){
+                        PRINTS("ANT tx full, dropped\r\n");
+                        MSG_Base_ReleaseDataAtomic(data);
+                    }
                 }
             }
             break;
@@ -92,39 +153,61 @@ static MSG_Status
 _destroy(void){
     return SUCCESS;
 }
-static void _on_message(const hlo_ant_device_t * device, MSG_Data_t * message){
+MSG_Status MSG_ANT_HandleMessage(const hlo_ant_device_t * device, MSG_Data_t * message){
+    MSG_Status ret = OOM;
     if(!message){
-        return;  // Do not use one line if: https://medium.com/@jonathanabrams/single-line-if-statements-2565c62ff492
+        return FAIL;  // Do not use one line if: https://medium.com/@jonathanabrams/single-line-if-statements-2565c62ff492
     }
-
-    MSG_ANT_Message_t content = (MSG_ANT_Message_t){
-        .device = *device,
-        .message = message,
-    };
-
-    MSG_Data_t * parcel = MSG_Base_AllocateObjectAtomic(&content, sizeof(content));
-    if(parcel){
-        MSG_Base_AcquireDataAtomic(message);
-        self.parent->dispatch( ADDR(ANT,0), ADDR(ANT,MSG_ANT_HANDLE_MESSAGE), parcel);
-        MSG_Base_ReleaseDataAtomic(parcel);
+    //no parcel, the device waits here and the dispatch holds the message
+    //the dispatch stays in the region so a nested receive can not queue ahead of it
+    CRITICAL_REGION_ENTER();
+    if(self.rx_count < MSG_ANT_RX_PENDING){
+        uint8_t tail = (self.rx_head + self.rx_count) % MSG_ANT_RX_PENDING;
+        self.rx_pending[tail].device = *device;
+        self.rx_pending[tail].message = message;
+        self.rx_count++;
+        if(SUCCESS == self.parent->dispatch( ADDR(ANT,0), ADDR(ANT,MSG_ANT_HANDLE_MESSAGE), message)){
+            ret = SUCCESS;
+        }else{
+            self.rx_count--;
+        }
+    }
+    if(ret != SUCCESS){
+        self.rx_stats.dropped++;
+    }
+    CRITICAL_REGION_EXIT();
+    if(ret != SUCCESS){
+        PRINTS("ANT rx full, dropped\r\n");
     }
+    return ret;
+}
+void MSG_ANT_GetRxStats(MSG_ANT_RxStats_t * out_stats){
+    CRITICAL_REGION_ENTER();
+    *out_stats = self.rx_stats;
+    CRITICAL_REGION_EXIT();
+}
+static void _on_message(const hlo_ant_device_t * device, MSG_Data_t * message){
+    MSG_ANT_HandleMessage(device, message);
 }
 static MSG_Data_t * INCREF _on_connect(const hlo_ant_device_t * device){
     if( self.user_handler->on_connection ){
         return self.user_handler->on_connection(device);
     }
+    return NULL;
 }
 
 static uint32_t
 _dequeue_tx(const hlo_ant_device_t * device){
     PRINTS("Dequeue\r\n");
-    queue_message_t out;
-    uint32_t ret = hlo_queue_read(self.tx_queue, (unsigned char *)&out, sizeof(out));
-    if(ret == NRF_SUCCESS){
+    uint32_t ret = NRF_SUCCESS;
+    MSG_QueueEntry_t out;
+    if(MSG_Queue_Pop(self.tx_queue, &out)){
+        //dispatch takes its own reference, drop the queue's after
+        self.parent->dispatch( ADDR(ANT,0), out.address, out.msg);
         MSG_Base_ReleaseDataAtomic(out.msg);
-        self.parent->dispatch( ADDR(ANT,0), ADDR(ANT, MSG_ANT_TRANSMIT), out.msg);
     }else{
         ret = hlo_ant_disconnect(device);
+        self.tx_open = 0;
     }
     return ret;
 }
@@ -132,6 +215,11 @@ static void _on_message_sent(const hlo_ant_device_t * device, MSG_Data_t * messa
     //get next queued tx message
     PRINTS("message sent \r\n");
     if(self.role == HLO_ANT_ROLE_PERIPHERAL){
+        //store and forward trims on this, only a full duplex send is known to have arrived
+        //the publish holds the object until delivered
+        if(self.tx_mode == MSG_ANT_TRANSMIT_RECEIVE){
+            self.parent->publish(ADDR(ANT,0), MSG_TOPIC_ANT_SENT, message);
+        }
         APP_OK(_dequeue_tx(device));
     }
 }
@@ -141,7 +229,7 @@ static void _on_message_failed(const hlo_ant_device_t * device, MSG_Data_t * mes
         static int retry;
         if(retry++ < 3){
             PRINTS("retry...");
-            self.parent->dispatch(ADDR(ANT,0), ADDR(ANT,MSG_ANT_TRANSMIT), message);
+            self.parent->dispatch(ADDR(ANT,0), ADDR(ANT,self.tx_mode), message);
         }else{
             PRINTS("drop...");
             retry = 0;
@@ -203,8 +291,9 @@ MSG_Data_t * INCREF AllocateAntPayload(MSG_ANT_PillDataType_t type, void * paylo
 MSG_Base_t * MSG_ANT_Base(MSG_Central_t * parent, const MSG_ANTHandler_t * handler,hlo_ant_role role, uint8_t device_type){
     self.parent = parent;
     self.user_handler = handler;
-    self.tx_queue = hlo_queue_init(64);
+    self.tx_queue = MSG_Queue_Init(16, MSG_QUEUE_SPSC);
     APP_ASSERT(self.tx_queue);
+    MSG_Queue_SetPolicy(self.tx_queue, MSG_QUEUE_DROP_NEWEST | MSG_QUEUE_COALESCE);
     {//plug in message
         self.base.init =  _init;
         self.base.flush = _flush;
@@ -236,3 +325,9 @@ MSG_Base_t * MSG_ANT_Base(MSG_Central_t * parent, const MSG_ANTHandler_t * handl
     }
     return &self.base;
 }
+MSG_QueuePressure MSG_ANT_TxPressure(MSG_ANT_PillDataType_t type){
+    if(!self.tx_queue){
+        return MSG_QUEUE_PRESSURE_NONE;
+    }
+    return MSG_Queue_Pressure(self.tx_queue, _coalesce_tag(type));
+}
@@ -2,6 +2,7 @@
 #include "message_base.h"
 #include "ant_driver.h"
 #include "ant_packet.h"
+#include "message_queue.h"
 
 /**
  *
@@ -15,6 +16,13 @@
  * 6. RX ends message by either completing checksum, or channel closes
  *    - In case of master, receiving an invalid checksum will result in loss packet.  
  *    - Further protocol are user defined
+ * 7. Header byte 2 holds flags, legacy devices send 0. With ANT_PACKET_BURST a full duplex
+ *    header asks for burst, the central sets the same flag in its page 0 echo to agree and the
+ *    pages follow as burst transfers of the same 8 byte packets
+ * 8. With ANT_PACKET_SELECTIVE the header asks for missing page reports, agreed the same way.
+ *    Every echo after that is {page, 0, flags, first missing page, 32 bit little endian bitmap
+ *    of missing pages from there}, the first missing page is past the last once the message
+ *    is in. The sender sends every page once, then only what the reports name
  *
  * Below is the structure of the ANT air packet (8 Bytes)
  * Table of page + page_count combinations:
@@ -29,6 +37,12 @@
  **/
 
 #define ANT_PROTOCOL_VER      (4)
+// ANT_PILL_DATA_ENCRYPTED carrying MotionFeaturesPayload_t instead of MotionPayload_t, same size
+#define ANT_PROTOCOL_VER_MOTION_FEATURES (5)
+// ANT_PILL_DATA_ENCRYPTED carrying a MotionRecord_t, a stored minute with seq and age,
+// the record payload is MotionPayload_t or with _FEATURES MotionFeaturesPayload_t
+#define ANT_PROTOCOL_VER_MOTION_RECORD (6)
+#define ANT_PROTOCOL_VER_MOTION_RECORD_FEATURES (7)
 
 
 typedef enum{
@@ -36,11 +50,19 @@ typedef enum{
     MSG_ANT_TRANSMIT,
     MSG_ANT_HANDLE_MESSAGE,
     MSG_ANT_TRANSMIT_RECEIVE,
+    MSG_ANT_USER_TICK,      //passed to the handler's on_tick, for timed dispatches of the user code
 }MSG_ANT_Commands;
 
+/*
+ * received messages waiting for the scheduler, the dispatch carries the message itself
+ */
+#ifndef MSG_ANT_RX_PENDING
+#define MSG_ANT_RX_PENDING 4
+#endif
+
 typedef struct{
     hlo_ant_device_t device;
-    MSG_Data_t * message;
+    MSG_Data_t * message;   //held by the MSG_ANT_HANDLE_MESSAGE dispatch, not by this
 }MSG_ANT_Message_t;
 
 typedef struct 
@@ -81,9 +103,27 @@ typedef struct{
     void (*on_message)(const hlo_ant_device_t * id, MSG_Data_t * msg);
     /* Called when an ant initiates a connection, allocate(but don't release) a response if needed*/
     MSG_Data_t * INCREF (*on_connection)(const hlo_ant_device_t * id); 
+    /* Optional, called with whatever was dispatched to MSG_ANT_USER_TICK */
+    void (*on_tick)(MSG_Data_t * data);
 }MSG_ANTHandler_t;
 
 MSG_Base_t * MSG_ANT_Base(MSG_Central_t * parent, const MSG_ANTHandler_t * handler,hlo_ant_role role, uint8_t device_type);
 /* Helper API an Object based on type */
 MSG_Data_t * INCREF AllocateEncryptedAntPayload(MSG_ANT_PillDataType_t type, void * payload, size_t len);
 MSG_Data_t * INCREF AllocateAntPayload(MSG_ANT_PillDataType_t type, void * payload, size_t len);
+/*
+ * backpressure on the tx queue for a packet of this type, check before
+ * encrypting, MSG_QUEUE_PRESSURE_FULL means it would be dropped
+ */
+MSG_QueuePressure MSG_ANT_TxPressure(MSG_ANT_PillDataType_t type);
+/*
+ * hands message to the user handler's on_message from the scheduler as if device had sent it
+ * nothing is allocated, OOM if MSG_ANT_RX_PENDING messages are already waiting or the
+ * central queue is full, both counted in MSG_ANT_RxStats_t
+ */
+MSG_Status MSG_ANT_HandleMessage(const hlo_ant_device_t * device, MSG_Data_t * message);
+typedef struct{
+    uint32_t dropped;   //pending ring or central queue full, never handled
+    uint32_t lost;      //dispatched but never delivered, found behind a later message
+}MSG_ANT_RxStats_t;
+void MSG_ANT_GetRxStats(MSG_ANT_RxStats_t * out_stats);
@@ -1,31 +1,212 @@
 #include <stddef.h>
+#include <string.h>
+#include <app_util.h>
+#include <app_scheduler.h>
+#include <app_timer.h>
 #include "message_app.h"
 #include "util.h"
 
 
 #define LOW_MEMORY_WATERMARK (sizeof(MSG_Data_t*) + 64)
 
+/*
+ * per priority queue depth, apps can override these in message_config.h
+ */
+#ifndef MSG_CENTRAL_QUEUE_DEPTH_HIGH
+#define MSG_CENTRAL_QUEUE_DEPTH_HIGH 4
+#endif
+#ifndef MSG_CENTRAL_QUEUE_DEPTH_NORMAL
+#define MSG_CENTRAL_QUEUE_DEPTH_NORMAL 12
+#endif
+#ifndef MSG_CENTRAL_QUEUE_DEPTH_LOW
+#define MSG_CENTRAL_QUEUE_DEPTH_LOW 6
+#endif
+/*
+ * max events delivered per scheduler slot, so ble and timer events can interleave
+ */
+#define MSG_CENTRAL_DRAIN_BATCH 4
+/*
+ * max subscribers per topic
+ */
+#ifndef MSG_CENTRAL_MAX_SUBSCRIBERS
+#define MSG_CENTRAL_MAX_SUBSCRIBERS 3
+#endif
+/*
+ * published events are queued with this module and the topic as submodule
+ */
+#define TOPIC_MODULE 0xFF
+/*
+ * number of pending timed dispatches, apps can override this in message_config.h
+ */
+#ifndef MSG_CENTRAL_TIMED_SLOTS
+#define MSG_CENTRAL_TIMED_SLOTS 4
+#endif
+/*
+ * entries due within this many ticks of a wakeup are delivered with it
+ */
+#ifndef MSG_CENTRAL_TIMED_SLACK
+#define MSG_CENTRAL_TIMED_SLACK 0
+#endif
+/*
+ * app_timer rejects timeouts under 5 ticks, long waits are re-armed in steps so the 24 bit counter
+ * can not wrap twice, deadlines are compared as signed differences of the 32 bit wheel clock
+ */
+#define TIMED_MIN_TICKS 5
+#define TIMED_MAX_TICKS 0x7FFFFF
+#define TIMED_MAX_WAIT 0x7FFFFFFF
+/*
+ * a handle is the slot in the low bits and the slot's generation above them, so a handle kept
+ * after its entry fired or was cancelled does not match whatever reuses the slot
+ */
+#define TIMED_SLOT_BITS 3
+#define TIMED_SLOT_MASK ((1 << TIMED_SLOT_BITS) - 1)
+#if MSG_CENTRAL_TIMED_SLOTS > (1 << TIMED_SLOT_BITS)
+#error "MSG_CENTRAL_TIMED_SLOTS does not fit in a timed handle"
+#endif
+
+typedef struct{
+    MSG_Address_t src;
+    MSG_Address_t dst;
+    MSG_Data_t * data;
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+    uint32_t enqueued; //rtc ticks at dispatch
+#endif
+}future_event;
+
+typedef struct{
+    future_event * events;
+    uint8_t size;
+    uint8_t head;
+    uint8_t count;
+    uint8_t high_water;
+    uint16_t drops;
+}event_ring_t;
+
+typedef struct{
+    MSG_Address_t subscribers[MSG_CENTRAL_MAX_SUBSCRIBERS];
+    uint8_t count;
+}topic_t;
+
+typedef struct{
+    MSG_Address_t src;
+    MSG_Address_t dst;
+    MSG_Data_t * data;
+    uint32_t deadline;  //wheel ticks
+    uint32_t period;    //0 for one shot
+    bool active;
+    bool retry;         //the central had no room for its dispatch, it goes again with the next wakeup
+    uint8_t gen;
+}timed_event_t;
+
+static future_event _high_events[MSG_CENTRAL_QUEUE_DEPTH_HIGH];
+static future_event _normal_events[MSG_CENTRAL_QUEUE_DEPTH_NORMAL];
+static future_event _low_events[MSG_CENTRAL_QUEUE_DEPTH_LOW];
+
 static struct{
     MSG_Central_t central;
     MSG_Base_t base;
     bool initialized;
     app_sched_event_handler_t unknown_handler;
     MSG_Base_t * mods[MSG_CENTRAL_MODULE_NUM]; 
+    uint8_t priorities[MSG_CENTRAL_MODULE_NUM];
+    event_ring_t rings[MSG_PRIORITY_NUM];
+    topic_t topics[MSG_TOPIC_NUM];
+    struct{
+        timed_event_t events[MSG_CENTRAL_TIMED_SLOTS];
+        app_timer_id_t timer;
+        bool created;
+        bool armed;
+        bool rearm;         //app_timer_start failed, retried from the scheduler and every drain
+        bool drain_retry;   //the scheduler had no room for a drain, the timer puts it
+        bool retry;         //an entry's dispatch found its ring full, the timer tries again
+        uint32_t armed_for; //earliest deadline when the timer was started
+        uint32_t now;       //ticks since the first timed dispatch, the rtc counter is only 24 bits
+        uint32_t counter;   //rtc counter at now
+        uint16_t wakeups;
+        uint16_t arm_failures;
+    }wheel;
+    volatile bool drain_pending;
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+    MSG_App_ModuleStats_t stats[MSG_CENTRAL_MODULE_NUM];
+    uint16_t sched_failures;
+#endif
 }self;
 static const char * name = "CENTRAL";
 
-typedef struct{
-    MSG_Address_t src;
-    MSG_Address_t dst;
-    MSG_Data_t * data;
-}future_event;
-
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+/*
+ * buckets are powers of 4 in rtc ticks: 0, <4, <16, <64, <256, <1024, <4096, rest
+ */
+static uint8_t
+_bucket(uint32_t ticks){
+    uint8_t bits = 0;
+    while(ticks){
+        bits++;
+        ticks >>= 1;
+    }
+    bits = (bits + 1) / 2;
+    return bits < MSG_APP_STATS_BUCKETS ? bits : (MSG_APP_STATS_BUCKETS - 1);
+}
+static void
+_record(uint16_t * hist, uint16_t * max, uint32_t ticks){
+    uint8_t b = _bucket(ticks);
+    if(hist[b] < UINT16_MAX){
+        hist[b]++;
+    }
+    if(ticks > *max){
+        *max = ticks > UINT16_MAX ? UINT16_MAX : ticks;
+    }
+}
+static uint32_t
+_ticks_since(uint32_t from){
+    uint32_t now, diff = 0;
+    app_timer_cnt_get(&now);
+    app_timer_cnt_diff_compute(now, from, &diff);
+    return diff;
+}
+#endif
+static void
+_deliver(const future_event * evt, MSG_Address_t dst){
+    uint8_t dst_idx = (uint8_t)dst.module;
+#ifdef MSG_BASE_ALLOC_TRACKING
+    uint8_t owner = MSG_Base_SetOwner(dst_idx);
+#endif
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+    MSG_App_ModuleStats_t * stats = &self.stats[dst_idx];
+    uint32_t start, ticks;
+    app_timer_cnt_get(&start);
+    app_timer_cnt_diff_compute(start, evt->enqueued, &ticks);
+    _record(stats->wait_hist, &stats->max_wait, ticks);
+    self.mods[dst_idx]->send(evt->src, dst, evt->data);
+    ticks = _ticks_since(start);
+    _record(stats->handler_hist, &stats->max_handler, ticks);
+    stats->handler_total += ticks;
+    stats->count++;
+#else
+    self.mods[dst_idx]->send(evt->src, dst, evt->data);
+#endif
+#ifdef MSG_BASE_ALLOC_TRACKING
+    MSG_Base_SetOwner(owner);
+#endif
+}
 static void
 _future_event_handler(void* event_data, uint16_t event_size){
     future_event * evt = event_data;
     uint8_t dst_idx = (uint8_t)evt->dst.module;
-    if(dst_idx < MSG_CENTRAL_MODULE_NUM && self.mods[dst_idx]){
-        self.mods[dst_idx]->send(evt->src,evt->dst, evt->data);
+    if(dst_idx == TOPIC_MODULE && evt->dst.submodule < MSG_TOPIC_NUM){
+        //every subscriber shares the one reference held by the event
+        topic_t topic;
+        int i;
+        CRITICAL_REGION_ENTER();
+        topic = self.topics[evt->dst.submodule];
+        CRITICAL_REGION_EXIT();
+        for(i = 0; i < topic.count; i++){
+            if(topic.subscribers[i].module < MSG_CENTRAL_MODULE_NUM && self.mods[topic.subscribers[i].module]){
+                _deliver(evt, topic.subscribers[i]);
+            }
+        }
+    }else if(dst_idx < MSG_CENTRAL_MODULE_NUM && self.mods[dst_idx]){
+        _deliver(evt, evt->dst);
     }else{
         if(self.unknown_handler){
             self.unknown_handler(evt, sizeof(*evt));
@@ -35,21 +216,449 @@ _future_event_handler(void* event_data, uint16_t event_size){
         MSG_Base_ReleaseDataAtomic(evt->data);
     }
 }
+static MSG_Priority
+_default_priority(uint8_t module){
+    switch(module){
+        case IMU:
+        case SSPI:
+            return MSG_PRIORITY_HIGH;
+        case UART:
+        case CLI:
+            return MSG_PRIORITY_LOW;
+        default:
+            return MSG_PRIORITY_NORMAL;
+    }
+}
+/*
+ * pops the oldest event of the highest non empty priority
+ */
+static bool
+_pop_event(future_event * out_evt){
+    bool ret = false;
+    int i;
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < MSG_PRIORITY_NUM; i++){
+        event_ring_t * ring = &self.rings[i];
+        if(ring->count){
+            *out_evt = ring->events[ring->head];
+            ring->head = (ring->head + 1) % ring->size;
+            ring->count--;
+            ret = true;
+            break;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+static void _drain_events(void* event_data, uint16_t event_size);
+static bool _wheel_create(void);
+static void _wheel_advance(void);
+static void _wheel_arm(void);
+/*
+ * one drain event sits in the scheduler queue while any ring is non empty
+ */
+static void
+_schedule_drain(void){
+    bool retry;
+    if(app_sched_event_put(NULL, 0, _drain_events)){
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+        self.sched_failures++;
+#endif
+        //scheduler is full, drain_pending stays set and the wheel timer tries again
+        //nothing else might come along to put the drain for the events already queued
+        retry = _wheel_create();
+        CRITICAL_REGION_ENTER();
+        if(retry){
+            self.wheel.drain_retry = true;
+            _wheel_advance();
+            _wheel_arm();
+        }else{
+            //no timer either, next dispatch will try again
+            self.drain_pending = false;
+        }
+        CRITICAL_REGION_EXIT();
+    }
+}
+static void
+_drain_events(void* event_data, uint16_t event_size){
+    future_event evt;
+    bool more = false;
+    int i;
+    for(i = 0; i < MSG_CENTRAL_DRAIN_BATCH && _pop_event(&evt); i++){
+        _future_event_handler(&evt, sizeof(evt));
+    }
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < MSG_PRIORITY_NUM; i++){
+        if(self.rings[i].count){
+            more = true;
+        }
+    }
+    self.drain_pending = more;
+    if(self.wheel.rearm){
+        _wheel_advance();
+        _wheel_arm();
+    }
+    CRITICAL_REGION_EXIT();
+    if(more){
+        _schedule_drain();
+    }
+}
 static MSG_Status
-_dispatch (MSG_Address_t src, MSG_Address_t  dst, MSG_Data_t * data){
+_dispatch_priority(MSG_Address_t src, MSG_Address_t  dst, MSG_Data_t * data, MSG_Priority priority){
+    MSG_Status ret = FAIL;
+    bool schedule = false;
+    event_ring_t * ring;
+    if(priority >= MSG_PRIORITY_NUM){
+        priority = MSG_PRIORITY_LOW;
+    }
+    ring = &self.rings[priority];
     if(data){
         MSG_Base_AcquireDataAtomic(data);
     }
-    {
-        uint32_t err;
-        future_event tmp = {src, dst, data};
-        err = app_sched_event_put(&tmp, sizeof(tmp), _future_event_handler);
-        if(!err){
-            return SUCCESS;
+    CRITICAL_REGION_ENTER();
+    if(ring->count < ring->size){
+        future_event * evt = &ring->events[(ring->head + ring->count) % ring->size];
+        evt->src = src;
+        evt->dst = dst;
+        evt->data = data;
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+        app_timer_cnt_get(&evt->enqueued);
+#endif
+        ring->count++;
+        if(ring->count > ring->high_water){
+            ring->high_water = ring->count;
+        }
+        if(!self.drain_pending){
+            self.drain_pending = true;
+            schedule = true;
+        }
+        ret = SUCCESS;
+    }else{
+        ring->drops++;
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+        if(dst.module < MSG_CENTRAL_MODULE_NUM && self.stats[dst.module].drops < UINT16_MAX){
+            self.stats[dst.module].drops++;
+        }
+#endif
+    }
+    CRITICAL_REGION_EXIT();
+    if(ret != SUCCESS){
+        if(data){
+            MSG_Base_ReleaseDataAtomic(data);
+        }
+    }else if(schedule){
+        _schedule_drain();
+    }
+    return ret;
+}
+static MSG_Status
+_dispatch (MSG_Address_t src, MSG_Address_t  dst, MSG_Data_t * data){
+    MSG_Priority priority = MSG_PRIORITY_NORMAL;
+    if(dst.module < MSG_CENTRAL_MODULE_NUM){
+        priority = self.priorities[dst.module];
+    }
+    return _dispatch_priority(src, dst, data, priority);
+}
+static MSG_Status
+_subscribe(MSG_Topic topic, MSG_Address_t dst){
+    MSG_Status ret = OOM;
+    topic_t * t;
+    int i;
+    if(topic >= MSG_TOPIC_NUM || dst.module >= MSG_CENTRAL_MODULE_NUM){
+        return FAIL;
+    }
+    t = &self.topics[topic];
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < t->count; i++){
+        if(t->subscribers[i].module == dst.module && t->subscribers[i].submodule == dst.submodule){
+            ret = SUCCESS;
+            break;
+        }
+    }
+    if(ret != SUCCESS && t->count < MSG_CENTRAL_MAX_SUBSCRIBERS){
+        t->subscribers[t->count++] = dst;
+        ret = SUCCESS;
+    }
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+static MSG_Status
+_unsubscribe(MSG_Topic topic, MSG_Address_t dst){
+    MSG_Status ret = FAIL;
+    topic_t * t;
+    int i;
+    if(topic >= MSG_TOPIC_NUM){
+        return FAIL;
+    }
+    t = &self.topics[topic];
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < t->count; i++){
+        if(t->subscribers[i].module == dst.module && t->subscribers[i].submodule == dst.submodule){
+            //keep delivery order stable
+            for(; i < t->count - 1; i++){
+                t->subscribers[i] = t->subscribers[i + 1];
+            }
+            t->count--;
+            ret = SUCCESS;
+            break;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+static MSG_Status
+_publish(MSG_Address_t src, MSG_Topic topic, MSG_Data_t * data){
+    MSG_Priority priority = MSG_PRIORITY_LOW;
+    uint8_t count;
+    int i;
+    if(topic >= MSG_TOPIC_NUM){
+        return FAIL;
+    }
+    CRITICAL_REGION_ENTER();
+    count = self.topics[topic].count;
+    for(i = 0; i < count; i++){
+        uint8_t module = self.topics[topic].subscribers[i].module;
+        if(self.priorities[module] < priority){
+            priority = self.priorities[module];
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    if(!count){
+        return SUCCESS;
+    }
+    return _dispatch_priority(src, ADDR(TOPIC_MODULE, topic), data, priority);
+}
+/*
+ * timed dispatch, wheel functions other than the timer handler must be called inside a critical region
+ */
+static void
+_wheel_advance(void){
+    uint32_t counter, diff = 0;
+    app_timer_cnt_get(&counter);
+    app_timer_cnt_diff_compute(counter, self.wheel.counter, &diff);
+    self.wheel.now += diff;
+    self.wheel.counter = counter;
+}
+static void _wheel_retry(void * event_data, uint16_t event_size);
+/*
+ * the app_timer op queue is short, the timer is only restarted when the earliest deadline moves
+ */
+static void
+_wheel_arm(void){
+    uint32_t deadline = 0;
+    int32_t next;
+    uint32_t err;
+    bool any = false;
+    int i;
+    for(i = 0; i < MSG_CENTRAL_TIMED_SLOTS; i++){
+        const timed_event_t * e = &self.wheel.events[i];
+        if(e->active && (!any || (int32_t)(e->deadline - deadline) < 0)){
+            deadline = e->deadline;
+            any = true;
+        }
+    }
+    if((self.wheel.drain_retry || self.wheel.retry) && (!any || (int32_t)(deadline - self.wheel.now) > TIMED_MIN_TICKS)){
+        deadline = self.wheel.now + TIMED_MIN_TICKS;
+        any = true;
+    }
+    if(!any){
+        if(self.wheel.armed){
+            app_timer_stop(self.wheel.timer);
+            self.wheel.armed = false;
+        }
+        self.wheel.rearm = false;
+        return;
+    }
+    if(self.wheel.armed && self.wheel.armed_for == deadline){
+        //running for it already, or for a step on the way
+        return;
+    }
+    next = (int32_t)(deadline - self.wheel.now);
+    if(next < TIMED_MIN_TICKS){
+        next = TIMED_MIN_TICKS;
+    }else if(next > TIMED_MAX_TICKS){
+        next = TIMED_MAX_TICKS;
+    }
+    if(self.wheel.armed){
+        app_timer_stop(self.wheel.timer);
+    }
+    err = app_timer_start(self.wheel.timer, next, NULL);
+    self.wheel.armed = (err == NRF_SUCCESS);
+    self.wheel.armed_for = deadline;
+    self.wheel.rearm = !self.wheel.armed;
+    if(err == NRF_ERROR_NO_MEM){
+        //op queue full, the scheduler runs after app_timer has worked through it
+        self.wheel.arm_failures++;
+        app_sched_event_put(NULL, 0, _wheel_retry);
+    }else{
+        APP_OK(err);
+    }
+}
+static void
+_wheel_retry(void * event_data, uint16_t event_size){
+    CRITICAL_REGION_ENTER();
+    if(self.wheel.rearm){
+        _wheel_advance();
+        _wheel_arm();
+    }
+    CRITICAL_REGION_EXIT();
+}
+static void
+_wheel_timeout(void * ctx){
+    timed_event_t due[MSG_CENTRAL_TIMED_SLOTS];
+    uint8_t slots[MSG_CENTRAL_TIMED_SLOTS];
+    bool sent[MSG_CENTRAL_TIMED_SLOTS];
+    uint8_t count = 0;
+    bool drain;
+    int i;
+    CRITICAL_REGION_ENTER();
+    _wheel_advance();
+    self.wheel.wakeups++;
+    self.wheel.armed = false;
+    self.wheel.retry = false;
+    drain = self.wheel.drain_retry;
+    self.wheel.drain_retry = false;
+    for(i = 0; i < MSG_CENTRAL_TIMED_SLOTS; i++){
+        timed_event_t * e = &self.wheel.events[i];
+        if(e->active && (e->retry || (int32_t)(e->deadline - self.wheel.now) <= MSG_CENTRAL_TIMED_SLACK)){
+            e->retry = false;
+            due[count] = *e;
+            slots[count] = i;
+            //a one shot stays active until its dispatch went through, the entry keeps its reference
+            if(e->period){
+                //stay on the period grid, skip whatever was missed
+                while((int32_t)(e->deadline - self.wheel.now) <= MSG_CENTRAL_TIMED_SLACK){
+                    e->deadline += e->period;
+                }
+            }
+            if(due[count].data){
+                MSG_Base_AcquireDataAtomic(due[count].data);
+            }
+            count++;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    if(drain){
+        _schedule_drain();
+    }
+    for(i = 0; i < count; i++){
+        sent[i] = (_dispatch(due[i].src, due[i].dst, due[i].data) == SUCCESS);
+        if(due[i].data){
+            MSG_Base_ReleaseDataAtomic(due[i].data);
+        }
+    }
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < count; i++){
+        timed_event_t * e = &self.wheel.events[slots[i]];
+        //not cancelled or reused while it was out
+        bool ours = e->active && e->gen == due[i].gen;
+        if(ours && !sent[i]){
+            //ring full, a lost one shot would leave its owner waiting with a handle that cancels nothing
+            e->retry = true;
+            self.wheel.retry = true;
+        }
+        if(ours && sent[i] && !e->period){
+            e->active = false;
         }else{
-            return FAIL;
+            due[i].data = NULL;
+        }
+    }
+    _wheel_advance();
+    _wheel_arm();
+    CRITICAL_REGION_EXIT();
+    //references of the one shots that are done
+    for(i = 0; i < count; i++){
+        if(due[i].data){
+            MSG_Base_ReleaseDataAtomic(due[i].data);
+        }
+    }
+}
+static bool
+_wheel_create(void){
+    if(!self.wheel.created){
+        if(app_timer_create(&self.wheel.timer, APP_TIMER_MODE_SINGLE_SHOT, _wheel_timeout) != NRF_SUCCESS){
+            return false;
+        }
+        app_timer_cnt_get(&self.wheel.counter);
+        self.wheel.created = true;
+    }
+    return true;
+}
+static uint8_t
+_wheel_add(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, uint32_t ticks, uint32_t period){
+    uint8_t ret = MSG_TIMED_NONE;
+    int i;
+    if(!_wheel_create()){
+        return MSG_TIMED_NONE;
+    }
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < MSG_CENTRAL_TIMED_SLOTS; i++){
+        timed_event_t * e = &self.wheel.events[i];
+        if(!e->active){
+            _wheel_advance();
+            e->retry = false;
+            e->src = src;
+            e->dst = dst;
+            e->data = data;
+            e->period = period;
+            if(period){
+                e->deadline = self.wheel.now + period - (self.wheel.now % period);
+            }else{
+                e->deadline = self.wheel.now + ticks;
+            }
+            e->active = true;
+            e->gen = (e->gen + 1) & (0xFF >> TIMED_SLOT_BITS);
+            ret = (e->gen << TIMED_SLOT_BITS) | i;
+            if(ret == MSG_TIMED_NONE){
+                e->gen = 0;
+                ret = i;
+            }
+            if(data){
+                MSG_Base_AcquireDataAtomic(data);
+            }
+            _wheel_arm();
+            break;
         }
     }
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+static uint8_t
+_dispatch_at(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, uint32_t ticks){
+    if(ticks > TIMED_MAX_WAIT){
+        return MSG_TIMED_NONE;
+    }
+    return _wheel_add(src, dst, data, ticks, 0);
+}
+static uint8_t
+_dispatch_every(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, uint32_t period){
+    if(!period || period > TIMED_MAX_TICKS){
+        return MSG_TIMED_NONE;
+    }
+    return _wheel_add(src, dst, data, 0, period);
+}
+static MSG_Status
+_cancel(uint8_t handle){
+    MSG_Data_t * data = NULL;
+    MSG_Status ret = FAIL;
+    timed_event_t * e;
+    if(handle == MSG_TIMED_NONE || (handle & TIMED_SLOT_MASK) >= MSG_CENTRAL_TIMED_SLOTS){
+        return FAIL;
+    }
+    e = &self.wheel.events[handle & TIMED_SLOT_MASK];
+    CRITICAL_REGION_ENTER();
+    if(e->active && e->gen == (handle >> TIMED_SLOT_BITS)){
+        e->active = false;
+        data = e->data;
+        _wheel_advance();
+        _wheel_arm();
+        ret = SUCCESS;
+    }
+    CRITICAL_REGION_EXIT();
+    if(data){
+        MSG_Base_ReleaseDataAtomic(data);
+    }
+    return ret;
 }
 static MSG_Status
 _loadmod(MSG_Base_t * mod){
@@ -70,6 +679,22 @@ _loadmod(MSG_Base_t * mod){
 uint8_t MSG_App_IsModLoaded(MSG_ModuleType type){
     return self.mods[type] ? 1: 0;
 }
+bool MSG_App_GetModuleStats(MSG_ModuleType type, MSG_App_ModuleStats_t * out_stats){
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+    if(type < MSG_CENTRAL_MODULE_NUM && out_stats){
+        CRITICAL_REGION_ENTER();
+        *out_stats = self.stats[type];
+        CRITICAL_REGION_EXIT();
+        return true;
+    }
+#endif
+    return false;
+}
+void MSG_App_SetPriority(MSG_ModuleType type, MSG_Priority priority){
+    if(type < MSG_CENTRAL_MODULE_NUM && priority < MSG_PRIORITY_NUM){
+        self.priorities[type] = priority;
+    }
+}
 
 static MSG_Status
 _unloadmod(MSG_Base_t * mod){
@@ -87,12 +712,26 @@ _unloadmod(MSG_Base_t * mod){
 }
 
 MSG_Central_t * MSG_App_Central( app_sched_event_handler_t unknown_handler ){
+    int i;
     if ( !self.initialized ){
         self.unknown_handler = unknown_handler; 
         self.initialized = 1;
         self.central.loadmod = _loadmod;
         self.central.unloadmod = _unloadmod;
         self.central.dispatch = _dispatch;
+        self.central.dispatch_priority = _dispatch_priority;
+        self.central.subscribe = _subscribe;
+        self.central.unsubscribe = _unsubscribe;
+        self.central.publish = _publish;
+        self.central.dispatch_at = _dispatch_at;
+        self.central.dispatch_every = _dispatch_every;
+        self.central.cancel = _cancel;
+        self.rings[MSG_PRIORITY_HIGH] = (event_ring_t){_high_events, MSG_CENTRAL_QUEUE_DEPTH_HIGH};
+        self.rings[MSG_PRIORITY_NORMAL] = (event_ring_t){_normal_events, MSG_CENTRAL_QUEUE_DEPTH_NORMAL};
+        self.rings[MSG_PRIORITY_LOW] = (event_ring_t){_low_events, MSG_CENTRAL_QUEUE_DEPTH_LOW};
+        for(i = 0; i < MSG_CENTRAL_MODULE_NUM; i++){
+            self.priorities[i] = _default_priority(i);
+        }
     }
     
     return &self.central;
@@ -112,20 +751,93 @@ static MSG_Status
 _flush(void){
     return SUCCESS;
 }
+static void
+_print_stats(void){
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+    int i,j;
+    PRINTF("sched fail %u\r\n", self.sched_failures);
+    PRINTS("mod: count drops max_wait max_run avg_run | wait hist | run hist (rtc ticks, x4 buckets)\r\n");
+    for(i = 0; i < MSG_CENTRAL_MODULE_NUM; i++){
+        const MSG_App_ModuleStats_t * s = &self.stats[i];
+        if(!s->count && !s->drops){
+            continue;
+        }
+        PRINTS(self.mods[i] ? self.mods[i]->typestr : "?");
+        PRINTF(": %u %u %u %u %u |", s->count, s->drops, s->max_wait, s->max_handler, s->count ? s->handler_total / s->count : 0);
+        for(j = 0; j < MSG_APP_STATS_BUCKETS; j++){
+            PRINTF(" %u", s->wait_hist[j]);
+        }
+        PRINTS(" |");
+        for(j = 0; j < MSG_APP_STATS_BUCKETS; j++){
+            PRINTF(" %u", s->handler_hist[j]);
+        }
+        PRINTS("\r\n");
+    }
+#else
+    PRINTS("MSG_CENTRAL_INSTRUMENTATION not enabled\r\n");
+#endif
+}
 static MSG_Status
 _send(MSG_Address_t src,MSG_Address_t dst, MSG_Data_t * data){
+    int i,j;
     switch(dst.submodule){
         default:
         case MSG_APP_PING:
             break;
         case MSG_APP_LSMOD:
             PRINTS("Loaded Mods\r\n");
-            for(int i = 0; i < MSG_CENTRAL_MODULE_NUM; i++){
+            for(i = 0; i < MSG_CENTRAL_MODULE_NUM; i++){
                 if(self.mods[i]){
                     PRINTS(self.mods[i]->typestr);
                     PRINTS("\r\n");
                 }
             }
+            PRINTS("Topics\r\n");
+            for(i = 0; i < MSG_TOPIC_NUM; i++){
+                PRINT_HEX(&i, 1);
+                PRINTS(":");
+                for(j = 0; j < self.topics[i].count; j++){
+                    PRINTS(" ");
+                    PRINTS(self.mods[self.topics[i].subscribers[j].module] ? self.mods[self.topics[i].subscribers[j].module]->typestr : "?");
+                }
+                PRINTS("\r\n");
+            }
+            PRINTS("Timed wakeups ");
+            PRINT_HEX(&self.wheel.wakeups, sizeof(self.wheel.wakeups));
+            PRINTS(" arm failures ");
+            PRINT_HEX(&self.wheel.arm_failures, sizeof(self.wheel.arm_failures));
+            PRINTS("\r\n");
+            PRINTS("Queue depth/drops (high, normal, low)\r\n");
+            for(i = 0; i < MSG_PRIORITY_NUM; i++){
+                PRINT_HEX(&self.rings[i].high_water, sizeof(self.rings[i].high_water));
+                PRINTS("/");
+                PRINT_HEX(&self.rings[i].drops, sizeof(self.rings[i].drops));
+                PRINTS("\r\n");
+            }
+            break;
+        case MSG_APP_STATS:
+            _print_stats();
+            //data carries the module index, reply goes back to the sender
+            if(data && data->len && src.module != CENTRAL){
+                MSG_App_ModuleStats_t stats;
+                uint8_t module = 0;
+                MSG_Base_Read(data, 0, &module, 1);
+                if(MSG_App_GetModuleStats(module, &stats)){
+                    MSG_Data_t * reply = MSG_Base_AllocateObjectAtomic(&stats, sizeof(stats));
+                    if(reply){
+                        self.central.dispatch(ADDR(CENTRAL, MSG_APP_STATS), src, reply);
+                        MSG_Base_ReleaseDataAtomic(reply);
+                    }
+                }
+            }
+            break;
+        case MSG_APP_STATS_RESET:
+#ifdef MSG_CENTRAL_INSTRUMENTATION
+            CRITICAL_REGION_ENTER();
+            memset(self.stats, 0, sizeof(self.stats));
+            self.sched_failures = 0;
+            CRITICAL_REGION_EXIT();
+#endif
             break;
     }
     return SUCCESS;
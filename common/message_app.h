@@ -9,11 +9,38 @@
 typedef enum{
     MSG_APP_PING = 0,
     MSG_APP_LSMOD,
+    MSG_APP_STATS,          //prints dispatch stats, replies MSG_App_ModuleStats_t to sender if data holds a module index
+    MSG_APP_STATS_RESET,
 }MSG_App_Commands;
 
+/*
+ * Dispatch instrumentation, enabled by defining MSG_CENTRAL_INSTRUMENTATION in message_config.h
+ * all times are in rtc ticks (app_timer_cnt_get), histogram buckets are powers of 4:
+ * 0, <4, <16, <64, <256, <1024, <4096, rest
+ */
+#define MSG_APP_STATS_BUCKETS 8
+typedef struct{
+    uint32_t count;         //messages delivered
+    uint32_t handler_total; //ticks spent in send
+    uint16_t drops;         //messages dropped because the queue was full
+    uint16_t max_wait;
+    uint16_t max_handler;
+    uint16_t wait_hist[MSG_APP_STATS_BUCKETS];      //dispatch to delivery
+    uint16_t handler_hist[MSG_APP_STATS_BUCKETS];   //time in the module's send
+}MSG_App_ModuleStats_t;
+
 MSG_Central_t * MSG_App_Central( app_sched_event_handler_t unknown_handler );
 MSG_Base_t * MSG_App_Base(MSG_Central_t * parent);
 uint8_t MSG_App_IsModLoaded(MSG_ModuleType type);
+/*
+ * overrides the default dispatch priority of messages sent to a module
+ * IMU and SSPI default to high, UART and CLI to low, everything else to normal
+ */
+void MSG_App_SetPriority(MSG_ModuleType type, MSG_Priority priority);
+/*
+ * returns false if instrumentation is compiled out
+ */
+bool MSG_App_GetModuleStats(MSG_ModuleType type, MSG_App_ModuleStats_t * out_stats);
 
 
 #endif
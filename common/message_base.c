@@ -5,6 +5,10 @@
 #include "message_base.h"
 #include "util.h"
 #include "heap.h"
+#include "message_pool.h"
+#ifdef MSG_BASE_ALLOC_TRACKING
+#include <app_timer.h>
+#endif
 
 static inline uint8_t decref(MSG_Data_t * obj){
     if(obj->ref){
@@ -14,28 +18,302 @@ static inline uint8_t decref(MSG_Data_t * obj){
 static inline uint8_t incref(MSG_Data_t * obj){
     obj->ref += 1;
 }
+/*
+ * small objects come from the slab pool, anything else from the heap
+ * must be called inside a critical region
+ */
+static void * _alloc(size_t size){
+    void * mem = MSG_Pool_Alloc(size);
+    if(!mem){
+        mem = pvPortMalloc(size);
+    }
+    return mem;
+}
+static void _free(void * mem){
+    if(!MSG_Pool_Free(mem)){
+        vPortFree(mem);
+    }
+}
+
+static MSG_Data_t * _allocate_data(size_t size, const void * site);
+
+#ifdef MSG_BASE_ALLOC_TRACKING
+/*
+ * allocation site tracking, the caller's return address is the site
+ * look sites up with arm-none-eabi-addr2line -e <elf> <site>
+ */
+#define CALLER() __builtin_return_address(0)
+#ifndef MSG_BASE_LEAK_TICKS
+#define MSG_BASE_LEAK_TICKS APP_TIMER_TICKS(60000, APP_TIMER_PRESCALER)
+#endif
+#define OWNER_NONE MOD_END
+typedef struct{
+    const MSG_Data_t * obj;
+    const void * site;
+    uint32_t ticks;
+    uint16_t size;  //bytes taken from the pool or heap, header included
+    uint8_t module;
+}alloc_record_t;
+static struct{
+    alloc_record_t records[MSG_BASE_ALLOC_TRACKING];
+    uint16_t live_bytes[OWNER_NONE + 1];
+    uint16_t peak_bytes[OWNER_NONE + 1];
+    uint16_t untracked;
+    uint8_t owner;
+}_tracking = {.owner = OWNER_NONE};
+
+static uint16_t
+_footprint(const void * mem, size_t size){
+    size_t block = MSG_Pool_BlockSize(mem);
+    return block ? block : size;
+}
+/*
+ * all of these must be called inside a critical region
+ */
+static void
+_track(const MSG_Data_t * obj, size_t size, const void * site){
+    int i;
+    uint8_t m = _tracking.owner;
+    for(i = 0; i < MSG_BASE_ALLOC_TRACKING; i++){
+        alloc_record_t * r = &_tracking.records[i];
+        if(!r->obj){
+            r->obj = obj;
+            r->site = site;
+            r->size = _footprint(obj, size);
+            r->module = m;
+            app_timer_cnt_get(&r->ticks);
+            _tracking.live_bytes[m] += r->size;
+            if(_tracking.live_bytes[m] > _tracking.peak_bytes[m]){
+                _tracking.peak_bytes[m] = _tracking.live_bytes[m];
+            }
+            return;
+        }
+    }
+    _tracking.untracked++;
+}
+static alloc_record_t *
+_find_record(const MSG_Data_t * obj){
+    int i;
+    for(i = 0; i < MSG_BASE_ALLOC_TRACKING; i++){
+        if(_tracking.records[i].obj == obj){
+            return &_tracking.records[i];
+        }
+    }
+    return NULL;
+}
+static void
+_untrack(const MSG_Data_t * obj){
+    alloc_record_t * r = _find_record(obj);
+    if(r){
+        _tracking.live_bytes[r->module] -= r->size;
+        r->obj = NULL;
+    }
+}
+static void
+_retrack(const MSG_Data_t * old, const MSG_Data_t * obj, size_t size){
+    alloc_record_t * r = _find_record(old);
+    if(r){
+        uint16_t footprint = _footprint(obj, size);
+        _tracking.live_bytes[r->module] += footprint - r->size;
+        if(_tracking.live_bytes[r->module] > _tracking.peak_bytes[r->module]){
+            _tracking.peak_bytes[r->module] = _tracking.live_bytes[r->module];
+        }
+        r->obj = obj;
+        r->size = footprint;
+    }
+}
+#else
+#define CALLER() NULL
+#define _track(obj, size, site)
+#define _untrack(obj)
+#define _retrack(old, obj, size)
+#endif
 
 uint32_t MSG_Base_FreeCount(void){
     size_t free;
     CRITICAL_REGION_ENTER();
-    free = xPortGetFreeHeapSize();
+    free = xPortGetFreeHeapSize() + MSG_Pool_FreeBytes();
     CRITICAL_REGION_EXIT();
 	return free;
 }
 
-bool MSG_Base_HasMemoryLeak(void){}
+uint32_t MSG_Base_LargestFree(void){
+    size_t largest;
+    uint8_t i;
+    CRITICAL_REGION_ENTER();
+    largest = xPortGetLargestFreeBlockSize();
+    for(i = 0; i < MSG_Pool_ClassCount(); i++){
+        MSG_PoolClassStats_t c;
+        if(MSG_Pool_GetClassStats(i, &c) && c.free_count && c.block_size > largest){
+            largest = c.block_size;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    return (largest > sizeof(MSG_Data_t)) ? (largest - sizeof(MSG_Data_t)) : 0;
+}
+
+uint8_t MSG_Base_SetOwner(uint8_t module){
+#ifdef MSG_BASE_ALLOC_TRACKING
+    uint8_t prev;
+    CRITICAL_REGION_ENTER();
+    prev = _tracking.owner;
+    _tracking.owner = module < OWNER_NONE ? module : OWNER_NONE;
+    CRITICAL_REGION_EXIT();
+    return prev;
+#else
+    return MOD_END;
+#endif
+}
+
+bool MSG_Base_HasMemoryLeak(void){
+    bool ret = false;
+#ifdef MSG_BASE_ALLOC_TRACKING
+    uint32_t now, age;
+    int i;
+    app_timer_cnt_get(&now);
+    CRITICAL_REGION_ENTER();
+    for(i = 0; i < MSG_BASE_ALLOC_TRACKING; i++){
+        const alloc_record_t * r = &_tracking.records[i];
+        if(r->obj){
+            app_timer_cnt_diff_compute(now, r->ticks, &age);
+            if(age > MSG_BASE_LEAK_TICKS){
+                ret = true;
+            }
+        }
+    }
+    CRITICAL_REGION_EXIT();
+#endif
+    return ret;
+}
+
+bool MSG_Base_GetAllocStats(uint8_t module, MSG_Base_AllocStats_t * out_stats){
+#ifdef MSG_BASE_ALLOC_TRACKING
+    int i;
+    if(module > OWNER_NONE || !out_stats){
+        return false;
+    }
+    memset(out_stats, 0, sizeof(*out_stats));
+    CRITICAL_REGION_ENTER();
+    out_stats->module = module;
+    for(i = 0; i < MSG_BASE_ALLOC_TRACKING; i++){
+        if(_tracking.records[i].obj && _tracking.records[i].module == module){
+            out_stats->live_count++;
+        }
+    }
+    out_stats->live_bytes = _tracking.live_bytes[module];
+    out_stats->peak_bytes = _tracking.peak_bytes[module];
+    out_stats->untracked = _tracking.untracked;
+    out_stats->heap_free = xPortGetFreeHeapSize();
+    out_stats->heap_min_free = xPortGetMinimumEverFreeHeapSize();
+    CRITICAL_REGION_EXIT();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MSG_Base_ResetAllocPeaks(void){
+#ifdef MSG_BASE_ALLOC_TRACKING
+    CRITICAL_REGION_ENTER();
+    memcpy(_tracking.peak_bytes, _tracking.live_bytes, sizeof(_tracking.peak_bytes));
+    _tracking.untracked = 0;
+    CRITICAL_REGION_EXIT();
+#endif
+}
+
+void MSG_Base_PrintAllocations(void){
+#ifdef MSG_BASE_ALLOC_TRACKING
+    alloc_record_t records[MSG_BASE_ALLOC_TRACKING];
+    uint16_t peaks[OWNER_NONE + 1];
+    uint16_t untracked;
+    uint32_t now, age;
+    int i,j;
+    //snapshot so printing does not hold the critical region
+    CRITICAL_REGION_ENTER();
+    memcpy(records, _tracking.records, sizeof(records));
+    memcpy(peaks, _tracking.peak_bytes, sizeof(peaks));
+    untracked = _tracking.untracked;
+    CRITICAL_REGION_EXIT();
+    app_timer_cnt_get(&now);
+    PRINTS("site mod: count bytes oldest(ticks)\r\n");
+    for(i = 0; i < MSG_BASE_ALLOC_TRACKING; i++){
+        uint16_t count = 0, bytes = 0;
+        uint32_t oldest = 0;
+        if(!records[i].obj){
+            continue;
+        }
+        //group by site and module, the first record of a group prints it
+        for(j = 0; j < i; j++){
+            if(records[j].obj && records[j].site == records[i].site && records[j].module == records[i].module){
+                break;
+            }
+        }
+        if(j < i){
+            continue;
+        }
+        for(j = i; j < MSG_BASE_ALLOC_TRACKING; j++){
+            if(records[j].obj && records[j].site == records[i].site && records[j].module == records[i].module){
+                count++;
+                bytes += records[j].size;
+                app_timer_cnt_diff_compute(now, records[j].ticks, &age);
+                if(age > oldest){
+                    oldest = age;
+                }
+            }
+        }
+        PRINTF("%x %u: %u %u %u\r\n", (uint32_t)(uintptr_t)records[i].site, records[i].module, count, bytes, oldest);
+    }
+    PRINTS("peak bytes per mod:");
+    for(i = 0; i <= OWNER_NONE; i++){
+        PRINTF(" %u", peaks[i]);
+    }
+    PRINTF("\r\nuntracked %u\r\n", untracked);
+#endif
+    PRINTF("heap free %u min ever %u\r\n", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
+}
 
 MSG_Data_t * INCREF MSG_Base_Dupe(MSG_Data_t * orig){
-    APP_OK(0);
-    return NULL;
+    MSG_Data_t * ret;
+    if(!orig){
+        return NULL;
+    }
+    ret = _allocate_data(orig->len, CALLER());
+    if(ret){
+        MSG_Base_Read(orig, 0, ret->buf, ret->len);
+    }
+    return ret;
 }
 MSG_Data_t * MSG_Base_ResizeObjectAtomic(MSG_Data_t * obj, size_t new_size){
     MSG_Data_t * ret = obj;
+    if(ret && (ret->context & MSG_DATA_CTX_CHAIN)){
+        return NULL;
+    }
+    if(ret && (ret->context & MSG_DATA_CTX_VIEW)){
+        //a view can only be resized within its parent
+        const MSG_View_t * view = (const MSG_View_t *)ret->buf;
+        if((uint32_t)view->offset + new_size > view->parent->len){
+            return NULL;
+        }
+        ret->len = new_size;
+        return ret;
+    }
     if(ret){
         DEBUGS("|");
+        size_t block_size;
         CRITICAL_REGION_ENTER();
-        ret = (MSG_Data_t*)pvPortRealloc(ret, new_size + sizeof(MSG_Data_t));
+        block_size = MSG_Pool_BlockSize(obj);
+        if(!block_size){
+            ret = (MSG_Data_t*)pvPortRealloc(ret, new_size + sizeof(MSG_Data_t));
+        }else if(new_size + sizeof(MSG_Data_t) > block_size){
+            //outgrew the slab, move it to a bigger block
+            ret = (MSG_Data_t*)_alloc(new_size + sizeof(MSG_Data_t));
+            if(ret){
+                memcpy(ret, obj, block_size);
+                _free(obj);
+            }
+        }
         if(ret){
+            _retrack(obj, ret, new_size + sizeof(MSG_Data_t));
             ret->len = new_size;
         }else{
             APP_OK(NRF_ERROR_NO_MEM);
@@ -44,41 +322,188 @@ MSG_Data_t * MSG_Base_ResizeObjectAtomic(MSG_Data_t * obj, size_t new_size){
     }
     return ret;
 }
-MSG_Data_t * MSG_Base_AllocateDataAtomic(size_t size){
+static MSG_Data_t *
+_allocate_data(size_t size, const void * site){
     void * mem;
     MSG_Data_t * msg;
     DEBUGS("+");
     CRITICAL_REGION_ENTER();
-    mem = pvPortMalloc(size + sizeof(MSG_Data_t));
+    mem = _alloc(size + sizeof(MSG_Data_t));
+    if(mem){
+        _track(mem, size + sizeof(MSG_Data_t), site);
+    }
     CRITICAL_REGION_EXIT();
     if(mem){
         msg = (MSG_Data_t*)mem;
         msg->len = size;
         msg->ref = 0;
+        msg->context = 0;
         incref(msg);
     }else{
         APP_OK(NRF_ERROR_NO_MEM);
     }
 	return (MSG_Data_t*)mem;
 }
+static MSG_Data_t *
+_allocate_object(const void * obj, size_t size, const void * site){
+    MSG_Data_t * ret = _allocate_data(size, site);
+    if(ret){
+        if(obj){
+            memcpy(ret->buf, (const uint8_t *)obj, size);
+        }
+    }
+    return ret;
+}
+MSG_Data_t * MSG_Base_AllocateDataAtomic(size_t size){
+    return _allocate_data(size, CALLER());
+}
 //TODO
 //this method is unsafe, switch to strncpy later
 MSG_Data_t * MSG_Base_AllocateStringAtomic(const char * str){
     if(!str){
         return NULL;
     }
-    return MSG_Base_AllocateObjectAtomic(str, strlen(str)+1);
+    return _allocate_object(str, strlen(str)+1, CALLER());
 }
 MSG_Data_t * INCREF MSG_Base_AllocateObjectAtomic(const void * obj, size_t size){
-    MSG_Data_t * ret = MSG_Base_AllocateDataAtomic(size);
+    return _allocate_object(obj, size, CALLER());
+}
+
+MSG_Data_t * INCREF MSG_Base_AllocateViewAtomic(MSG_Data_t * parent, uint16_t offset, uint16_t len){
+    MSG_Data_t * ret;
+    MSG_View_t * view;
+    if(!parent || (uint32_t)offset + len > parent->len){
+        return NULL;
+    }
+    if(parent->context & MSG_DATA_CTX_CHAIN){
+        //buf is the segment table, not data
+        return NULL;
+    }
+    if(parent->context & MSG_DATA_CTX_VIEW){
+        //collapse the chain, always point to the object that owns the memory
+        const MSG_View_t * outer = (const MSG_View_t *)parent->buf;
+        offset += outer->offset;
+        parent = outer->parent;
+    }
+    ret = _allocate_data(sizeof(MSG_View_t), CALLER());
     if(ret){
-        if(obj){
-            memcpy(ret->buf, (const uint8_t *)obj, size);
+        view = (MSG_View_t *)ret->buf;
+        view->parent = parent;
+        view->offset = offset;
+        ret->len = len;
+        ret->context = MSG_DATA_CTX_VIEW | MSG_DATA_CTX_READ_ONLY;
+        MSG_Base_AcquireDataAtomic(parent);
+    }
+    return ret;
+}
+
+uint8_t * MSG_Base_Buffer(const MSG_Data_t * d){
+    if(d->context & MSG_DATA_CTX_VIEW){
+        const MSG_View_t * view = (const MSG_View_t *)d->buf;
+        return view->parent->buf + view->offset;
+    }else if(d->context & MSG_DATA_CTX_CHAIN){
+        return NULL;
+    }
+    return (uint8_t *)d->buf;
+}
+
+MSG_Data_t * INCREF MSG_Base_AllocateChainAtomic(MSG_Data_t * const * segments, uint8_t count){
+    MSG_Chain_t chain = {0};
+    uint32_t total = 0;
+    MSG_Data_t * ret;
+    int i,j;
+    for(i = 0; i < count; i++){
+        const MSG_Data_t * seg = segments[i];
+        if(!seg){
+            return NULL;
+        }
+        if(seg->context & MSG_DATA_CTX_CHAIN){
+            const MSG_Chain_t * inner = (const MSG_Chain_t *)seg->buf;
+            for(j = 0; j < inner->count; j++){
+                if(chain.count >= MSG_CHAIN_MAX_SEGMENTS){
+                    return NULL;
+                }
+                chain.segments[chain.count++] = inner->segments[j];
+            }
+        }else{
+            if(chain.count >= MSG_CHAIN_MAX_SEGMENTS){
+                return NULL;
+            }
+            chain.segments[chain.count++] = (MSG_Data_t *)seg;
+        }
+        total += seg->len;
+    }
+    if(total > UINT16_MAX){
+        return NULL;
+    }
+    ret = _allocate_object(&chain, sizeof(chain), CALLER());
+    if(ret){
+        ret->len = total;
+        ret->context = MSG_DATA_CTX_CHAIN | MSG_DATA_CTX_READ_ONLY;
+        for(i = 0; i < chain.count; i++){
+            MSG_Base_AcquireDataAtomic(chain.segments[i]);
         }
     }
     return ret;
 }
 
+uint8_t MSG_Base_SegmentCount(const MSG_Data_t * d){
+    if(d->context & MSG_DATA_CTX_CHAIN){
+        return ((const MSG_Chain_t *)d->buf)->count;
+    }
+    return 1;
+}
+
+const uint8_t * MSG_Base_Segment(const MSG_Data_t * d, uint8_t index, uint16_t * out_len){
+    if(d->context & MSG_DATA_CTX_CHAIN){
+        const MSG_Chain_t * chain = (const MSG_Chain_t *)d->buf;
+        if(index >= chain->count){
+            *out_len = 0;
+            return NULL;
+        }
+        d = chain->segments[index];
+    }else if(index){
+        *out_len = 0;
+        return NULL;
+    }
+    *out_len = d->len;
+    return MSG_Base_Buffer(d);
+}
+
+uint16_t MSG_Base_Read(const MSG_Data_t * d, uint16_t offset, uint8_t * out, uint16_t len){
+    uint16_t copied = 0;
+    uint8_t i, count = MSG_Base_SegmentCount(d);
+    for(i = 0; i < count && copied < len; i++){
+        uint16_t seg_len, chunk;
+        const uint8_t * seg = MSG_Base_Segment(d, i, &seg_len);
+        if(offset >= seg_len){
+            offset -= seg_len;
+            continue;
+        }
+        chunk = MIN(seg_len - offset, len - copied);
+        memcpy(out + copied, seg + offset, chunk);
+        copied += chunk;
+        offset = 0;
+    }
+    return copied;
+}
+
+MSG_Data_t * INCREF MSG_Base_FlattenAtomic(MSG_Data_t * d){
+    MSG_Data_t * ret;
+    if(!d){
+        return NULL;
+    }
+    if(!(d->context & MSG_DATA_CTX_CHAIN)){
+        MSG_Base_AcquireDataAtomic(d);
+        return d;
+    }
+    ret = _allocate_data(d->len, CALLER());
+    if(ret){
+        MSG_Base_Read(d, 0, ret->buf, ret->len);
+    }
+    return ret;
+}
+
 MSG_Status MSG_Base_AcquireDataAtomic(MSG_Data_t * d){
     if(d){
         CRITICAL_REGION_ENTER();
@@ -100,12 +525,26 @@ MSG_Status MSG_Base_ReleaseDataAtomic(MSG_Data_t * d){
         decref(d);
         CRITICAL_REGION_EXIT();
         if(d->ref == 0){
+            MSG_Data_t * parent = NULL;
+            MSG_Chain_t chain = {0};
+            if(d->context & MSG_DATA_CTX_VIEW){
+                parent = ((MSG_View_t *)d->buf)->parent;
+            }else if(d->context & MSG_DATA_CTX_CHAIN){
+                chain = *(MSG_Chain_t *)d->buf;
+            }
             d->context = 0;
             DEBUGS("~");
             
             CRITICAL_REGION_ENTER();
-            vPortFree(d);
+            _untrack(d);
+            _free(d);
             CRITICAL_REGION_EXIT();
+            if(parent){
+                MSG_Base_ReleaseDataAtomic(parent);
+            }
+            while(chain.count){
+                MSG_Base_ReleaseDataAtomic(chain.segments[--chain.count]);
+            }
         }else{
             DEBUGS("-");
         };
@@ -19,6 +19,15 @@
  **/
 #define MSG_DATA_CTX_READ_ONLY 0x01 /* Read only Object */
 #define MSG_DATA_CTX_META_DATA 0x02 /* Contains metadata instead of normal data */
+#define MSG_DATA_CTX_VIEW 0x04 /* buf holds a MSG_View_t, use MSG_Base_Buffer to reach the data */
+#define MSG_DATA_CTX_CHAIN 0x08 /* buf holds a MSG_Chain_t, use MSG_Base_Read or MSG_Base_Segment */
+
+/**
+ * max number of segments in a chained object
+ */
+#ifndef MSG_CHAIN_MAX_SEGMENTS
+#define MSG_CHAIN_MAX_SEGMENTS 4
+#endif
 #define MSG_DATA_CTX_RETURN_TO_SENDER 0x80 /* not implemented yet */
 
 typedef struct _MSG_Data_t{
@@ -40,6 +49,25 @@ typedef struct _MSG_Data_t{
     uint8_t buf[0];
 } MSG_Data_t;
 
+/*
+ * A view is a read only window onto another object's buffer.
+ * It holds a reference to its parent, so the parent lives as long as any view does.
+ */
+typedef struct{
+    MSG_Data_t * parent;
+    uint16_t offset;
+}MSG_View_t;
+
+/*
+ * A chain presents several objects (plain or views) as one message of
+ * the summed length, so headers can be prepended without reallocation.
+ * The chain holds a reference to every segment.
+ */
+typedef struct{
+    uint8_t count;
+    MSG_Data_t * segments[MSG_CHAIN_MAX_SEGMENTS];
+}MSG_Chain_t;
+
 typedef enum{
     CENTRAL = 0,
     UART,
@@ -68,6 +96,28 @@ typedef struct{
 }MSG_Address_t;
 
 #define ADDR(a,b) ((MSG_Address_t){a,b})
+
+/**
+ * Dispatch priority, lower value is delivered first
+ */
+typedef enum{
+    MSG_PRIORITY_HIGH = 0,
+    MSG_PRIORITY_NORMAL,
+    MSG_PRIORITY_LOW,
+    MSG_PRIORITY_NUM
+}MSG_Priority;
+/**
+ * Publish/subscribe topics
+ * a publish is queued once and delivers the same object to every subscriber in one scheduler slot
+ */
+typedef enum{
+    MSG_TOPIC_PILL_MOTION = 0,  //pill: encrypted motion payload, once a minute
+    MSG_TOPIC_PILL_DATA,        //morpheus: encoded MorpheusCommand built from pill data
+    MSG_TOPIC_PILL_RAW,         //morpheus: MSG_ANT_PillData_t as received over ANT
+    MSG_TOPIC_ANT_SENT,         //pill: a full duplex message the central echoed in full, the same object that was queued
+    MSG_TOPIC_PILL_BATCH,       //morpheus: encoded batched_pill_data, pill data of a batching window
+    MSG_TOPIC_NUM
+}MSG_Topic;
 /**
  * Message object.
  * All modules that implements message capability must define the struct
@@ -88,18 +138,118 @@ typedef struct{
  * all Base objects will send messages to central and then dispatch to respective modules.
  */
 typedef struct{
+    /*
+     * dispatch with the default priority of the destination module
+     */
     MSG_Status ( *dispatch )(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data);
+    MSG_Status ( *dispatch_priority )(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, MSG_Priority priority);
     MSG_Status ( *loadmod )(MSG_Base_t * mod);
     MSG_Status ( *unloadmod )(MSG_Base_t * mod);
+    /*
+     * dst receives every object published on topic, OOM if the topic is full
+     */
+    MSG_Status ( *subscribe )(MSG_Topic topic, MSG_Address_t dst);
+    MSG_Status ( *unsubscribe )(MSG_Topic topic, MSG_Address_t dst);
+    /*
+     * queued at the highest priority among the subscribers, SUCCESS with no subscribers
+     */
+    MSG_Status ( *publish )(MSG_Address_t src, MSG_Topic topic, MSG_Data_t * data);
+    /*
+     * timed dispatch, all entries share one app_timer so work due in the same tick costs one wakeup
+     * dispatch_at delivers once, ticks (app_timer ticks) from now
+     * dispatch_every delivers every period ticks, aligned to multiples of period so equal
+     * and multiple periods (1 s and 1 min) always fire together, the first delivery may come early
+     * data is held until the entry fires for the last time or is cancelled
+     * returns a handle for cancel, MSG_TIMED_NONE if all MSG_CENTRAL_TIMED_SLOTS are in use or
+     * ticks is over 0x7FFFFFFF, cancel fails on a handle whose entry has fired or been cancelled
+     * an entry that finds its queue full stays due and goes again with the next wakeup, a one shot
+     * has only fired once its dispatch went through
+     */
+    uint8_t ( *dispatch_at )(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, uint32_t ticks);
+    uint8_t ( *dispatch_every )(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data, uint32_t period);
+    MSG_Status ( *cancel )(uint8_t handle);
 }MSG_Central_t;
+#define MSG_TIMED_NONE 0xFF
 
 
 MSG_Data_t * INCREF MSG_Base_AllocateDataAtomic(size_t size);
 MSG_Data_t * INCREF MSG_Base_AllocateStringAtomic(const char * str);
 MSG_Data_t * INCREF MSG_Base_AllocateObjectAtomic(const void * obj, size_t size);
+/*
+ * copies any object, views and chains included, into a new plain object
+ */
 MSG_Data_t * INCREF MSG_Base_Dupe(MSG_Data_t * orig);
+/*
+ * creates a view of len bytes starting at offset of parent without copying
+ * views of views point straight at the original object
+ * chains are refused with NULL, flatten them first
+ */
+MSG_Data_t * INCREF MSG_Base_AllocateViewAtomic(MSG_Data_t * parent, uint16_t offset, uint16_t len);
+/*
+ * returns the start of the data, resolving views
+ * consumers that may receive views must use this instead of ->buf
+ * chains are not contiguous and return NULL, see MSG_Base_FlattenAtomic
+ */
+uint8_t * MSG_Base_Buffer(const MSG_Data_t * d);
+/*
+ * creates a chain of count segments, nested chains are expanded in place
+ * returns NULL if the result would exceed MSG_CHAIN_MAX_SEGMENTS
+ */
+MSG_Data_t * INCREF MSG_Base_AllocateChainAtomic(MSG_Data_t * const * segments, uint8_t count);
+/*
+ * number of contiguous segments of an object, 1 for anything but a chain
+ */
+uint8_t MSG_Base_SegmentCount(const MSG_Data_t * d);
+const uint8_t * MSG_Base_Segment(const MSG_Data_t * d, uint8_t index, uint16_t * out_len);
+/*
+ * copies up to len bytes starting at offset into out, returns bytes copied
+ */
+uint16_t MSG_Base_Read(const MSG_Data_t * d, uint16_t offset, uint8_t * out, uint16_t len);
+/*
+ * returns a contiguous object with the same content
+ * this is d itself (with a new reference) unless d is a chain
+ */
+MSG_Data_t * INCREF MSG_Base_FlattenAtomic(MSG_Data_t * d);
+/*
+ * free heap and pool bytes, for reports only, it adds up free pool blocks
+ * and heap fragments that no one large object fits into
+ */
 uint32_t MSG_Base_FreeCount(void);
+/*
+ * largest len a single allocation can take right now, gate allocations on this
+ */
+uint32_t MSG_Base_LargestFree(void);
+/*
+ * Allocation tracking, enabled by defining MSG_BASE_ALLOC_TRACKING (number of tracked objects) in message_config.h
+ * every live object records its allocation site, owning module and rtc ticks,
+ * the owner is the module whose handler is running (MOD_END outside of handlers)
+ */
+typedef struct{
+    uint8_t module;
+    uint8_t live_count;
+    uint16_t live_bytes;
+    uint16_t peak_bytes;    //since boot or MSG_Base_ResetAllocPeaks
+    uint16_t untracked;     //allocations missed because the table was full
+    uint16_t heap_free;
+    uint16_t heap_min_free;
+}MSG_Base_AllocStats_t;
+/*
+ * sets the module new allocations are charged to, returns the previous owner
+ */
+uint8_t MSG_Base_SetOwner(uint8_t module);
+/*
+ * true if a tracked object has been alive longer than MSG_BASE_LEAK_TICKS, always false without tracking
+ */
 bool MSG_Base_HasMemoryLeak(void);
+/*
+ * returns false if tracking is compiled out
+ */
+bool MSG_Base_GetAllocStats(uint8_t module, MSG_Base_AllocStats_t * out_stats);
+void MSG_Base_ResetAllocPeaks(void);
+/*
+ * prints live objects grouped by site and module, peak bytes per module and heap watermarks
+ */
+void MSG_Base_PrintAllocations(void);
 MSG_Data_t * MSG_Base_ResizeObjectAtomic(MSG_Data_t * obj, size_t new_size);
 
 MSG_Status   INCREF MSG_Base_AcquireDataAtomic(MSG_Data_t * d);
@@ -0,0 +1,185 @@
+#include <stddef.h>
+#include <string.h>
+#include "message_pool.h"
+#include "heap.h"
+
+#ifdef MSG_BASE_POOL_CLASS_SIZES
+
+static const uint16_t _class_sizes[] = MSG_BASE_POOL_CLASS_SIZES;
+static const uint8_t _class_counts[] = MSG_BASE_POOL_CLASS_COUNTS;
+
+#define POOL_NUM_CLASSES (sizeof(_class_sizes)/sizeof(_class_sizes[0]))
+
+typedef struct _pool_block{
+    struct _pool_block * next;
+}pool_block_t;
+
+typedef struct{
+    uint8_t * start;
+    uint8_t * end;
+    pool_block_t * free;
+    uint8_t free_count;
+    uint8_t min_free_count;
+}pool_class_t;
+
+static struct{
+    pool_class_t classes[POOL_NUM_CLASSES];
+    /*
+     * 0: not initialized, 1: ready, 2: arena allocation failed, heap only
+     */
+    uint8_t state;
+}self;
+
+static void
+_init(void){
+    size_t total = 0;
+    uint8_t * arena;
+    int i,j;
+    for(i = 0; i < POOL_NUM_CLASSES; i++){
+        total += (size_t)_class_sizes[i] * _class_counts[i];
+    }
+    arena = (uint8_t*)pvPortMalloc(total);
+    if(!arena){
+        self.state = 2;
+        return;
+    }
+    for(i = 0; i < POOL_NUM_CLASSES; i++){
+        pool_class_t * c = &self.classes[i];
+        c->start = arena;
+        c->free = NULL;
+        for(j = _class_counts[i] - 1; j >= 0; j--){
+            pool_block_t * b = (pool_block_t*)(arena + (size_t)j * _class_sizes[i]);
+            b->next = c->free;
+            c->free = b;
+        }
+        arena += (size_t)_class_sizes[i] * _class_counts[i];
+        c->end = arena;
+        c->free_count = _class_counts[i];
+        c->min_free_count = _class_counts[i];
+    }
+    self.state = 1;
+}
+
+static pool_class_t *
+_find_class(const void * mem, int * out_index){
+    const uint8_t * p = (const uint8_t*)mem;
+    int i;
+    if(self.state != 1){
+        return NULL;
+    }
+    for(i = 0; i < POOL_NUM_CLASSES; i++){
+        if(p >= self.classes[i].start && p < self.classes[i].end){
+            if(out_index){
+                *out_index = i;
+            }
+            return &self.classes[i];
+        }
+    }
+    return NULL;
+}
+
+void * MSG_Pool_Alloc(size_t size){
+    int i, last;
+    if(!self.state){
+        _init();
+    }
+    if(self.state != 1){
+        return NULL;
+    }
+    /* classes are sorted ascending, find the smallest one that fits */
+    for(i = 0; i < POOL_NUM_CLASSES && size > _class_sizes[i]; i++){
+    }
+    /*
+     * take it or the next one up, anything bigger wastes a block a later
+     * message of that size needs, the heap is the better fallback then
+     */
+    for(last = i + 1; i <= last && i < POOL_NUM_CLASSES; i++){
+        pool_class_t * c = &self.classes[i];
+        if(c->free){
+            pool_block_t * b = c->free;
+            c->free = b->next;
+            c->free_count--;
+            if(c->free_count < c->min_free_count){
+                c->min_free_count = c->free_count;
+            }
+            return b;
+        }
+    }
+    return NULL;
+}
+
+bool MSG_Pool_Free(void * mem){
+    pool_class_t * c = _find_class(mem, NULL);
+    if(c){
+        pool_block_t * b = (pool_block_t*)mem;
+        b->next = c->free;
+        c->free = b;
+        c->free_count++;
+        return true;
+    }
+    return false;
+}
+
+size_t MSG_Pool_BlockSize(const void * mem){
+    int i;
+    if(_find_class(mem, &i)){
+        return _class_sizes[i];
+    }
+    return 0;
+}
+
+size_t MSG_Pool_FreeBytes(void){
+    size_t ret = 0;
+    int i;
+    if(self.state != 1){
+        return 0;
+    }
+    for(i = 0; i < POOL_NUM_CLASSES; i++){
+        ret += (size_t)self.classes[i].free_count * _class_sizes[i];
+    }
+    return ret;
+}
+
+uint8_t MSG_Pool_ClassCount(void){
+    return POOL_NUM_CLASSES;
+}
+
+bool MSG_Pool_GetClassStats(uint8_t index, MSG_PoolClassStats_t * out_stats){
+    if(index >= POOL_NUM_CLASSES || !out_stats){
+        return false;
+    }
+    out_stats->block_size = _class_sizes[index];
+    out_stats->block_count = _class_counts[index];
+    if(self.state == 1){
+        out_stats->free_count = self.classes[index].free_count;
+        out_stats->min_free_count = self.classes[index].min_free_count;
+    }else{
+        out_stats->free_count = 0;
+        out_stats->min_free_count = 0;
+    }
+    return true;
+}
+
+#else
+/*
+ * pool disabled, everything goes to the heap
+ */
+void * MSG_Pool_Alloc(size_t size){
+    return NULL;
+}
+bool MSG_Pool_Free(void * mem){
+    return false;
+}
+size_t MSG_Pool_BlockSize(const void * mem){
+    return 0;
+}
+size_t MSG_Pool_FreeBytes(void){
+    return 0;
+}
+uint8_t MSG_Pool_ClassCount(void){
+    return 0;
+}
+bool MSG_Pool_GetClassStats(uint8_t index, MSG_PoolClassStats_t * out_stats){
+    return false;
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+/**
+ * Fixed size slab pool for MSG_Data_t objects.
+ *
+ * The pool carves one arena out of the heap the first time it is used and
+ * splits it into a handful of size classes (configured by the app through
+ * MSG_BASE_POOL_CLASS_SIZES and MSG_BASE_POOL_CLASS_COUNTS in message_config.h).
+ * Each class keeps an intrusive free list so alloc and free are O(1) and
+ * short lived messages never fragment the heap.
+ * A request takes a block from the smallest class that fits or the one above,
+ * never further up. Requests that do not fit, or find both classes empty,
+ * return NULL, callers are expected to fall back to the heap.
+ *
+ * None of the functions here are atomic, callers must hold a critical region.
+ */
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "message_config.h"
+
+typedef struct{
+    uint16_t block_size;
+    uint8_t block_count;
+    uint8_t free_count;
+    uint8_t min_free_count;
+}MSG_PoolClassStats_t;
+
+/*
+ * returns a block of at least size bytes, or NULL if neither the smallest class that fits nor the next one can serve it
+ */
+void * MSG_Pool_Alloc(size_t size);
+/*
+ * returns true if the pointer belongs to the pool and has been released
+ */
+bool MSG_Pool_Free(void * mem);
+/*
+ * returns the usable size of the block that holds mem, 0 if mem is not from the pool
+ */
+size_t MSG_Pool_BlockSize(const void * mem);
+/*
+ * total number of bytes sitting in free blocks
+ */
+size_t MSG_Pool_FreeBytes(void);
+/*
+ * number of configured size classes, 0 when the pool is disabled
+ */
+uint8_t MSG_Pool_ClassCount(void);
+bool MSG_Pool_GetClassStats(uint8_t index, MSG_PoolClassStats_t * out_stats);
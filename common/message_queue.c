@@ -0,0 +1,195 @@
+#include <stddef.h>
+#include <app_util.h>
+#include "message_queue.h"
+#include "heap.h"
+
+/*
+ * head is only written by producers, tail only by the consumer.
+ * Both are free running, the slot index is counter & mask and the depth is
+ * head - tail in 8 bits, which is why capacity stops at 128.
+ * The exception is MSG_QUEUE_DROP_OLDEST, where a producer advances tail, and
+ * MSG_QUEUE_COALESCE, where it rewrites queued entries. Both need the consumer
+ * locked out, so pop takes the critical region too on those queues.
+ */
+struct MSG_Queue_t{
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    uint8_t mask;
+    uint8_t mode;
+    uint8_t policy;
+    bool locked;    //push needs the critical region
+    /* producer side statistics */
+    uint8_t high_water;
+    uint16_t drops;
+    uint16_t evictions;
+    uint16_t coalesced;
+    uint32_t pushed;
+    MSG_QueueEntry_t entries[];
+};
+
+/*
+ * the M0 is single core and in order, the entry only has to reach memory
+ * before the index that publishes it, so a compiler barrier is enough
+ * (multi core host builds swap in a real fence)
+ */
+#ifndef QUEUE_BARRIER
+#define QUEUE_BARRIER() __asm__ volatile("" ::: "memory")
+#endif
+
+MSG_Queue_t * MSG_Queue_Init(uint8_t capacity, MSG_QueueMode mode){
+    MSG_Queue_t * ret;
+    if(!capacity || capacity > 128 || (capacity & (capacity - 1))){
+        return NULL;
+    }
+    ret = pvPortMalloc(sizeof(*ret) + capacity * sizeof(MSG_QueueEntry_t));
+    if(ret){
+        ret->head = 0;
+        ret->tail = 0;
+        ret->mask = capacity - 1;
+        ret->mode = mode;
+        ret->policy = MSG_QUEUE_DROP_NEWEST;
+        ret->locked = (mode == MSG_QUEUE_MPSC);
+        ret->high_water = 0;
+        ret->drops = 0;
+        ret->evictions = 0;
+        ret->coalesced = 0;
+        ret->pushed = 0;
+    }
+    return ret;
+}
+
+void MSG_Queue_SetPolicy(MSG_Queue_t * queue, uint8_t policy){
+    queue->policy = policy;
+    queue->locked = (queue->mode == MSG_QUEUE_MPSC) || (policy != MSG_QUEUE_DROP_NEWEST);
+}
+
+static MSG_QueueEntry_t *
+_find_tag(const MSG_Queue_t * queue, uint8_t tag){
+    uint8_t i;
+    if(tag == MSG_QUEUE_NO_TAG || !(queue->policy & MSG_QUEUE_COALESCE)){
+        return NULL;
+    }
+    for(i = queue->tail; i != queue->head; i++){
+        const MSG_QueueEntry_t * e = &queue->entries[i & queue->mask];
+        if(e->tag == tag){
+            return (MSG_QueueEntry_t *)e;
+        }
+    }
+    return NULL;
+}
+
+static bool
+_push(MSG_Queue_t * queue, MSG_Data_t * msg, MSG_Address_t address, uint8_t tag){
+    uint8_t head = queue->head;
+    uint8_t depth = (uint8_t)(head - queue->tail);
+    MSG_QueueEntry_t * same = _find_tag(queue, tag);
+    if(same){
+        MSG_Base_ReleaseDataAtomic(same->msg);
+        same->msg = msg;
+        same->address = address;
+        queue->coalesced++;
+        queue->pushed++;
+        return true;
+    }
+    if(depth > queue->mask){
+        if(!(queue->policy & MSG_QUEUE_DROP_OLDEST)){
+            queue->drops++;
+            return false;
+        }
+        MSG_Base_ReleaseDataAtomic(queue->entries[queue->tail & queue->mask].msg);
+        queue->tail = queue->tail + 1;
+        queue->evictions++;
+        depth--;
+    }
+    queue->entries[head & queue->mask] = (MSG_QueueEntry_t){
+        .msg = msg,
+        .address = address,
+        .tag = tag,
+    };
+    QUEUE_BARRIER();
+    queue->head = head + 1;
+    queue->pushed++;
+    if(depth + 1 > queue->high_water){
+        queue->high_water = depth + 1;
+    }
+    return true;
+}
+
+bool MSG_Queue_PushTagged(MSG_Queue_t * queue, MSG_Data_t * msg, MSG_Address_t address, uint8_t tag){
+    bool ret;
+    if(!queue->locked){
+        return _push(queue, msg, address, tag);
+    }
+    CRITICAL_REGION_ENTER();
+    ret = _push(queue, msg, address, tag);
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+
+bool MSG_Queue_Push(MSG_Queue_t * queue, MSG_Data_t * msg, MSG_Address_t address){
+    return MSG_Queue_PushTagged(queue, msg, address, MSG_QUEUE_NO_TAG);
+}
+
+MSG_QueuePressure MSG_Queue_Pressure(const MSG_Queue_t * queue, uint8_t tag){
+    MSG_QueuePressure ret = MSG_QUEUE_PRESSURE_NONE;
+    uint8_t depth;
+    CRITICAL_REGION_ENTER();
+    depth = MSG_Queue_Depth(queue);
+    if(_find_tag(queue, tag)){
+        ret = MSG_QUEUE_PRESSURE_HIGH;
+    }else if(depth > queue->mask){
+        ret = (queue->policy & MSG_QUEUE_DROP_OLDEST) ? MSG_QUEUE_PRESSURE_HIGH : MSG_QUEUE_PRESSURE_FULL;
+    }else if(depth >= (queue->mask + 1) - ((queue->mask + 1) >> 2)){
+        ret = MSG_QUEUE_PRESSURE_HIGH;
+    }
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+
+const MSG_QueueEntry_t * MSG_Queue_Peek(MSG_Queue_t * queue){
+    uint8_t tail = queue->tail;
+    if(tail == queue->head){
+        return NULL;
+    }
+    QUEUE_BARRIER();
+    return &queue->entries[tail & queue->mask];
+}
+
+static bool
+_pop(MSG_Queue_t * queue, MSG_QueueEntry_t * out_entry){
+    const MSG_QueueEntry_t * head = MSG_Queue_Peek(queue);
+    if(!head){
+        return false;
+    }
+    if(out_entry){
+        *out_entry = *head;
+    }
+    QUEUE_BARRIER();
+    queue->tail = queue->tail + 1;
+    return true;
+}
+
+bool MSG_Queue_Pop(MSG_Queue_t * queue, MSG_QueueEntry_t * out_entry){
+    bool ret;
+    if(queue->policy == MSG_QUEUE_DROP_NEWEST){
+        return _pop(queue, out_entry);
+    }
+    CRITICAL_REGION_ENTER();
+    ret = _pop(queue, out_entry);
+    CRITICAL_REGION_EXIT();
+    return ret;
+}
+
+uint8_t MSG_Queue_Depth(const MSG_Queue_t * queue){
+    return (uint8_t)(queue->head - queue->tail);
+}
+
+void MSG_Queue_GetStats(const MSG_Queue_t * queue, MSG_QueueStats_t * out_stats){
+    out_stats->capacity = queue->mask + 1;
+    out_stats->depth = MSG_Queue_Depth(queue);
+    out_stats->high_water = queue->high_water;
+    out_stats->drops = queue->drops;
+    out_stats->evictions = queue->evictions;
+    out_stats->coalesced = queue->coalesced;
+    out_stats->pushed = queue->pushed;
+}
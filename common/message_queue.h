@@ -0,0 +1,102 @@
+#pragma once
+/**
+ * Fixed capacity queue of MSG_Data_t handles (plus an address) for handing
+ * messages between the main loop and interrupt context.
+ *
+ * MSG_QUEUE_SPSC: exactly one producer context and one consumer context.
+ * Push and pop never disable interrupts, each side only writes its own index
+ * and the single byte stores are atomic on the Cortex-M0.
+ * MSG_QUEUE_MPSC: several producers that may preempt each other (interrupts of
+ * different priority, or main and an interrupt), one consumer. Push holds a
+ * critical region for a handful of instructions, pop stays lock free.
+ *
+ * The queue stores the reference as is, pushing hands the caller's reference
+ * over to whoever pops it. A failed push leaves the reference with the caller.
+ *
+ * What happens when the queue is full is the queue's policy, see
+ * MSG_Queue_SetPolicy. Producers ask MSG_Queue_Pressure before they spend
+ * heap or crypto on a message the queue would throw away.
+ */
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "message_base.h"
+
+typedef enum{
+    MSG_QUEUE_SPSC = 0,
+    MSG_QUEUE_MPSC,
+}MSG_QueueMode;
+
+/*
+ * overflow policy, optionally or'ed with MSG_QUEUE_COALESCE
+ */
+typedef enum{
+    /* a push into a full queue fails, default */
+    MSG_QUEUE_DROP_NEWEST = 0,
+    /* a push into a full queue evicts and releases the oldest entry */
+    MSG_QUEUE_DROP_OLDEST = 1,
+    /*
+     * a tagged push replaces (and releases) a queued entry with the same tag,
+     * keeping its place in line, only the latest heartbeat or status matters
+     */
+    MSG_QUEUE_COALESCE = 2,
+}MSG_QueuePolicy;
+
+typedef enum{
+    MSG_QUEUE_PRESSURE_NONE = 0,
+    /* at least 3/4 full, or the push would evict or replace something */
+    MSG_QUEUE_PRESSURE_HIGH,
+    /* the push would be dropped, don't bother building the message */
+    MSG_QUEUE_PRESSURE_FULL,
+}MSG_QueuePressure;
+
+#define MSG_QUEUE_NO_TAG 0xFF
+
+typedef struct{
+    MSG_Data_t * msg;
+    MSG_Address_t address;
+    uint8_t tag;
+}MSG_QueueEntry_t;
+
+typedef struct{
+    uint8_t capacity;
+    uint8_t depth;
+    uint8_t high_water;
+    uint16_t drops;
+    uint16_t evictions;
+    uint16_t coalesced;
+    uint32_t pushed;
+}MSG_QueueStats_t;
+
+typedef struct MSG_Queue_t MSG_Queue_t;
+
+/*
+ * capacity is in entries, power of two and at most 128
+ * returns NULL on a bad capacity or when the heap is out of memory
+ */
+MSG_Queue_t * MSG_Queue_Init(uint8_t capacity, MSG_QueueMode mode);
+/*
+ * anything but plain MSG_QUEUE_DROP_NEWEST lets the producer touch entries
+ * the consumer owns, push and pop then run inside a critical region
+ */
+void MSG_Queue_SetPolicy(MSG_Queue_t * queue, uint8_t policy);
+/*
+ * producer side, returns false and counts a drop when the message was not queued
+ */
+bool MSG_Queue_Push(MSG_Queue_t * queue, MSG_Data_t * msg, MSG_Address_t address);
+bool MSG_Queue_PushTagged(MSG_Queue_t * queue, MSG_Data_t * msg, MSG_Address_t address, uint8_t tag);
+/*
+ * what a push with this tag would run into right now
+ */
+MSG_QueuePressure MSG_Queue_Pressure(const MSG_Queue_t * queue, uint8_t tag);
+/*
+ * consumer side, returns false when the queue is empty
+ */
+bool MSG_Queue_Pop(MSG_Queue_t * queue, MSG_QueueEntry_t * out_entry);
+/*
+ * consumer side, the head entry stays valid until the next pop
+ * only on MSG_QUEUE_DROP_NEWEST queues, other policies may replace it under you
+ */
+const MSG_QueueEntry_t * MSG_Queue_Peek(MSG_Queue_t * queue);
+uint8_t MSG_Queue_Depth(const MSG_Queue_t * queue);
+void MSG_Queue_GetStats(const MSG_Queue_t * queue, MSG_QueueStats_t * out_stats);
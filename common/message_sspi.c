@@ -2,7 +2,7 @@
 #include <nrf_gpio.h>
 #include "util.h"
 #include <string.h>
-#include "hlo_queue.h"
+#include "message_queue.h"
 
 #define REG_READ_FROM_SSPI  0
 #define REG_WRITE_TO_SSPI 1
@@ -13,11 +13,6 @@ typedef enum{
     ERROR
 }SSPIState;
 
-typedef struct{
-    MSG_Data_t * msg;
-    MSG_Address_t address;
-}queue_message_t;
-
 static struct{
     MSG_Base_t base;
     const MSG_Central_t * parent;
@@ -50,9 +45,10 @@ static struct{
 
     /*
      * Only one queue_tx right now
+     * main loop produces, _spi_evt_handler consumes from interrupt context
      */
     uint8_t dummy[4];
-    hlo_queue_t * tx_queue;
+    MSG_Queue_t * tx_queue;
 }self;
 
 static char * name = "SSPI";
@@ -68,8 +64,8 @@ _reset(void){
     return IDLE;
 }
 static uint32_t
-_dequeue_tx(queue_message_t * out_msg){
-    uint32_t ret = hlo_queue_read(self.tx_queue, (unsigned char *)out_msg, sizeof(*out_msg));
+_dequeue_tx(MSG_QueueEntry_t * out_msg){
+    uint32_t ret = MSG_Queue_Pop(self.tx_queue, out_msg) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND;
 #ifdef PLATFORM_HAS_SSPI
     if(ret != NRF_SUCCESS && SSPI_INT != 0){
         DEBUGS("spi_low\r\n");
@@ -80,13 +76,7 @@ _dequeue_tx(queue_message_t * out_msg){
 }
 static uint32_t
 _queue_tx(MSG_Data_t * o, MSG_Address_t address){
-    queue_message_t msg = {
-        .msg = o,
-        .address = address,
-    };
-    if( hlo_queue_empty_size(self.tx_queue) >= sizeof(msg) ){
-        hlo_queue_write(self.tx_queue, (unsigned char*)&msg, sizeof(msg));
-    }else{
+    if( !MSG_Queue_Push(self.tx_queue, o, address) ){
         return 1;
     }
 #ifdef PLATFORM_HAS_SSPI
@@ -114,7 +104,7 @@ _initialize_transaction(){
             DEBUGS("WRITE TO MASTER\r\n");
             //prepare buffer here
             {
-                queue_message_t msg = {0};
+                MSG_QueueEntry_t msg = {0};
                 if(NRF_SUCCESS == _dequeue_tx(&msg)){
                     self.transaction.payload = msg.msg;
                     //swapping byte order for transmission
@@ -162,7 +152,7 @@ _handle_transaction(){
         case WRITE_TX_BUF:
             DEBUGS("@WRITE TX BUF\r\n");
             if(self.transaction.payload){
-                spi_slave_buffers_set(self.transaction.payload->buf, self.dummy, self.transaction.context_reg.length, sizeof(self.dummy));
+                spi_slave_buffers_set(MSG_Base_Buffer(self.transaction.payload), self.dummy, self.transaction.context_reg.length, sizeof(self.dummy));
                 self.transaction.state = FIN_WRITE;
             }else{
                 //no buffer wat do?
@@ -178,8 +168,8 @@ _handle_transaction(){
              *PRINTS(" ADDR  = ");
              *PRINT_HEX(&self.transaction.context_reg.pad, sizeof(uint16_t));
              */
-            //send and release
-            self.parent->dispatch( (MSG_Address_t){SSPI, 1}, (MSG_Address_t){BLE, 1}, self.transaction.payload);
+            //send and release, completed reads jump ahead of queued traffic
+            self.parent->dispatch_priority( (MSG_Address_t){SSPI, 1}, (MSG_Address_t){BLE, 1}, self.transaction.payload, MSG_PRIORITY_HIGH);
             //self.parent->dispatch( (MSG_Address_t){SSPI, 1}, (MSG_Address_t){UART, 1}, self.transaction.payload);
 
             if(self.transaction.payload){
@@ -223,24 +213,28 @@ _flush(void){
 static MSG_Status
 _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
     if(data){
+        MSG_Address_t address;
+        MSG_Data_t * payload;
         switch(dst.submodule){
             case 0:
                 //fallthrough for backward compatibility
             case 1:
-                if(0 == _queue_tx(data, ADDR(0, 0))){
-                    MSG_Base_AcquireDataAtomic(data);
-                }else{
-                    return FAIL;
-                }
+                address = ADDR(0, 0);
                 break;
             default:
-                if(0 == _queue_tx(data, ADDR(0, dst.submodule))){
-                    MSG_Base_AcquireDataAtomic(data);
-                }else{
-                    return FAIL;
-                }
+                address = ADDR(0, dst.submodule);
                 break;
         }
+        //spi slave shifts out of a single buffer, chains get flattened here
+        payload = MSG_Base_FlattenAtomic(data);
+        if(!payload){
+            return OOM;
+        }
+        if(0 != _queue_tx(payload, address)){
+            DEBUGS("SSPI tx full, dropped\r\n");
+            MSG_Base_ReleaseDataAtomic(payload);
+            return FAIL;
+        }
     }
     return SUCCESS;
 }
@@ -291,7 +285,7 @@ _init(){
     }
 #endif
     self.current_state = _reset();
-    self.tx_queue = hlo_queue_init(64);
+    self.tx_queue = MSG_Queue_Init(8, MSG_QUEUE_SPSC);
     APP_ASSERT(self.tx_queue);
     return SUCCESS;
 
@@ -313,3 +307,9 @@ MSG_Base_t * MSG_SSPI_Base(const spi_slave_config_t * p_spi_slave_config, const
     }
     return &self.base;
 }
+MSG_QueuePressure MSG_SSPI_TxPressure(void){
+    if(!self.tx_queue){
+        return MSG_QUEUE_PRESSURE_NONE;
+    }
+    return MSG_Queue_Pressure(self.tx_queue, MSG_QUEUE_NO_TAG);
+}
@@ -2,12 +2,19 @@
 #include <stddef.h>
 #include "spi_slave.h"
 #include "message_base.h"
+#include "message_queue.h"
 
 
 typedef enum{
     MSG_SSPI_DEFAULT = 0,
     MSG_SSPI_MORPHEUS_BLE_PROTO = 1,
     MSG_SSPI_TEXT,
+    MSG_SSPI_PILL_BATCH,    //encoded batched_pill_data instead of a MorpheusCommand
 }MSG_SSPI_Ports;
 
 MSG_Base_t * MSG_SSPI_Base(const spi_slave_config_t * p_spi_slave_config, const MSG_Central_t * parent);
+/*
+ * backpressure on the queue towards the cc3200, producers check it before
+ * encoding, MSG_QUEUE_PRESSURE_FULL means the message would be dropped
+ */
+MSG_QueuePressure MSG_SSPI_TxPressure(void);
@@ -32,6 +32,16 @@ _printblocking(const uint8_t * d, uint32_t len, int hex_enable){
 
 }
 
+static void
+_print_segments(const MSG_Data_t * data, int hex_enable){
+    uint8_t i;
+    for(i = 0; i < MSG_Base_SegmentCount(data); i++){
+        uint16_t len;
+        const uint8_t * seg = MSG_Base_Segment(data, i, &len);
+        _printblocking(seg, len, hex_enable);
+    }
+}
+
 static MSG_Status
 _destroy(void){
     return SUCCESS;
@@ -48,14 +58,14 @@ _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data){
         }else if(dst.submodule == MSG_UART_HEX){
             //only 1 connection
             _printblocking("\r\n<data>",8, 0);
-            _printblocking(data->buf,data->len,1);
+            _print_segments(data, 1);
             _printblocking("</data>\r\n",9, 0);
         }else if(dst.submodule == MSG_UART_SLIP){
             uint8_t test_slip[] = {0xc0, 0xc1, 0xae, 0x00, 0x91, 0x02, 0x00, 0x00, 0x00, 0xb8, 0x43, 0x00, 0x00, 0xe1, 0x38, 0xc0};
             _printblocking(test_slip,sizeof(test_slip), 0);
         }else if(dst.submodule == MSG_UART_STRING){
             _printblocking("\r\n<data>",8, 0);
-            _printblocking(data->buf,data->len,0);
+            _print_segments(data, 0);
             _printblocking("</data>\r\n",9, 0);
         }
     }
@@ -4,11 +4,35 @@
 
 #include <nrf51.h>
 #include <nrf_gpio.h>
+#include <nrf_soc.h>
+#include <app_util.h>
 
 #include "spi.h"
 
 #define TIMEOUT_COUNTER          0x3000UL
 
+/*
+ * channels served by the interrupt engine, bit n is SPI_Channel_n
+ * SPI1 shares its vector with SPIS1, which the SDK spi_slave driver owns on every product,
+ * so by default only SPI0 gets a handler here
+ */
+#ifndef SPI_ASYNC_CHANNEL_MASK
+#define SPI_ASYNC_CHANNEL_MASK 0x1
+#endif
+#define SPI_ASYNC_IRQ_PRIORITY 3
+#define SPI_XFER_PENDING INT32_MIN
+
+// host builds watch the writes, TXD is a two byte fifo there as on the chip
+#ifndef SPI_TXD_WRITE
+#define SPI_TXD_WRITE(spi, byte) ((spi)->TXD = (uint32_t)(byte))
+#endif
+
+static struct{
+    spi_transaction_t * head;
+    spi_transaction_t * tail;
+    bool irq_ready;
+}_async[2];
+
 inline void spi_disable(SPI_Context* obj) {
     obj->spi_hw->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
     nrf_gpio_cfg_input(obj->spi_hw->PSELMISO, NRF_GPIO_PIN_PULLUP);
@@ -99,7 +123,7 @@ static inline bool
 spi_one_byte(NRF_SPI_Type *spi, const uint8_t nCS, const uint8_t tx, uint8_t *rx) {
     uint32_t counter = 0;
 
-    spi->TXD = (uint32_t)tx;
+    SPI_TXD_WRITE(spi, tx);
     counter = 0;
 
     /* Wait for the transaction complete or timeout (about 10ms - 20 ms) */
@@ -129,6 +153,16 @@ _spi_ctx_valid(const SPI_Context *ctx)
 	return false;
 }
 
+static inline int32_t
+_spi_channel(const NRF_SPI_Type *spi)
+{
+	if (spi == NRF_SPI0)
+		return SPI_Channel_0;
+	if (spi == NRF_SPI1)
+		return SPI_Channel_1;
+	return -1;
+}
+
 int32_t
 spi_command(const SPI_Context *ctx, const uint32_t cmd_len, const uint8_t *cmd, const uint32_t tx_len, const uint8_t *tx, const uint32_t rx_len, uint8_t *rx)
 {
@@ -139,6 +173,10 @@ spi_command(const SPI_Context *ctx, const uint32_t cmd_len, const uint8_t *cmd,
 	if (!_spi_ctx_valid(ctx))
 		goto cleanup;
 
+	// polling would steal the READY events of a queued transaction
+	if (_spi_channel(ctx->spi_hw) >= 0 && _async[_spi_channel(ctx->spi_hw)].head)
+		return -3;
+
 	NRF_SPI_Type *spi = ctx->spi_hw;
 	uint8_t nCS = ctx->cs_gpio;
 
@@ -189,3 +227,163 @@ spi_xfer(const SPI_Context *ctx, const uint32_t tx_len, const uint8_t *tx, const
 	return spi_command(ctx, 0, 0, tx_len, tx, rx_len, rx);
 }
 
+
+static inline uint8_t
+_async_tx_byte(const spi_transaction_t *t, uint32_t pos)
+{
+	// past the tx buffer the dummy bytes clock in the response
+	return pos < t->tx_len ? t->tx[pos] : 0;
+}
+
+static void
+_async_start(spi_transaction_t *t)
+{
+	NRF_SPI_Type *spi = t->ctx->spi_hw;
+
+	nrf_gpio_pin_clear(t->ctx->cs_gpio);
+	spi->EVENTS_READY = 0U;
+	spi->INTENSET = SPI_INTENSET_READY_Msk;
+	// TXD is double buffered, the second byte queues behind the first so the
+	// bus keeps clocking while the interrupt for the first one is taken
+	SPI_TXD_WRITE(spi, _async_tx_byte(t, 0));
+	if (t->tx_len + t->rx_len > 1)
+		SPI_TXD_WRITE(spi, _async_tx_byte(t, 1));
+}
+
+static void
+_async_irq_enable(const enum SPI_Channel chan)
+{
+	IRQn_Type irq = chan == SPI_Channel_0 ? SPI0_TWI0_IRQn : SPI1_TWI1_IRQn;
+
+	sd_nvic_SetPriority(irq, SPI_ASYNC_IRQ_PRIORITY);
+	sd_nvic_EnableIRQ(irq);
+	_async[chan].irq_ready = true;
+}
+
+int32_t
+spi_xfer_async(spi_transaction_t *t)
+{
+	int32_t chan;
+
+	if (!t || !_spi_ctx_valid(t->ctx))
+		return -1;
+	if ((t->tx_len && !t->tx) || (t->rx_len && !t->rx) || !(t->tx_len + t->rx_len))
+		return -1;
+
+	chan = _spi_channel(t->ctx->spi_hw);
+	if (chan < 0 || !(SPI_ASYNC_CHANNEL_MASK & (1 << chan)))
+		return -2;
+	// a disabled block never raises READY, the transaction would never finish
+	if (t->ctx->spi_hw->ENABLE != (SPI_ENABLE_ENABLE_Enabled << SPI_ENABLE_ENABLE_Pos))
+		return -3;
+
+	t->next = NULL;
+	t->pos = 0;
+
+	CRITICAL_REGION_ENTER();
+	// tested and set under the region, two first callers can't both enable
+	if (!_async[chan].irq_ready)
+		_async_irq_enable(chan);
+	if (_async[chan].tail) {
+		_async[chan].tail->next = t;
+		_async[chan].tail = t;
+	} else {
+		_async[chan].head = t;
+		_async[chan].tail = t;
+		_async_start(t);
+	}
+	CRITICAL_REGION_EXIT();
+
+	return 0;
+}
+
+void
+spi_irq_handler(const enum SPI_Channel chan)
+{
+	spi_transaction_t *t = _async[chan].head;
+	NRF_SPI_Type *spi;
+	uint8_t rx;
+
+	if (!t)
+		return;
+
+	spi = t->ctx->spi_hw;
+	if (!spi->EVENTS_READY)
+		return;
+	spi->EVENTS_READY = 0U;
+	rx = (uint8_t)spi->RXD;
+
+	if (t->pos >= t->tx_len)
+		t->rx[t->pos - t->tx_len] = rx;
+
+	// two bytes in flight, the one after the next goes out as this one is in
+	if (++t->pos < t->tx_len + t->rx_len) {
+		if (t->pos + 1 < t->tx_len + t->rx_len)
+			SPI_TXD_WRITE(spi, _async_tx_byte(t, t->pos + 1));
+		return;
+	}
+
+	nrf_gpio_pin_set(t->ctx->cs_gpio);
+	_async[chan].head = t->next;
+	if (_async[chan].head) {
+		_async_start(_async[chan].head);
+	} else {
+		_async[chan].tail = NULL;
+		spi->INTENCLR = SPI_INTENCLR_READY_Msk;
+	}
+
+	// last, the callback is free to resubmit t
+	if (t->done)
+		t->done(t->rx_len ? t->rx_len : t->tx_len, t->done_ctx);
+}
+
+static void
+_wait_done(int32_t result, void *ctx)
+{
+	*(volatile int32_t *)ctx = result;
+}
+
+int32_t
+spi_xfer_wait(const SPI_Context *ctx, const uint32_t tx_len, const uint8_t *tx, const uint32_t rx_len, uint8_t *rx)
+{
+	volatile int32_t result = SPI_XFER_PENDING;
+	spi_transaction_t t = {
+		.ctx = ctx,
+		.tx = tx,
+		.rx = rx,
+		.tx_len = tx_len,
+		.rx_len = rx_len,
+		.done = _wait_done,
+		.done_ctx = (void *)&result,
+	};
+	int32_t ret;
+
+	if (tx_len > UINT16_MAX || rx_len > UINT16_MAX)
+		return -1;
+
+	ret = spi_xfer_async(&t);
+	if (ret < 0)
+		return ret;
+
+	// the READY interrupt wakes us up once per byte, sleep through the rest
+	while (result == SPI_XFER_PENDING)
+		sd_app_evt_wait();
+
+	return result;
+}
+
+#if SPI_ASYNC_CHANNEL_MASK & 0x1
+void
+SPI0_TWI0_IRQHandler(void)
+{
+	spi_irq_handler(SPI_Channel_0);
+}
+#endif
+
+#if SPI_ASYNC_CHANNEL_MASK & 0x2
+void
+SPI1_TWI1_IRQHandler(void)
+{
+	spi_irq_handler(SPI_Channel_1);
+}
+#endif
@@ -90,6 +90,65 @@ int32_t spi_command(const SPI_Context *ctx, const uint32_t cmd_len, const uint8_
  */
 int32_t spi_destroy(const SPI_Context *ctx);
 
+/**
+ * spi_xfer_done_t - completion callback of an asynchronous transfer
+ *
+ * Runs in the SPI interrupt, keep it short and hand work off with a dispatch or app_sched.
+ * The transaction is no longer referenced by the driver once this is called and may be resubmitted.
+ *
+ * @param result - same as spi_xfer, number of bytes received (or transmitted if no receive was specified), <0 on error
+ * @param ctx    - user context from the transaction
+ */
+typedef void (*spi_xfer_done_t)(int32_t result, void *ctx);
+
+/**
+ * spi_transaction_t - one queued transfer, owned by the caller until its callback runs
+ *
+ * tx bytes are clocked out first, then rx_len dummy bytes are clocked out to read rx.
+ * Chip select is held low for the whole transaction.
+ */
+typedef struct spi_transaction {
+	const SPI_Context *ctx;
+	const uint8_t *tx;
+	uint8_t *rx;
+	uint16_t tx_len;
+	uint16_t rx_len;
+	spi_xfer_done_t done;
+	void *done_ctx;
+	// private to the driver
+	struct spi_transaction *next;
+	uint16_t pos;
+} spi_transaction_t;
+
+/**
+ * spi_xfer_async - queue a transfer and return immediately
+ *
+ * Transactions on the same channel run in submission order, one byte per SPI READY interrupt,
+ * with the next byte already waiting in the double buffered TXD so the bus does not stall on it.
+ * Only channels whose interrupt vector is free can be used, see SPI_ASYNC_CHANNEL_MASK in spi.c.
+ *
+ * @param t - transaction, must stay valid until its callback runs
+ *
+ * @returns <0 on error, 0 if queued
+ */
+int32_t spi_xfer_async(spi_transaction_t *t);
+
+/**
+ * spi_xfer_wait - spi_xfer on top of the interrupt engine, sleeps in sd_app_evt_wait instead of polling
+ *
+ * Must not be called from an interrupt at or above the SPI interrupt priority.
+ *
+ * @returns same as spi_xfer
+ */
+int32_t spi_xfer_wait(const SPI_Context *ctx, const uint32_t tx_len, const uint8_t *tx, const uint32_t rx_len, uint8_t *rx);
+
+/**
+ * spi_irq_handler - advances the transaction queue of a channel by one byte
+ *
+ * Called from the SPI interrupt vector.
+ */
+void spi_irq_handler(const enum SPI_Channel chan);
+
 void spi_disable(SPI_Context* obj);
 
 void spi_enable(SPI_Context *obj);
@@ -358,6 +358,12 @@ inline void imu_set_fifo_mode(enum imu_fifo_mode fifo_mode, uint8_t fifo_trigger
 
 }
 
+void imu_set_fifo_watermark(uint8_t samples)
+{
+	// stream mode keeps collecting while the threshold changes, no samples are lost
+	imu_set_fifo_mode(IMU_FIFO_STREAM_MODE, FIFO_TRIGGER_SEL_INT1, samples);
+}
+
 
 inline void imu_fifo_disable()
 {
@@ -380,7 +386,8 @@ static uint16_t imu_fifo_read_all(uint16_t* values, uint32_t bytes_to_read)
 	// Enable multiple byte read
 	buf[0] |= 0x40;
 
-	bytes_read = spi_xfer(&_spi_context, 1, buf, bytes_to_read, (uint8_t*) values);
+	// up to 192 bytes on the bus, sleep through them instead of polling READY
+	bytes_read = spi_xfer_wait(&_spi_context, 1, buf, bytes_to_read, (uint8_t*) values);
 	BOOL_OK(bytes_read == bytes_to_read);
 
 #ifdef IMU_MODULE_DEBUG
@@ -65,6 +65,9 @@ uint8_t imu_handle_fifo_read(uint16_t* values);
 // Set FIFO mode
 void imu_set_fifo_mode(enum imu_fifo_mode fifo_mode, uint8_t fifo_trigger, uint8_t wtm_threshold);
 
+// Change the watermark (in samples) of the running stream mode FIFO
+void imu_set_fifo_watermark(uint8_t samples);
+
 // Read FIFO source register
 uint8_t imu_read_fifo_src_reg();
 
@@ -1,6 +1,7 @@
 #include "ant_user.h"
 #include "message_uart.h"
 #include "message_ble.h"
+#include "message_sspi.h"
 #include "morpheus_ble.h"
 #include "util.h"
 #include "app_timer.h"
@@ -11,14 +12,33 @@
 #include "hble.h"
 #include "battery.h"
 #include "ant_devices.h"
+#ifdef ANT_PILL_BATCHING
+#include "pill_batch.h"
+#endif
+
+//a pill command is the device id and one pill_data, with room for the tags and lengths
+#define PILL_COMMAND_MAX_SIZE (pill_data_size + 48)
+
+typedef struct{
+    uint64_t uuid;
+    uint16_t device_number;
+    char hex[sizeof(((pill_data*)0)->device_id)];
+}pill_id_t;
 
 static struct{
     MSG_Central_t * parent;
     volatile uint8_t pair_enable;
     volatile uint64_t dfu_pill_id;
+#ifdef ANT_PILL_BATCHING
+    pill_batch_t batch;
+    uint8_t batch_timer;
+    uint8_t window;         //counts batch windows, a window's tick carries its number
+#endif
+    pill_id_t ids[PILL_ID_CACHE_SIZE];
+    uint8_t next_id;
 }self;
 
-static int _copy_pill_meta_data(MorpheusCommand * c, MSG_ANT_PillData_t * pill_data, const hlo_ant_device_t * id, char * device_id){
+static int _copy_pill_meta_data(MorpheusCommand * c, MSG_ANT_PillData_t * pill_data, const hlo_ant_device_t * id, const char * device_id){
     memcpy(c->pill_data.device_id, device_id, sizeof(c->pill_data.device_id));
 
     c->pill_data.has_rssi = true;
@@ -40,6 +60,122 @@ static int _copy_encrypted_data(MorpheusCommand * c, MorpheusCommand_CommandType
 
     return 0;
 }
+/*
+ * hex device id of the pill, converted once per pill instead of once per message
+ */
+static const char * _pill_id(const hlo_ant_device_t * id, uint64_t uuid){
+    pill_id_t * e;
+    size_t len;
+    uint8_t i;
+    for(i = 0; i < PILL_ID_CACHE_SIZE; i++){
+        e = &self.ids[i];
+        if(e->hex[0] && e->device_number == id->device_number && e->uuid == uuid){
+            return e->hex;
+        }
+    }
+    e = &self.ids[self.next_id];
+    len = sizeof(e->hex);
+    memset(e->hex, 0, sizeof(e->hex));
+    if(!hble_uint64_to_hex_device_id(uuid, e->hex, &len)){
+        e->hex[0] = 0;
+        return NULL;
+    }
+    e->uuid = uuid;
+    e->device_number = id->device_number;
+    self.next_id = (self.next_id + 1) % PILL_ID_CACHE_SIZE;
+    return e->hex;
+}
+//deviceId.arg is a plain string here, not a MSG_Data_t
+static bool _encode_device_id(pb_ostream_t *stream, const pb_field_t *field, void * const *arg){
+    const char * str = *arg;
+    if(!str){
+        return false;
+    }
+    return pb_encode_tag_for_field(stream, field) && pb_encode_string(stream, (const uint8_t*)str, strlen(str));
+}
+static void _publish_command(MorpheusCommand * command){
+    uint8_t buf[PILL_COMMAND_MAX_SIZE];
+    size_t proto_len = sizeof(buf);
+    //one pass into the stack, the page is sized by what was written
+    if(morpheus_ble_encode_protobuf(command, (char*)buf, &proto_len))
+    {
+        MSG_Data_t* proto_page = MSG_Base_AllocateObjectAtomic(buf, proto_len);
+        if(proto_page)
+        {
+            //sspi, plus uart while "tap" is on in the cli
+            self.parent->publish(ADDR(ANT,1), MSG_TOPIC_PILL_DATA, proto_page);
+            MSG_Base_ReleaseDataAtomic(proto_page);
+        }else{
+            PRINTS("No memory\r\n");
+        }
+    }
+}
+#ifdef ANT_PILL_BATCHING
+static void _flush_batch(void){
+    MSG_Data_t * frame;
+    if(self.batch_timer != MSG_TIMED_NONE){
+        //fails if it fired already, its tick is on the way and finds another window
+        self.parent->cancel(self.batch_timer);
+        self.batch_timer = MSG_TIMED_NONE;
+    }
+    PRINTF("Pill batch: %d entries\r\n", self.batch.count);
+    frame = pill_batch_close(&self.batch);
+    if(frame){
+        //sspi on MSG_SSPI_PILL_BATCH, plus uart while "tap" is on in the cli
+        self.parent->publish(ADDR(ANT,1), MSG_TOPIC_PILL_BATCH, frame);
+        MSG_Base_ReleaseDataAtomic(frame);
+    }
+}
+static bool _open_batch(void){
+    char sense_id[sizeof(((pill_data*)0)->device_id)] = {0};
+    size_t len = sizeof(sense_id);
+    MSG_Data_t * tick;
+    if(!hble_uint64_to_hex_device_id(GET_UUID_64(), sense_id, &len) || !pill_batch_open(&self.batch, PILL_BATCH_SIZE, sense_id)){
+        return false;
+    }
+    //the window starts with the first entry, a full frame goes out before it ends
+    self.window++;
+    self.batch_timer = MSG_TIMED_NONE;
+    tick = MSG_Base_AllocateObjectAtomic(&self.window, sizeof(self.window));
+    if(tick){
+        self.batch_timer = self.parent->dispatch_at(ADDR(ANT,0), ADDR(ANT, MSG_ANT_USER_TICK), tick, PILL_BATCH_WINDOW);
+        MSG_Base_ReleaseDataAtomic(tick);
+    }
+    return true;
+}
+/*
+ * false if pd could not be batched, the caller sends it on its own then
+ */
+static bool _batch_pill(const pill_data * pd, uint32_t tag){
+    int ret;
+    if(!self.batch.frame && !_open_batch()){
+        return false;
+    }
+    ret = pill_batch_add(&self.batch, tag, pd);
+    if(ret == -1){
+        _flush_batch();
+        if(!_open_batch()){
+            return false;
+        }
+        ret = pill_batch_add(&self.batch, tag, pd);
+    }
+    if(self.batch_timer == MSG_TIMED_NONE){
+        //no timed slot, nothing would end the window
+        _flush_batch();
+    }
+    return ret == 0;
+}
+static void _on_tick(MSG_Data_t * data){
+    uint8_t window;
+    //the tick of a window that was flushed full
+    if(self.batch_timer == MSG_TIMED_NONE || !data || !MSG_Base_Read(data, 0, &window, 1) || window != self.window){
+        return;
+    }
+    //fired, the handle is no longer valid
+    self.batch_timer = MSG_TIMED_NONE;
+    _flush_batch();
+}
+#endif
 static void _handle_pill(const hlo_ant_device_t * id, MSG_Data_t * msg){
     // TODO, this shit needs to be tested on CC3200 side.
     MSG_ANT_PillData_t* pill_data = (MSG_ANT_PillData_t*)msg->buf;
@@ -47,135 +183,121 @@ static void _handle_pill(const hlo_ant_device_t * id, MSG_Data_t * msg){
     MorpheusCommand morpheus_command;
     memset(&morpheus_command, 0, sizeof(MorpheusCommand));
 
-    uint64_t device_id = pill_data->UUID;
-    char buffer[sizeof(morpheus_command.pill_data.device_id)] = {0};
-    size_t buffer_len = sizeof(buffer);
+    uint32_t batch_tag = 0;     //pill_data that can go in a batched_pill_data
+    const char * buffer = _pill_id(id, pill_data->UUID);
 
-    if(!hble_uint64_to_hex_device_id(device_id, buffer, &buffer_len)){
+    if(!buffer){
         PRINTS("Get pill id failed.\r\n");
     }else{
-        if( MSG_Base_FreeCount() < configLOW_MEM )
+        if( MSG_Base_LargestFree() < configLOW_MEM )
         {
             PRINTS("Low memory, pill data dropped.\r\n");
+        }else if( MSG_SSPI_TxPressure() == MSG_QUEUE_PRESSURE_FULL ){
+            //cc3200 is not reading, skip the protobuf encoding
+            PRINTS("SSPI backed up, pill data dropped.\r\n");
         }else{
-            MSG_Data_t* device_id_page = MSG_Base_AllocateStringAtomic(buffer);
-            
-            if( !device_id_page ) {
-                PRINTS("Failed to allocate pill data page.\r\n");
-            } else {
-                morpheus_command.deviceId.arg = device_id_page;
-
-                //TODO it may be a good idea to check len from the msg
-                switch(pill_data->type){
-                    case ANT_PILL_PROX_PLAINTEXT:
-                        {
-                            pill_proxdata_t prox;
-                            // http://dbp-consulting.com/StrictAliasing.pdf
-                            memcpy(&prox, pill_data->payload, sizeof(prox));
-                            self.parent->dispatch((MSG_Address_t){SSPI,1}, (MSG_Address_t){UART,MSG_UART_HEX}, msg);
-                            PRINTF("Cap1: %u\r\nCap4: %u\r\n", prox.cap[0], prox.cap[1]);
-                        }
-                        break;
-                    case ANT_PILL_PROX_ENCRYPTED:
+            morpheus_command.deviceId.funcs.encode = _encode_device_id;
+            morpheus_command.deviceId.arg = (void*)buffer;
+
+            //TODO it may be a good idea to check len from the msg
+            switch(pill_data->type){
+                case ANT_PILL_PROX_PLAINTEXT:
+                    {
+                        pill_proxdata_t prox;
+                        // http://dbp-consulting.com/StrictAliasing.pdf
+                        memcpy(&prox, pill_data->payload, sizeof(prox));
+                        self.parent->publish((MSG_Address_t){SSPI,1}, MSG_TOPIC_PILL_RAW, msg);
+                        PRINTF("Cap1: %u\r\nCap4: %u\r\n", prox.cap[0], prox.cap[1]);
+                    }
+                    break;
+                case ANT_PILL_PROX_ENCRYPTED:
+                    {
+                        if(pill_data->payload_len > sizeof(morpheus_command.pill_data.motion_data_entrypted.bytes))
                         {
-                            if(pill_data->payload_len > sizeof(morpheus_command.pill_data.motion_data_entrypted.bytes))
-                            {
-                                PRINTS("PLEASE REDESIGN PROTOBUF, payload tooo long\r\n");
-                                APP_OK(NRF_ERROR_NO_MEM);
-                            }
-
-                            _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
-                            _copy_encrypted_data(&morpheus_command, MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_PROX_DATA, pill_data);
-
-                            PRINTS("ANT Encrypted Pill Prox Received:");
-                            PRINTS(morpheus_command.pill_data.device_id);
-                            PRINTS("\r\n");
+                            PRINTS("PLEASE REDESIGN PROTOBUF, payload tooo long\r\n");
+                            APP_OK(NRF_ERROR_NO_MEM);
                         }
-                        break;
-                    case ANT_PILL_DATA_ENCRYPTED:
+
+                        _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
+                        _copy_encrypted_data(&morpheus_command, MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_PROX_DATA, pill_data);
+                        batch_tag = batched_pill_data_prox_tag;
+
+                        PRINTS("ANT Encrypted Pill Prox Received:");
+                        PRINTS(morpheus_command.pill_data.device_id);
+                        PRINTS("\r\n");
+                    }
+                    break;
+                case ANT_PILL_DATA_ENCRYPTED:
+                    {
+                        if(pill_data->payload_len > sizeof(morpheus_command.pill_data.motion_data_entrypted.bytes))
                         {
-                            if(pill_data->payload_len > sizeof(morpheus_command.pill_data.motion_data_entrypted.bytes))
-                            {
-                                PRINTS("PLEASE REDESIGN PROTOBUF, payload tooo long\r\n");
-                                APP_OK(NRF_ERROR_NO_MEM);
-                            }
-
-                            _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
-                            _copy_encrypted_data(&morpheus_command, MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_DATA, pill_data);
-
-                            PRINTS("ANT Encrypted Pill Data Received:");
-                            PRINTS(morpheus_command.pill_data.device_id);
-                            PRINTS("\r\n");
+                            PRINTS("PLEASE REDESIGN PROTOBUF, payload tooo long\r\n");
+                            APP_OK(NRF_ERROR_NO_MEM);
                         }
-                        break;
-                    case ANT_PILL_HEARTBEAT:
-                        {
-                            pill_heartbeat_t heartbeat = {0};
-                            // http://dbp-consulting.com/StrictAliasing.pdf
-                            memcpy(&heartbeat, pill_data->payload, sizeof(pill_heartbeat_t));
-                            morpheus_command.type = MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_HEARTBEAT;
-                            morpheus_command.has_pill_data = true;
 
-                            if(heartbeat.battery_level != BATTERY_INVALID_MEASUREMENT){
-                                morpheus_command.pill_data.has_battery_level = true;
-                                morpheus_command.pill_data.battery_level = heartbeat.battery_level;
-                            }
+                        _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
+                        _copy_encrypted_data(&morpheus_command, MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_DATA, pill_data);
+                        batch_tag = batched_pill_data_pills_tag;
 
-                            morpheus_command.pill_data.has_uptime = true;
-                            morpheus_command.pill_data.uptime = heartbeat.uptime_sec;
+                        PRINTS("ANT Encrypted Pill Data Received:");
+                        PRINTS(morpheus_command.pill_data.device_id);
+                        PRINTS("\r\n");
+                    }
+                    break;
+                case ANT_PILL_HEARTBEAT:
+                    {
+                        pill_heartbeat_t heartbeat = {0};
+                        // http://dbp-consulting.com/StrictAliasing.pdf
+                        memcpy(&heartbeat, pill_data->payload, sizeof(pill_heartbeat_t));
+                        morpheus_command.type = MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_HEARTBEAT;
+                        morpheus_command.has_pill_data = true;
 
-                            _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
+                        if(heartbeat.battery_level != BATTERY_INVALID_MEASUREMENT){
+                            morpheus_command.pill_data.has_battery_level = true;
+                            morpheus_command.pill_data.battery_level = heartbeat.battery_level;
+                        }
 
-                            morpheus_command.pill_data.has_firmware_build = true;
-                            morpheus_command.pill_data.firmware_build = heartbeat.firmware_build;
+                        morpheus_command.pill_data.has_uptime = true;
+                        morpheus_command.pill_data.uptime = heartbeat.uptime_sec;
 
-                            PRINTS("ANT Pill Heartbeat Received.\r\n");
-                        }
-                        break;
-                    case ANT_PILL_SHAKING:
-                        PRINTS("Shaking pill: ");
-                        PRINT_HEX(&pill_data->UUID, sizeof(pill_data->UUID));
-                        PRINTS("\r\n");
+                        _copy_pill_meta_data(&morpheus_command, pill_data, id, buffer);
 
-                        if(self.pair_enable){
-                            MSG_Data_t* ble_cmd_page = MSG_Base_AllocateObjectAtomic(&pill_data->UUID, sizeof(pill_data->UUID));
-                            if(ble_cmd_page){
-                                self.parent->dispatch(ADDR(ANT,0), ADDR(BLE, MSG_BLE_ACK_DEVICE_ADDED), ble_cmd_page);
-                                MSG_Base_ReleaseDataAtomic(ble_cmd_page);
-                            }else{
-                                PRINTS("No Memory!\r\n");
-                            }
-                        }else{
-                            morpheus_command.type = MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_SHAKES;
-                        }
-                        break;
+                        morpheus_command.pill_data.has_firmware_build = true;
+                        morpheus_command.pill_data.firmware_build = heartbeat.firmware_build;
+                        batch_tag = batched_pill_data_pills_tag;
 
-                    default:
-                        break;
-                }
+                        PRINTS("ANT Pill Heartbeat Received.\r\n");
+                    }
+                    break;
+                case ANT_PILL_SHAKING:
+                    PRINTS("Shaking pill: ");
+                    PRINT_HEX(&pill_data->UUID, sizeof(pill_data->UUID));
+                    PRINTS("\r\n");
 
-                size_t proto_len = 0;
-                if(morpheus_ble_encode_protobuf(&morpheus_command, NULL, &proto_len))
-                {
-                    MSG_Data_t* proto_page = MSG_Base_AllocateDataAtomic(proto_len);
-                    if(proto_page)
-                    {
-                        memset(proto_page->buf, 0, proto_page->len);
-                        if(morpheus_ble_encode_protobuf(&morpheus_command, proto_page->buf, &proto_len))
-                        {
-                            self.parent->dispatch(ADDR(ANT,1), ADDR(SSPI,1), proto_page);
-                            /*
-                             *self.parent->dispatch(src, (MSG_Address_t){UART,1}, proto_page);
-                             */
+                    if(self.pair_enable){
+                        MSG_Data_t* ble_cmd_page = MSG_Base_AllocateViewAtomic(msg, offsetof(MSG_ANT_PillData_t, UUID), sizeof(pill_data->UUID));
+                        if(ble_cmd_page){
+                            self.parent->dispatch(ADDR(ANT,0), ADDR(BLE, MSG_BLE_ACK_DEVICE_ADDED), ble_cmd_page);
+                            MSG_Base_ReleaseDataAtomic(ble_cmd_page);
+                        }else{
+                            PRINTS("No Memory!\r\n");
                         }
-                        MSG_Base_ReleaseDataAtomic(proto_page);
                     }else{
-                        PRINTS("No memory\r\n");
+                        morpheus_command.type = MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_SHAKES;
                     }
-                }
+                    break;
 
-                MSG_Base_ReleaseDataAtomic(device_id_page);
+                default:
+                    break;
             }
+
+#ifdef ANT_PILL_BATCHING
+            if(!batch_tag || !_batch_pill(&morpheus_command.pill_data, batch_tag))
+#endif
+            _publish_command(&morpheus_command);
+
+            //not a MSG_Data_t, keep morpheus_ble_free_protobuf off it
+            morpheus_command.deviceId.arg = NULL;
         }
     }
     morpheus_ble_free_protobuf(&morpheus_command);
@@ -225,9 +347,15 @@ MSG_ANTHandler_t * ANT_UserInit(MSG_Central_t * central){
     static MSG_ANTHandler_t handler = {
         .on_message = _on_message,
         .on_connection = _on_connection,
+#ifdef ANT_PILL_BATCHING
+        .on_tick = _on_tick,
+#endif
     };
     self.parent = central;
     self.dfu_pill_id = 0;
+#ifdef ANT_PILL_BATCHING
+    self.batch_timer = MSG_TIMED_NONE;
+#endif
 
     return &handler;
 }
@@ -105,6 +105,20 @@ enum {
 #define APP_PILL_PAIRING_TIMEOUT_INTERVAL	 (APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER))
 #define BLE_BOOT_RETRY_INTERVAL              (APP_TIMER_TICKS(2500, APP_TIMER_PRESCALER))
 
+// pill data goes to the cc3200 as one batched_pill_data per window on MSG_SSPI_PILL_BATCH
+// instead of one MorpheusCommand per ant message, turn on once the cc3200 reads that port
+//#define ANT_PILL_BATCHING
+#define PILL_BATCH_WINDOW                    (APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER))
+#define PILL_BATCH_SIZE                      (192)  // bytes of the frame, about three motion entries
+
+// pills whose hex device id is kept between messages
+#define PILL_ID_CACHE_SIZE                   (4)
+
+// agree to burst transfers of full duplex ant messages, and send our own that way as a peripheral
+//#define ANT_PACKET_BURST
+// report missing pages in the echo of full duplex ant messages so the peer resends only those
+//#define ANT_PACKET_SELECTIVE
+
 //fatory app allows more capabilities
 #define FACTORY_APP
 //verbose app shows more txt for debugging
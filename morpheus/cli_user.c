@@ -8,6 +8,7 @@
 #include "hble.h"
 #include "heap.h"
 #include "time_keeper.h"
+#include "message_app.h"
 
 #include <nrf_gpio.h>
 #include <nrf_delay.h>
@@ -111,17 +112,8 @@ _handle_command(int argc, char * argv[]){
         if(!message){
             return;
         }
-        MSG_ANT_Message_t content = (MSG_ANT_Message_t){
-            .device = device,
-            .message = message,
-        };
-
-        MSG_Data_t * parcel = MSG_Base_AllocateObjectAtomic(&content, sizeof(content));
-        if(parcel){
-            self.parent->dispatch( ADDR(ANT,0), ADDR(ANT,MSG_ANT_HANDLE_MESSAGE), parcel);
-            MSG_Base_ReleaseDataAtomic(parcel);
-            MSG_Base_ReleaseDataAtomic(message);
-        }
+        MSG_ANT_HandleMessage(&device, message);
+        MSG_Base_ReleaseDataAtomic(message);
     }
     if( !match_command(argv[0], "printf") ){
         PRINTF("sm %d\r\n", INT32_MAX);
@@ -137,6 +129,30 @@ _handle_command(int argc, char * argv[]){
     if( !match_command(argv[0], "free") ){
         PRINTF("Free Memory = %d Least Memory = %d\r\n", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize() );
     }
+    if( !match_command(argv[0], "mem") ){
+        //live messages by allocation site, "mem reset" restarts the per module peaks
+        if( argc > 1 && !match_command(argv[1], "reset") ){
+            MSG_Base_ResetAllocPeaks();
+        }else{
+            MSG_Base_PrintAllocations();
+        }
+    }
+    if( !match_command(argv[0], "tap") ){
+        //mirror encoded pill data to the uart, "tap off" stops it
+        if( argc > 1 && !match_command(argv[1], "off") ){
+            self.parent->unsubscribe(MSG_TOPIC_PILL_DATA, ADDR(UART, MSG_UART_HEX));
+            self.parent->unsubscribe(MSG_TOPIC_PILL_BATCH, ADDR(UART, MSG_UART_HEX));
+        }else{
+            self.parent->subscribe(MSG_TOPIC_PILL_DATA, ADDR(UART, MSG_UART_HEX));
+            self.parent->subscribe(MSG_TOPIC_PILL_BATCH, ADDR(UART, MSG_UART_HEX));
+        }
+    }
+    if( !match_command(argv[0], "stats") ){
+        //dispatch latency and handler time per module, "stats reset" clears them
+        self.parent->dispatch(  (MSG_Address_t){CLI, 0},
+                                (MSG_Address_t){CENTRAL, (argc > 1 && !match_command(argv[1], "reset")) ? MSG_APP_STATS_RESET : MSG_APP_STATS},
+                                NULL);
+    }
     if( !match_command(argv[0], "boot") ){
         //force boot without midboard
         MSG_Data_t * data = MSG_Base_AllocateDataAtomic(1);
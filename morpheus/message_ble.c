@@ -1,6 +1,7 @@
 /* Application layer for Morpheus BLE */
 
 #include <stdlib.h>
+#include <string.h>
 #include <app_timer.h>
 
 #include "app.h"
@@ -13,7 +14,7 @@
 #include "morpheus_ble.h"
 #include "ble_bondmngr.h"
 #include "nrf_delay.h"
-#include "hlo_queue.h"
+#include "message_queue.h"
 
 #ifdef ANT_STACK_SUPPORT_REQD
 #include "message_ant.h"
@@ -33,10 +34,9 @@ static struct{
     MSG_Central_t * parent;
     struct pill_pairing_request pill_pairing_request;
     app_timer_id_t timer_id;
-    app_timer_id_t boot_timer;
     boot_status boot_state;
     int ready_to_send;
-    struct hlo_queue_t * tx_queue;
+    MSG_Queue_t * tx_queue;
     uint16_t cached_bond_count;
     bool cached_is_pairing;
 } self;
@@ -327,6 +327,7 @@ static MSG_Status _route_protobuf_to_ble(MSG_Data_t * data){
     return SUCCESS;
 }
 
+static void _on_boot_check(void);
 static MSG_Status _on_data_arrival(MSG_Address_t src, MSG_Address_t dst,  MSG_Data_t* data){
     PRINTS("Enter _on_data_arrival\r\n");
     switch(dst.submodule){
@@ -337,10 +338,12 @@ static MSG_Status _on_data_arrival(MSG_Address_t src, MSG_Address_t dst,  MSG_Da
             break;
         case MSG_BLE_ACK_DEVICE_ADDED:
             if(data){
-                uint64_t pill_uid = *((uint64_t*)data->buf);
+                uint64_t pill_uid;
                 size_t hex_string_len = 0;
                 char hex_string[17];
 
+                MSG_Base_Read(data, 0, (uint8_t*)&pill_uid, sizeof(pill_uid));
+
                 app_timer_stop(self.timer_id);
                 ANT_UserSetPairing(0);
                 hble_uint64_to_hex_device_id(pill_uid, NULL, &hex_string_len);
@@ -372,6 +375,9 @@ static MSG_Status _on_data_arrival(MSG_Address_t src, MSG_Address_t dst,  MSG_Da
                 _init_ble_stack(&command);
             }
             break;
+        case MSG_BLE_BOOT_CHECK:
+            _on_boot_check();
+            break;
         case MSG_BLE_DEFAULT_CONNECTION:
             if(data){
                 return _route_protobuf_to_ble(data);
@@ -482,7 +488,7 @@ static void _cc3200_boot_check(){
 #endif
 }
 
-static void _on_boot_timer(void* context)
+static void _on_boot_check(void)
 {
     switch(self.boot_state)
     {
@@ -508,14 +514,14 @@ static void _on_boot_timer(void* context)
 
 #ifdef HAS_CC3200
     if(self.boot_state != BOOT_COMPLETED){
-        app_timer_start(self.boot_timer, BLE_BOOT_RETRY_INTERVAL, NULL);
+        self.parent->dispatch_at(ADDR(BLE, 0), ADDR(BLE, MSG_BLE_BOOT_CHECK), NULL, BLE_BOOT_RETRY_INTERVAL);
     }
 #endif
 }
 static void _on_notify_completed(const void* data, void* data_page){
     MSG_Base_ReleaseDataAtomic((MSG_Data_t*)data_page);
-    uint32_t pool_free = MSG_Base_FreeCount();
-    PRINTS("heap free: ");
+    uint32_t pool_free = MSG_Base_LargestFree();
+    PRINTS("largest free: ");
     PRINT_HEX(&pool_free, sizeof(pool_free));
     PRINTS("\r\n");
     _dequeue_tx();
@@ -523,26 +529,29 @@ static void _on_notify_completed(const void* data, void* data_page){
 
 static void _on_notify_failed(void* data_page){
     MSG_Base_ReleaseDataAtomic((MSG_Data_t*)data_page);
-    uint32_t pool_free = MSG_Base_FreeCount();
-    PRINTS("heap free: ");
+    uint32_t pool_free = MSG_Base_LargestFree();
+    PRINTS("largest free: ");
     PRINT_HEX(&pool_free, sizeof(pool_free));
     PRINTS("\r\n");
     _dequeue_tx();
 }
 static void _dequeue_tx(void){
-    MSG_Data_t * next = NULL;
-    if(hlo_queue_filled_size(self.tx_queue) >= sizeof(&next)){
+    MSG_QueueEntry_t entry = {0};
+    MSG_Data_t * next;
+    if(MSG_Queue_Depth(self.tx_queue)){
         PRINTS("tx_ble:");
 
         CRITICAL_REGION_ENTER();
-        hlo_queue_read(self.tx_queue, (unsigned char*)&next, sizeof(&next));
+        MSG_Queue_Pop(self.tx_queue, &entry);
         self.ready_to_send = 0;
         CRITICAL_REGION_EXIT();
 
+        next = entry.msg;
+
         PRINT_HEX(&next->len, 2);
         PRINTS("\r\n");
         if(next){
-            hlo_ble_notify(0xB00B, next->buf, next->len,
+            hlo_ble_notify_msg(0xB00B, next,
                     &(struct hlo_ble_operation_callbacks){_on_notify_completed, _on_notify_failed, next});
         }
     }else{
@@ -554,26 +563,29 @@ static void _dequeue_tx(void){
     }
 }
 static bool _queue_tx(MSG_Data_t * msg){
-    if(msg && hlo_queue_empty_size(self.tx_queue) >= sizeof(&msg)){
+    bool queued = false;
+    if(msg){
         MSG_Base_AcquireDataAtomic(msg);
 
         CRITICAL_REGION_ENTER();
-        hlo_queue_write(self.tx_queue, (unsigned char*)&msg, sizeof(&msg));
-        if(self.ready_to_send){
+        queued = MSG_Queue_Push(self.tx_queue, msg, ADDR(BLE, 0));
+        if(queued && self.ready_to_send){
             _dequeue_tx();
         }
         CRITICAL_REGION_EXIT();
 
-        return true;
+        if(!queued){
+            MSG_Base_ReleaseDataAtomic(msg);
+        }
     }
-    return false;
+    return queued;
 }
 
 static MSG_Status _init(){
 
     hble_stack_init();
 
-    self.tx_queue = hlo_queue_init(32);
+    self.tx_queue = MSG_Queue_Init(8, MSG_QUEUE_SPSC);
     APP_ASSERT(self.tx_queue);
     self.ready_to_send = 1;
 
@@ -589,9 +601,8 @@ static MSG_Status _init(){
     hble_set_advertise_callback(_on_advertise_started);
     hble_set_connected_callback(_on_connected);
     hble_set_bond_status_callback(_on_bond_finished);
-    app_timer_create(&self.boot_timer, APP_TIMER_MODE_SINGLE_SHOT, _on_boot_timer);
     _cc3200_boot_check();
-    app_timer_start(self.boot_timer, BLE_BOOT_RETRY_INTERVAL, NULL);
+    self.parent->dispatch_at(ADDR(BLE, 0), ADDR(BLE, MSG_BLE_BOOT_CHECK), NULL, BLE_BOOT_RETRY_INTERVAL);
     
 #else
     //use boot command instead
@@ -798,8 +809,8 @@ void message_ble_on_protobuf_command(MSG_Data_t* data_page, MorpheusCommand* com
 
     MSG_Base_ReleaseDataAtomic(data_page);
 
-    uint32_t pool_free = MSG_Base_FreeCount();
-    PRINTS("top heap: ");
+    uint32_t pool_free = MSG_Base_LargestFree();
+    PRINTS("top largest free: ");
     PRINT_HEX(&pool_free, sizeof(pool_free));
     PRINTS("\r\n");
 
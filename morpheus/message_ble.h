@@ -15,6 +15,7 @@ typedef enum{
     MSG_BLE_PING = 0,
     MSG_BLE_DEFAULT_CONNECTION = 1,
     MSG_BLE_BOOT_RADIO = 10,
+    MSG_BLE_BOOT_CHECK,     //cc3200 boot retry, from the central's timed dispatch
     MSG_BLE_ACK_DEVICE_REMOVED = 100,
     MSG_BLE_ACK_DEVICE_ADDED
 }MSG_BLECommands;
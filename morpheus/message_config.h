@@ -7,6 +7,24 @@
 #define MSG_BASE_SHARED_POOL_SIZE 11
 #define MSG_BASE_DATA_BUFFER_SIZE 32
 
+/*
+ * Slab pool size classes for MSG_Data_t (bytes, including the MSG_Data_t header), ascending multiples of 8.
+ * Off: the arena is carved out of the 1152 byte heap and its idle blocks cost the largest free block
+ * more than the pool saves, see tests/message_pool_bench.c. Size the classes from the bench's in flight means.
+ */
+//#define MSG_BASE_POOL_CLASS_SIZES  {16, 24, 40}
+//#define MSG_BASE_POOL_CLASS_COUNTS {1, 1, 2}
+
+/*
+ * Per module dispatch latency/handler time histograms (see MSG_APP_STATS), costs ~50 bytes of RAM per module
+ */
+//#define MSG_CENTRAL_INSTRUMENTATION
+
+/*
+ * Debug only, tracks site/module/age of up to this many live MSG_Data_t (see MSG_Base_PrintAllocations), 16 bytes of RAM each
+ */
+//#define MSG_BASE_ALLOC_TRACKING 24
+
 #ifdef MSG_BASE_USE_BIG_POOL
 #define MSG_BASE_SHARED_POOL_SIZE_BIG 5
 #define MSG_BASE_DATA_BUFFER_SIZE_BIG 156
@@ -19,4 +37,19 @@ void ant_handler(ant_evt_t * p_ant_evt);
 #define DEFAULT_ANT_BOND_COUNT 4
 #endif
 
+/*
+ * ant sessions, one per pill mid message (see ant_packet.h), about 50 bytes of RAM each
+ */
+#define ANT_PACKET_MAX_CONCURRENT_SESSIONS 16
+/*
+ * pills send a MSG_ANT_PillData_t of well under 64 bytes, 64 pages (384 bytes) leaves room and
+ * keeps the page bitmap at 8 bytes a session, the default 255 would cost 384 bytes more here
+ */
+#define ANT_PACKET_MAX_PAGES 64
+
+/*
+ * pending timed dispatches (boot retry, pill batch window) sharing one app_timer
+ */
+#define MSG_CENTRAL_TIMED_SLOTS 3
+
 #define MSG_CENTRAL_MODULE_NUM  (MOD_END)
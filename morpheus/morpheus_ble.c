@@ -365,7 +365,7 @@ static void _on_packet_arrival(void* event_data, uint16_t event_size)
     */
 
 	MorpheusCommand command = {0};
-    if(morpheus_ble_decode_protobuf(&command, data_page->buf, data_page->len)){
+    if(morpheus_ble_decode_protobuf(&command, MSG_Base_Buffer(data_page), data_page->len)){
         // Becareful, we should either redefine another data_page here
         // or use *(MSG_Data_t**)event_data straight to make sure
         // the data_page pointer will not get optimized out.
@@ -455,17 +455,19 @@ void morpheus_ble_write_handler(ble_gatts_evt_write_t* event)
 
 	if(ble_packet->sequence_number == _end_seq)
 	{
-		MSG_Data_t* data_page = MSG_Base_AllocateDataAtomic(_protobuf_len);
+		// hand the assembled bytes over as a view, the view keeps the buffer alive
+		MSG_Data_t* data_page = MSG_Base_AllocateViewAtomic(_protobuf_buffer, 0, _protobuf_len);
 		if(!data_page){
 			PRINTS(MSG_NO_MEMORY);
-		}else{
-			memcpy(data_page->buf, _protobuf_buffer->buf, _protobuf_len);
 		}
 
 		MSG_Base_ReleaseDataAtomic(_protobuf_buffer);
 		_protobuf_buffer = NULL;
 		_seq_expected = 0;
 
+		if(!data_page){
+			return;
+		}
 
 		uint32_t err_code = app_sched_event_put(&data_page, sizeof(data_page), _on_packet_arrival);
 		if(NRF_SUCCESS != err_code)
@@ -578,6 +580,7 @@ void morpheus_load_modules(void){
 
 		central->loadmod(MSG_Uart_Base(&uart_params, central));
 #endif
+		central->subscribe(MSG_TOPIC_PILL_RAW, ADDR(UART, MSG_UART_HEX));
 
 
 #ifdef PLATFORM_HAS_SSPI
@@ -596,6 +599,8 @@ void morpheus_load_modules(void){
 			0x55,
 		};
 		central->loadmod(MSG_SSPI_Base(&spi_params,central));
+		central->subscribe(MSG_TOPIC_PILL_DATA, ADDR(SSPI, 1));
+		central->subscribe(MSG_TOPIC_PILL_BATCH, ADDR(SSPI, MSG_SSPI_PILL_BATCH));
 #endif
 #ifdef PLATFORM_HAS_ACCEL_SPI
 #include "message_imu.h"
@@ -23,9 +23,10 @@ struct hlo_ble_notify_context {
     uint8_t seq; //< number of packets queued to be sent
     uint8_t total; //< total number of packets to send
 
-	uint8_t *orig; //origin of buffer to be sent
-	uint8_t *current; //current pointer of the buffer to be sent
-	uint8_t *end;//end of the buffer to be sent
+	const uint8_t *orig; //origin of buffer to be sent, NULL when sending msg
+	const MSG_Data_t *msg; //object to be sent, may be a view or a chain
+	uint16_t offset; //current offset into the data to be sent
+	uint16_t length; //total length of the data to be sent
 	uint8_t last_len; // You have it!
 
     struct hlo_ble_operation_callbacks callback_info;
@@ -251,37 +252,37 @@ static bool _dispatch_packet(struct hlo_ble_packet * t){
 	}
 }
 
-static uint16_t 
-_rem(const uint8_t * src, const uint8_t * dest){
-	if(dest >= src){
-		return (dest-src)+1;
+static void
+_copy_out(uint8_t * dst, uint16_t len){
+	if(_notify_context.msg){
+		MSG_Base_Read(_notify_context.msg, _notify_context.offset, dst, len);
 	}else{
-		return 0;
+		memcpy(dst, _notify_context.orig + _notify_context.offset, len);
 	}
 }
 
 //this function is not reentrant!!111
 static struct hlo_ble_packet * _make_packet(void){
 	static struct hlo_ble_packet packet;
-	if(_notify_context.current > _notify_context.end){
+	if(_notify_context.offset >= _notify_context.length){
 		return NULL;
 	}
 	uint16_t advance;
-	uint16_t rem = _rem(_notify_context.orig, _notify_context.end);
+	uint16_t rem = _notify_context.length - _notify_context.offset;
 	packet.sequence_number = _notify_context.seq++;
-	if(_notify_context.current == _notify_context.orig){
+	if(_notify_context.offset == 0){
 		//header
 		advance = (rem>18)?18:rem;
 		packet.header.packet_count = _notify_context.total;
-		memcpy(packet.header.data, _notify_context.current, advance);
+		_copy_out(packet.header.data, advance);
 	}else{
 		//everything
 		advance = (rem>19)?19:rem;
-		memcpy(packet.body.data, _notify_context.current,advance);
+		_copy_out(packet.body.data, advance);
 	}
 	//PRINT_HEX(&packet, 20);
 	PRINTS("\r\n");
-	_notify_context.current += advance;
+	_notify_context.offset += advance;
 	return &packet;
 }
 
@@ -297,7 +298,8 @@ static inline uint8_t _last_packet_len(uint16_t length){
 }
 
 
-void hlo_ble_notify(uint16_t characteristic_uuid, uint8_t* data, uint16_t length, const struct hlo_ble_operation_callbacks* callback_info)
+static void
+_notify(uint16_t characteristic_uuid, const uint8_t* data, const MSG_Data_t* msg, uint16_t length, const struct hlo_ble_operation_callbacks* callback_info)
 {
 	if(length == 0)
     {
@@ -318,8 +320,9 @@ void hlo_ble_notify(uint16_t characteristic_uuid, uint8_t* data, uint16_t length
         .seq = 0,
         .callback_info = callback_info == NULL ? (struct hlo_ble_operation_callbacks){} : (*callback_info),
 		.orig = data,
-		.current = data,
-		.end = (data + length - 1),
+		.msg = msg,
+		.offset = 0,
+		.length = length,
 		.last_len = _last_packet_len(length),
 		.total = _calculate_total(length)//TODO actual total
     };
@@ -332,6 +335,16 @@ void hlo_ble_notify(uint16_t characteristic_uuid, uint8_t* data, uint16_t length
 
 }
 
+void hlo_ble_notify(uint16_t characteristic_uuid, uint8_t* data, uint16_t length, const struct hlo_ble_operation_callbacks* callback_info)
+{
+	_notify(characteristic_uuid, data, NULL, length, callback_info);
+}
+
+void hlo_ble_notify_msg(uint16_t characteristic_uuid, const MSG_Data_t* msg, const struct hlo_ble_operation_callbacks* callback_info)
+{
+	_notify(characteristic_uuid, NULL, msg, msg->len, callback_info);
+}
+
 bool hlo_ble_is_connected()
 {
     return hlo_ble_get_connection_handle() != BLE_CONN_HANDLE_INVALID;
@@ -364,7 +377,7 @@ void hlo_ble_on_ble_evt(ble_evt_t* event)
 		{
 			if(_notify_context.seq == _notify_context.total){
 				if(_notify_context.callback_info.on_succeed){
-					_notify_context.callback_info.on_succeed(_notify_context.orig, _notify_context.callback_info.callback_data);
+					_notify_context.callback_info.on_succeed(_notify_context.msg ? (const void*)_notify_context.msg : _notify_context.orig, _notify_context.callback_info.callback_data);
 				}
 			}else{
 				struct hlo_ble_packet * packet = _make_packet();
@@ -8,6 +8,8 @@
 
 #include <ble.h>
 
+#include "message_base.h"
+
 #define BLE_UUID_HELLO_BASE {0x23, 0xD1, 0xBC, 0xEA, 0x5F,              \
       0x78, 0x23, 0x15, 0xDE, 0xEF, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00}
 
@@ -73,6 +75,11 @@ void hlo_ble_dispatch_write(ble_evt_t *event);
 
 
 void hlo_ble_notify(uint16_t characteristic_uuid, uint8_t* data, uint16_t length, const struct hlo_ble_operation_callbacks* callback_info);
+/*
+ * packetizes straight out of a message object, views and chains included
+ * the object must stay alive until on_succeed or on_failed is called
+ */
+void hlo_ble_notify_msg(uint16_t characteristic_uuid, const MSG_Data_t* msg, const struct hlo_ble_operation_callbacks* callback_info);
 void hlo_ble_on_ble_evt(ble_evt_t* event);
 
 bool hlo_ble_is_connected();
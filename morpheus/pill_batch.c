@@ -0,0 +1,49 @@
+#include <string.h>
+#include "pill_batch.h"
+#include "pb_encode.h"
+
+bool pill_batch_open(pill_batch_t * batch, uint16_t capacity, const char * device_id){
+    pb_ostream_t stream;
+    memset(batch, 0, sizeof(*batch));
+    batch->frame = MSG_Base_AllocateDataAtomic(capacity);
+    if(!batch->frame){
+        return false;
+    }
+    //required field, first so every entry after it is a plain append
+    stream = pb_ostream_from_buffer(batch->frame->buf, batch->frame->len);
+    if(!pb_encode_tag(&stream, PB_WT_STRING, batched_pill_data_device_id_tag)
+            || !pb_encode_string(&stream, (const uint8_t *)device_id, strlen(device_id))){
+        MSG_Base_ReleaseDataAtomic(batch->frame);
+        batch->frame = NULL;
+        return false;
+    }
+    batch->len = stream.bytes_written;
+    return true;
+}
+
+int pill_batch_add(pill_batch_t * batch, uint32_t tag, const pill_data * pd){
+    pb_ostream_t stream;
+    if(!batch->frame || !pd || (tag != batched_pill_data_pills_tag && tag != batched_pill_data_prox_tag)){
+        return -2;
+    }
+    //a failed encode may have written past len, nothing counts until len moves
+    stream = pb_ostream_from_buffer(batch->frame->buf + batch->len, batch->frame->len - batch->len);
+    if(!pb_encode_tag(&stream, PB_WT_STRING, tag) || !pb_encode_submessage(&stream, pill_data_fields, pd)){
+        return -1;
+    }
+    batch->len += stream.bytes_written;
+    batch->count++;
+    return 0;
+}
+
+MSG_Data_t * INCREF pill_batch_close(pill_batch_t * batch){
+    MSG_Data_t * ret = NULL;
+    if(batch->frame){
+        if(batch->count){
+            ret = MSG_Base_AllocateViewAtomic(batch->frame, 0, batch->len);
+        }
+        MSG_Base_ReleaseDataAtomic(batch->frame);
+    }
+    memset(batch, 0, sizeof(*batch));
+    return ret;
+}
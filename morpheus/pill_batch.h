@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "message_base.h"
+#include "morpheus_ble.pb.h"
+
+/**
+ * batched_pill_data built in place.
+ *
+ * Every pill_data is encoded once, straight into the frame as one more
+ * repeated field, so the filled part of the frame is a valid batched_pill_data
+ * at any time and goes to the cc3200 without a second encode.
+ * Kept free of sdk headers so the host test can build it.
+ */
+
+typedef struct{
+    MSG_Data_t * frame;
+    uint16_t len;       // bytes encoded so far
+    uint8_t count;      // pill_data entries
+}pill_batch_t;
+
+/*
+ * allocates a frame of capacity bytes and writes device_id, the sense's own id
+ */
+bool pill_batch_open(pill_batch_t * batch, uint16_t capacity, const char * device_id);
+/*
+ * appends pd as a batched_pill_data_pills_tag or batched_pill_data_prox_tag entry
+ * returns 0, -1 if it does not fit (the batch is unchanged), -2 on bad arguments
+ */
+int pill_batch_add(pill_batch_t * batch, uint32_t tag, const pill_data * pd);
+/*
+ * a view of the encoded part, NULL if nothing was added, the batch is closed either way
+ */
+MSG_Data_t * INCREF pill_batch_close(pill_batch_t * batch);
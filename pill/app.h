@@ -28,6 +28,9 @@ enum {
 
 #define IMU_FIFO_ENABLE
 
+// Deepen the LIS2DH fifo watermark while quiet, drop it back when a shake may be starting
+#define IMU_ADAPTIVE_WATERMARK
+
 // This define can be used to switch between 10Hz LP inactive to 1Hz inactive HRES
 #define IMU_ENABLE_LOW_POWER
 
@@ -43,6 +46,7 @@ enum {
 #endif
 
 #define IMU_ACTIVE_FREQ      (IMU_HZ_25)
+#define IMU_ACTIVE_SAMPLES_PER_SEC (25)  // IMU_ACTIVE_FREQ in samples, a second of the motion features
 
 #define IMU_CONSTANT_FREQ    (IMU_HZ_25)
 
@@ -50,6 +54,11 @@ enum {
 //#define IMU_FILTER_FIFO_DATA
 
 #define IMU_ONE_G            (15564u)
+
+// fifo watermark in samples, the LIS2DH fifo is 32 deep so keep some room before it overruns
+#define IMU_WTM_SHALLOW      (4)   // 160ms at 25Hz, shake detection latency
+#define IMU_WTM_DEEP         (28)  // 1.1s at 25Hz
+#define IMU_WTM_QUIET_DRAINS (2)   // drains without a shake candidate before the watermark doubles
 /*
  * BLE Connection Parameters
  */
@@ -121,4 +130,22 @@ enum {
 #define SLIDING_WINDOW_SIZE_SEC         (4) // shake second timer runs on imu active timer at 2hz now, so this is 2 secs
 #define SHAKING_DATA_COUNT_THRESHOLD    (12)
 
+// send the per-minute motion features instead of the plain motion payload, same airtime,
+// turn on once the server decodes ANT_PROTOCOL_VER_MOTION_FEATURES
+//#define ANT_PILL_MOTION_FEATURES
+// keep minutes in the timedfifo ring and send them full duplex as MotionRecord_t every
+// TF_SEND_INTERVAL_MIN minutes, resending until morpheus has echoed them. Turn on once the
+// server decodes ANT_PROTOCOL_VER_MOTION_RECORD and morpheus echoes pills that ask for it
+//#define TF_STORE_AND_FORWARD
+#ifdef TF_STORE_AND_FORWARD
+#define TF_CONDENSED_BUFFER_SIZE        (16)  // minutes with motion kept until sent, power of two, covers 16 - TF_SEND_INTERVAL_MIN minutes out of range
+#define TF_SEND_INTERVAL_MIN            (5)
+#define TF_SEND_BATCH_MAX               (8)   // records queued per send, the ant tx queue holds 16
+#else
 #define TF_CONDENSED_BUFFER_SIZE        (1)
+#endif
+// full duplex ant messages stream their pages as burst transfers once the central agrees in its
+// header echo, lockstep otherwise
+//#define ANT_PACKET_BURST
+// once the central agrees, resend only the pages its echoes report missing instead of each page in lockstep
+//#define ANT_PACKET_SELECTIVE
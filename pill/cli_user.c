@@ -10,6 +10,7 @@
 #include <ble.h>
 #include "heap.h"
 #include "message_prox.h"
+#include "message_app.h"
 
 #include "nrf_gpio.h"
 
@@ -172,6 +173,27 @@ _handle_command(int argc, char * argv[]){
         PRINT_HEX(&free_size, 4);
         PRINTS("\r\n");
     }
+    if( !match_command(argv[0], "mem") ){
+        //live messages by allocation site, "mem reset" restarts the per module peaks
+        if( argc > 1 && !match_command(argv[1], "reset") ){
+            MSG_Base_ResetAllocPeaks();
+        }else{
+            MSG_Base_PrintAllocations();
+        }
+    }
+    if( !match_command(argv[0], "stats")){
+        //dispatch latency and handler time per module, "stats reset" clears them
+        self.parent->dispatch( (MSG_Address_t){CLI,0},
+                                (MSG_Address_t){CENTRAL, (argc > 1 && !match_command(argv[1], "reset")) ? MSG_APP_STATS_RESET : MSG_APP_STATS},
+                                NULL);
+    }
+    if( !match_command(argv[0], "imu") ){
+        //fifo watermark and how often the imu woke us up
+        struct imu_fifo_stats st;
+        imu_get_fifo_stats(&st);
+        PRINTF("wtm %d, last min %d wakeups %d samples, this min %d wakeups %d samples\r\n",
+                st.watermark, st.wakeups, st.samples, st.wakeups_now, st.samples_now);
+    }
     //dispatch message through ANT
     if(argc > 0 && !match_command(argv[0], "ant") ){
         //Create a message object from uart string
@@ -13,11 +13,34 @@
 #define MSG_BASE_SHARED_POOL_SIZE 16
 #define MSG_BASE_DATA_BUFFER_SIZE (8 * sizeof(uint32_t))
 
+/*
+ * Slab pool size classes for MSG_Data_t (bytes, including the MSG_Data_t header), ascending multiples of 8.
+ * Off for the same reason as on morpheus (see morpheus/message_config.h), the arena would come out of
+ * a heap no bigger than morpheus'. Size the classes from measured heartbeat/shake/motion allocations.
+ */
+//#define MSG_BASE_POOL_CLASS_SIZES  {16, 24, 40}
+//#define MSG_BASE_POOL_CLASS_COUNTS {1, 1, 2}
+
+/*
+ * Per module dispatch latency/handler time histograms (see MSG_APP_STATS), costs ~50 bytes of RAM per module
+ */
+//#define MSG_CENTRAL_INSTRUMENTATION
+
+/*
+ * Debug only, tracks site/module/age of up to this many live MSG_Data_t (see MSG_Base_PrintAllocations), 16 bytes of RAM each
+ */
+//#define MSG_BASE_ALLOC_TRACKING 16
+
 #ifdef MSG_BASE_USE_BIG_POOL
 #define MSG_BASE_SHARED_POOL_SIZE_BIG 6
 #define MSG_BASE_DATA_BUFFER_SIZE_BIG 256
 #endif
 
+/*
+ * pending timed dispatches (1 sec, 1 min, imu wom and prox polling) sharing one app_timer
+ */
+#define MSG_CENTRAL_TIMED_SLOTS 4
+
 #define MSG_CENTRAL_MODULE_NUM  11
 
 
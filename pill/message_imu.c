@@ -37,7 +37,7 @@ enum {
     IMU_COLLECTION_INTERVAL = 6553, // in timer ticks, so 200ms (0.2*32768)
 };
 
-static app_timer_id_t _wom_timer;
+static uint8_t _wom_timer = MSG_TIMED_NONE;
 static app_gpiote_user_id_t _gpiote_user;
 static uint32_t _last_active_time;
 
@@ -52,6 +52,13 @@ static uint32_t active_time = 0;
 
 static void _update_motion_mask(uint32_t now, uint32_t anchor);
 
+static struct {
+	uint8_t watermark;
+	uint8_t quiet_drains;
+	uint16_t wakeups, samples;			// minute in progress
+	uint16_t last_wakeups, last_samples;
+} _fifo;
+
 static struct imu_settings _settings = {
 	.active_wom_threshold = IMU_ACTIVE_WOM,
     .inactive_wom_threshold = IMU_INACTIVE_WOM,
@@ -95,28 +102,26 @@ static void _dispatch_motion_data_via_ant(const int16_t* values, size_t len)
 #endif
 }
 
-static uint32_t _aggregate_motion_data(const int16_t* raw_xyz, size_t len)
+#if defined(IMU_FIFO_ENABLE) && defined(IMU_ADAPTIVE_WATERMARK)
+static void _set_watermark(uint8_t samples)
 {
-    int16_t values[3];
-//    uint16_t range;
-//    uint16_t maxrange
-    //auxillary_data_t * paux;
-    memcpy(values, raw_xyz, len);
-
-    //int32_t aggregate = ABS(values[0]) + ABS(values[1]) + ABS(values[2]);
-    uint32_t aggregate = values[0] * values[0] + values[1] * values[1] + values[2] * values[2];
-	
-	tf_unit_t* current = TF_GetCurrent();
-    ++current->num_meas;
-    if(current->max_amp < aggregate){
-        current->max_amp = aggregate;
-        PRINTF( "NEW MAX: %u\r\n", aggregate);
-    }
-    for(int i=0;i<3;++i){
-        current->avg_accel[i] += (values[i] - current->avg_accel[i])/current->num_meas;
-    }
-    return aggregate;
+	if(samples != _fifo.watermark){
+		imu_set_fifo_watermark(samples);
+		_fifo.watermark = samples;
+	}
+	_fifo.quiet_drains = 0;
+}
+
+// shallow while a shake could be building up, doubling towards deep while quiet
+static void _adapt_watermark(bool shake_candidate)
+{
+	if(shake_candidate){
+		_set_watermark(IMU_WTM_SHALLOW);
+	}else if(++_fifo.quiet_drains >= IMU_WTM_QUIET_DRAINS && _fifo.watermark < IMU_WTM_DEEP){
+		_set_watermark(MIN(_fifo.watermark * 2, IMU_WTM_DEEP));
+	}
 }
+#endif
 
 static void _imu_switch_mode(bool is_active)
 {
@@ -127,8 +132,17 @@ static void _imu_switch_mode(bool is_active)
 #endif
         imu_set_accel_freq(_settings.active_sampling_rate);
 //        imu_wom_set_threshold(_settings.active_wom_threshold); todo this is not meaninful anymore
+#if defined(IMU_FIFO_ENABLE) && defined(IMU_ADAPTIVE_WATERMARK)
+        //woken by motion, the first batches are the ones a shake shows up in
+        _set_watermark(IMU_WTM_SHALLOW);
+#endif
       
-        app_timer_start(_wom_timer, IMU_ACTIVE_INTERVAL, NULL);
+#ifdef IMU_DYNAMIC_SAMPLING
+        if(_wom_timer != MSG_TIMED_NONE){
+            parent->cancel(_wom_timer);
+        }
+        _wom_timer = parent->dispatch_every(ADDR(IMU, 0), ADDR(IMU, IMU_WOM_TICK), NULL, IMU_ACTIVE_INTERVAL);
+#endif
 
         PRINTS("IMU Active.\r\n");
         _settings.is_active = true;
@@ -138,9 +152,17 @@ static void _imu_switch_mode(bool is_active)
 #endif
         ShakeDetectReset(SHAKING_MOTION_THRESHOLD);
         imu_set_accel_freq(_settings.inactive_sampling_rate);
+#if defined(IMU_FIFO_ENABLE) && defined(IMU_ADAPTIVE_WATERMARK)
+        _set_watermark(IMU_WTM_DEEP);
+#endif
 //        imu_wom_set_threshold(_settings.inactive_wom_threshold); //only set this once in init
 
-        app_timer_stop(_wom_timer);
+#ifdef IMU_DYNAMIC_SAMPLING
+        if(_wom_timer != MSG_TIMED_NONE){
+            parent->cancel(_wom_timer);
+            _wom_timer = MSG_TIMED_NONE;
+        }
+#endif
         PRINTS("IMU Inactive.\r\n");
         _settings.is_active = false;
     }
@@ -173,7 +195,7 @@ static void _update_motion_mask(uint32_t now, uint32_t anchor){
 	}
 }
 
-static void _on_wom_timer(void* context)
+static void _on_wom_timer(void)
 {
     uint32_t current_time = 0;
     app_timer_cnt_get(&current_time);
@@ -199,6 +221,19 @@ clear_stuck_count(void)
 
 void top_of_meas_minute(void) {
     app_timer_cnt_get(&top_of_minute);
+    _fifo.last_wakeups = _fifo.wakeups;
+    _fifo.last_samples = _fifo.samples;
+    _fifo.wakeups = 0;
+    _fifo.samples = 0;
+}
+
+void imu_get_fifo_stats(struct imu_fifo_stats * stats)
+{
+	stats->watermark = _fifo.watermark;
+	stats->wakeups = _fifo.last_wakeups;
+	stats->samples = _fifo.last_samples;
+	stats->wakeups_now = _fifo.wakeups;
+	stats->samples_now = _fifo.samples;
 }
 
 uint8_t
@@ -255,14 +290,19 @@ static MSG_Status _init(void){
 		nrf_gpio_cfg_input(IMU_INT, NRF_GPIO_PIN_NOPULL);
 
 #ifdef IMU_DYNAMIC_SAMPLING
-		if(!imu_init_low_power(SPI_Channel_1, SPI_Mode3, IMU_SPI_MISO, IMU_SPI_MOSI, IMU_SPI_SCLK, IMU_SPI_nCS, 
+		if(!imu_init_low_power(SPI_Channel_0, SPI_Mode3, IMU_SPI_MISO, IMU_SPI_MOSI, IMU_SPI_SCLK, IMU_SPI_nCS, 
 			_settings.inactive_sampling_rate, _settings.accel_range, _settings.inactive_wom_threshold))
 #else
-        if(!imu_init_low_power(SPI_Channel_1, SPI_Mode3, IMU_SPI_MISO, IMU_SPI_MOSI, IMU_SPI_SCLK, IMU_SPI_nCS, 
+        if(!imu_init_low_power(SPI_Channel_0, SPI_Mode3, IMU_SPI_MISO, IMU_SPI_MOSI, IMU_SPI_SCLK, IMU_SPI_nCS, 
             _settings.active_sampling_rate, _settings.accel_range, _settings.active_wom_threshold))
 #endif
 		{
 		    imu_clear_interrupt_status();
+#if defined(IMU_FIFO_ENABLE) && defined(IMU_ADAPTIVE_WATERMARK)
+			// init programmed the driver's default, start deep until motion shows up
+			_fifo.watermark = 0;
+			_set_watermark(IMU_WTM_DEEP);
+#endif
 			APP_OK(app_gpiote_user_enable(_gpiote_user));
 			PRINTS("IMU: initialization done.\r\n");
 			initialized = true;
@@ -304,27 +344,30 @@ static MSG_Status _handle_read_xyz(void){
 #ifdef IMU_FIFO_ENABLE
 	{
 	int16_t values[IMU_FIFO_CAPACITY_WORDS]; //todo check if the stack can handle this
+	uint32_t mags[IMU_FIFO_CAPACITY_SAMPLES];
 	uint8_t ret;
-	int16_t* ptr = values;
-	uint32_t mag;
 
 	// Returns number of bytes read, 0 if no data read
 	ret = imu_handle_fifo_read(values);
 
 	if(ret){
 
-		// FIFO read, handle values
+		// FIFO read, the whole block goes into the minute at once
 
 		uint8_t i;
-		//loop:
-		for(i=0;i<ret/6;i++)
+		uint8_t samples = ret/6;
+		bool shake_candidate = false;
+		TF_AccumulateSamples(values, samples, mags);
+		for(i=0;i<samples;i++)
 		{
-			//aggregate value greater than threshold
-			mag = _aggregate_motion_data(ptr, 3*sizeof(int16_t));
-			ShakeDetect(mag);
-
-			ptr += 3;
+			shake_candidate |= ShakeDetect(mags[i]);
 		}
+		_fifo.samples += samples;
+#ifdef IMU_ADAPTIVE_WATERMARK
+		if(_settings.is_active){
+			_adapt_watermark(shake_candidate);
+		}
+#endif
 
 	}
 	}
@@ -336,10 +379,12 @@ static MSG_Status _handle_read_xyz(void){
 	imu_accel_reg_read((uint8_t*)values);
     PRINTS("R\r\n");
 
-	mag = _aggregate_motion_data(values, sizeof(values));
+	TF_AccumulateSamples(values, 1, &mag);
 	ShakeDetect(mag);
+	_fifo.samples++;
 #endif
 
+    _fifo.wakeups++;
     reading = false;
 
 #ifdef IMU_DYNAMIC_SAMPLING
@@ -382,6 +427,9 @@ static MSG_Status _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data)
 		case IMU_FORCE_SHAKE:
 			_on_pill_pairing_guesture_detected();
 			break;
+		case IMU_WOM_TICK:
+			_on_wom_timer();
+			break;
 	}
 	return ret;
 }
@@ -398,9 +446,6 @@ MSG_Base_t * MSG_IMU_Init(const MSG_Central_t * central)
 	base.send = _send;
 	base.type = IMU;
 	base.typestr = name;
-#ifdef IMU_DYNAMIC_SAMPLING
-	APP_OK(app_timer_create(&_wom_timer, APP_TIMER_MODE_REPEATED, _on_wom_timer));
-#endif
 	APP_OK(app_gpiote_user_register(&_gpiote_user, 0, 1 << IMU_INT, _imu_gpiote_process));
 	APP_OK(app_gpiote_user_disable(_gpiote_user));
     ShakeDetectReset(SHAKING_MOTION_THRESHOLD);
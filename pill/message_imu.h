@@ -28,6 +28,7 @@ typedef enum{
 	IMU_READ_XYZ,
 	IMU_SELF_TEST,
 	IMU_FORCE_SHAKE,
+	IMU_WOM_TICK,		//every IMU_ACTIVE_INTERVAL while active, from the central's timed dispatch
 }MSG_IMUAddress;
 
 /* See README_IMU.md for an introduction to the IMU, and vocabulary
@@ -44,4 +45,13 @@ uint8_t fix_imu_interrupt(void);
 
 void top_of_meas_minute(void);
 
+struct imu_fifo_stats {
+	uint8_t watermark;			// samples, 0 when the watermark is fixed
+	uint16_t wakeups;			// interrupts serviced in the last full minute
+	uint16_t samples;			// samples drained in the last full minute
+	uint16_t wakeups_now;		// same for the minute in progress
+	uint16_t samples_now;
+};
+void imu_get_fifo_stats(struct imu_fifo_stats * stats);
+
 MSG_Base_t * MSG_IMU_GetBase(void);
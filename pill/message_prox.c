@@ -12,7 +12,7 @@
 static char * name = "PROX";
 static const MSG_Central_t * parent;
 static MSG_Base_t base;
-static app_timer_id_t timer_id_prox;
+static uint8_t timer_id_prox = MSG_TIMED_NONE;
 static pstorage_handle_t fs;
 
 #define PROX_POLL_INTERVAL 15000 /*in ms*/
@@ -146,7 +146,10 @@ static MSG_Status _init(void){
     }
 
     if(SUCCESS ==  init_prox()){
-        app_timer_start(timer_id_prox, ticks, NULL);
+        if(timer_id_prox != MSG_TIMED_NONE){
+            parent->cancel(timer_id_prox);
+        }
+        timer_id_prox = parent->dispatch_every(ADDR(PROX, 0), ADDR(PROX, PROX_POLL), NULL, ticks);
         return SUCCESS;
     }else{
         return FAIL;
@@ -172,6 +175,9 @@ static MSG_Status _on_message(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *
         case PROX_ERASE_CALIBRATE:
             APP_OK(pstorage_clear(&fs, sizeof(prox_calibration_t)));
             break;
+        case PROX_POLL:
+            _send_available_prox_ant();
+            break;
         case PROX_READ_REPLY_BLE:
             {
                 uint32_t prox[2] = {0};
@@ -210,9 +216,6 @@ static void _send_available_prox_ant(){
     }
     }
 }
-static void _prox_timer_handler(void * ctx) {
-    _send_available_prox_ant();
-}
 MSG_Base_t * MSG_Prox_Init(const MSG_Central_t * central){
 	parent = central;
 	base.init = _init;
@@ -223,6 +226,5 @@ MSG_Base_t * MSG_Prox_Init(const MSG_Central_t * central){
 	base.typestr = name;
 
     twi_master_init();
-    APP_OK(app_timer_create(&timer_id_prox,APP_TIMER_MODE_REPEATED, _prox_timer_handler));
     return &base;
 }
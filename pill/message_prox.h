@@ -8,6 +8,7 @@ typedef enum{
 	PROX_START_CALIBRATE,
 	PROX_ERASE_CALIBRATE,
 	PROX_READ_REPLY_BLE,
+	PROX_POLL,		//every PROX_POLL_INTERVAL, from the central's timed dispatch
 }MSG_ProxAddress;
 
 MSG_Base_t * MSG_Prox_Init(const MSG_Central_t * central);
@@ -34,14 +34,20 @@ static struct{
     MSG_Base_t base;
     bool initialized;
     const MSG_Central_t * central;
-    app_timer_id_t timer_id_1sec;
-    app_timer_id_t timer_id_1min;
+    uint8_t timer_id_1sec;  //timed dispatch handles
+    uint8_t timer_id_1min;
     uint32_t uptime;
     uint32_t minutes;
     uint32_t last_wakeup;
     uint32_t onesec_runtime;
     uint8_t reed_states;
     uint8_t in_ship_state;
+#ifdef TF_STORE_AND_FORWARD
+    struct{
+        MSG_Data_t * msg;   //held until ant reports it sent
+        uint8_t seq;
+    }in_flight[TF_SEND_BATCH_MAX];
+#endif
 }self;
 
 static char * name = "TIME";
@@ -49,6 +55,18 @@ static char * name = "TIME";
 
 static app_gpiote_user_id_t _gpiote_user;
 
+static void _stop_periodic(uint8_t * handle){
+    if(*handle != MSG_TIMED_NONE){
+        self.central->cancel(*handle);
+        *handle = MSG_TIMED_NONE;
+    }
+}
+static void _start_periodic(uint8_t * handle, MSG_Time_Commands tick, uint32_t period){
+    _stop_periodic(handle);
+    *handle = self.central->dispatch_every(ADDR(TIME, 0), ADDR(TIME, tick), NULL, period);
+    APP_ASSERT(*handle != MSG_TIMED_NONE);
+}
+
 
 static MSG_Status
 _init(void){
@@ -68,23 +86,112 @@ _flush(void){
 }
 
 #ifdef ANT_STACK_SUPPORT_REQD
+#ifndef TF_STORE_AND_FORWARD
 static void _send_available_data_ant(){
+#ifdef ANT_PILL_MOTION_FEATURES
+    MotionFeaturesPayload_t motion[1];
+#else
     MotionPayload_t motion[1];
+#endif
+    if(MSG_ANT_TxPressure(ANT_PILL_DATA_ENCRYPTED) == MSG_QUEUE_PRESSURE_FULL){
+        //radio is backed up, don't spend aes and heap on a packet ant would drop
+        PRINTS("ANT busy, motion skipped\r\n");
+        return;
+    }
+#ifdef ANT_PILL_MOTION_FEATURES
+    if(TF_GetFeatures(motion)){
+#else
     if(TF_GetCondensed(motion)){
+#endif
         MSG_Data_t * data = AllocateEncryptedAntPayload(ANT_PILL_DATA_ENCRYPTED, motion, sizeof(motion));
-        PRINTF("data len %d, pwr %d\r\n", data->len, motion->max);
         if(data){
-            self.central->dispatch((MSG_Address_t){TIME,1}, (MSG_Address_t){ANT,1}, data);
-            self.central->dispatch((MSG_Address_t){TIME,1}, (MSG_Address_t){UART,MSG_UART_HEX}, data);
+#ifdef ANT_PILL_MOTION_FEATURES
+            //same type and length, the server tells the layouts apart by version
+            ((MSG_ANT_PillData_t*)data->buf)->version = ANT_PROTOCOL_VER_MOTION_FEATURES;
+            PRINTF("data len %d, features\r\n", data->len);
+#else
+            PRINTF("data len %d, pwr %d\r\n", data->len, motion->max);
+#endif
+            //ant, and uart in debug builds, subscribe in pill_ble_load_modules
+            self.central->publish((MSG_Address_t){TIME,1}, MSG_TOPIC_PILL_MOTION, data);
             MSG_Base_ReleaseDataAtomic(data);
         }
     }else{
         PRINTS("No Motion Recorded\r\n");
     }
 }
+#else
+static void _store_available_data(void){
+#ifdef ANT_PILL_MOTION_FEATURES
+    MotionFeaturesPayload_t motion[1];
+    if(TF_GetFeatures(motion)){
+#else
+    MotionPayload_t motion[1];
+    if(TF_GetCondensed(motion)){
+#endif
+        TF_StoreMinute(motion, self.minutes);
+    }else{
+        PRINTS("No Motion Recorded\r\n");
+    }
+}
+
+static void _release_in_flight(void){
+    uint8_t i;
+    for(i = 0; i < TF_SEND_BATCH_MAX; i++){
+        if(self.in_flight[i].msg){
+            MSG_Base_ReleaseDataAtomic(self.in_flight[i].msg);
+            self.in_flight[i].msg = NULL;
+        }
+    }
+}
+
+static void _send_stored_data_ant(void){
+    MotionRecord_t record;
+    uint8_t cursor = 0;
+    uint8_t i;
+    //whatever is still out from the last batch was dropped on the way, it goes again
+    _release_in_flight();
+    for(i = 0; i < TF_SEND_BATCH_MAX && TF_GetStored(&cursor, self.minutes, &record); i++){
+        MSG_Data_t * data;
+        if(MSG_ANT_TxPressure(ANT_PILL_DATA_ENCRYPTED) == MSG_QUEUE_PRESSURE_FULL){
+            PRINTS("ANT busy, rest stays stored\r\n");
+            break;
+        }
+        data = AllocateEncryptedAntPayload(ANT_PILL_DATA_ENCRYPTED, &record, sizeof(record));
+        if(!data){
+            break;
+        }
+#ifdef ANT_PILL_MOTION_FEATURES
+        ((MSG_ANT_PillData_t*)data->buf)->version = ANT_PROTOCOL_VER_MOTION_RECORD_FEATURES;
+#else
+        ((MSG_ANT_PillData_t*)data->buf)->version = ANT_PROTOCOL_VER_MOTION_RECORD;
+#endif
+        self.central->publish((MSG_Address_t){TIME,1}, MSG_TOPIC_PILL_MOTION, data);
+        self.in_flight[i].msg = data;
+        self.in_flight[i].seq = record.seq;
+    }
+    PRINTF("stored %d sent %d drops %d\r\n", TF_StoredCount(), i, TF_StoredDrops());
+}
+
+static void _on_ant_sent(const MSG_Data_t * data){
+    uint8_t i;
+    for(i = 0; i < TF_SEND_BATCH_MAX; i++){
+        if(self.in_flight[i].msg && self.in_flight[i].msg == data){
+            TF_AckStored(self.in_flight[i].seq);
+            MSG_Base_ReleaseDataAtomic(self.in_flight[i].msg);
+            self.in_flight[i].msg = NULL;
+            break;
+        }
+    }
+}
+#endif
 
 static void _send_heartbeat_data_ant(){
     pill_heartbeat_t heartbeat = {0};
+    if(MSG_ANT_TxPressure(ANT_PILL_HEARTBEAT) == MSG_QUEUE_PRESSURE_FULL){
+        PRINTS("ANT busy, heartbeat skipped\r\n");
+        return;
+    }
     heartbeat.battery_level = battery_get_percent_cached();
     heartbeat.uptime_sec = self.uptime;
     heartbeat.firmware_build = FIRMWARE_VERSION_8BIT;
@@ -111,17 +218,29 @@ static void _update_uptime() {
 
 void _send_data_test(void){
     PRINTS("Sending\r\n");
+#ifdef TF_STORE_AND_FORWARD
+    _send_stored_data_ant();
+#else
     _send_available_data_ant();
+#endif
     _send_heartbeat_data_ant();
 }
-static void _1min_timer_handler(void * ctx) {
+static void _1min_timer_handler(void) {
     _update_uptime();
     self.minutes += 1;
     
     fix_imu_interrupt(); // look for imu int stuck low
 
 #ifdef ANT_ENABLE
+#ifdef TF_STORE_AND_FORWARD
+    _store_available_data();
+    //a backlog means the last batches didn't get through, keep trying every minute until it's down
+    if(self.minutes % TF_SEND_INTERVAL_MIN == 0 || TF_StoredCount() >= TF_CONDENSED_BUFFER_SIZE / 2){
+        _send_stored_data_ant();
+    }
+#else
     _send_available_data_ant();
+#endif
     if(self.minutes % HEARTBEAT_INTERVAL_MIN == 0) { // update percent battery capacity
         if( !self.in_ship_state ){
             _send_heartbeat_data_ant();
@@ -142,7 +261,7 @@ static void _1min_timer_handler(void * ctx) {
 #define MAX_1SEC_TIMER_RUNTIME  10
 
 extern int imu_self_test();
-static void _1sec_timer_handler(void * ctx){
+static void _1sec_timer_handler(void){
     PRINTS("*");
     _update_uptime();
 
@@ -194,7 +313,7 @@ static void _1sec_timer_handler(void * ctx){
     }
     
     if( self.onesec_runtime > MAX_1SEC_TIMER_RUNTIME ) {
-        app_timer_stop(self.timer_id_1sec);
+        _stop_periodic(&self.timer_id_1sec);
         self.onesec_runtime = 0;
         PRINTS("\nStopping 1sec\r\n");
         APP_OK(app_gpiote_user_enable(_gpiote_user));
@@ -208,26 +327,29 @@ static MSG_Status _send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t * data)
             break;
         case MSG_TIME_STOP_PERIODIC:
             PRINTS("STOP_HEARTBEAT\r\n");
-            app_timer_stop(self.timer_id_1min);
-            app_timer_stop(self.timer_id_1sec);
+            _stop_periodic(&self.timer_id_1min);
+            _stop_periodic(&self.timer_id_1sec);
             break;
         case MSG_TIME_SET_START_1SEC:
-            {
-                uint32_t ticks;
-                ticks = APP_TIMER_TICKS(1000,APP_TIMER_PRESCALER);
-                app_timer_stop(self.timer_id_1sec);
-                app_timer_start(self.timer_id_1sec, ticks, NULL);
-                self.onesec_runtime = 0;
-            }
+            _start_periodic(&self.timer_id_1sec, MSG_TIME_TICK_1SEC, APP_TIMER_TICKS(1000,APP_TIMER_PRESCALER));
+            self.onesec_runtime = 0;
             break;
         case MSG_TIME_SET_START_1MIN:
-        {
-            uint32_t ticks;
             PRINTS("PERIODIC 1 MIN\r\n");
-            ticks = APP_TIMER_TICKS(60000,APP_TIMER_PRESCALER);
-            app_timer_stop(self.timer_id_1min);
-            app_timer_start(self.timer_id_1min, ticks, NULL);
-        }
+            _start_periodic(&self.timer_id_1min, MSG_TIME_TICK_1MIN, APP_TIMER_TICKS(60000,APP_TIMER_PRESCALER));
+            break;
+        case MSG_TIME_TICK_1SEC:
+            _1sec_timer_handler();
+            break;
+        case MSG_TIME_TICK_1MIN:
+            _1min_timer_handler();
+            break;
+        case MSG_TIME_ANT_SENT:
+#if defined(ANT_STACK_SUPPORT_REQD) && defined(TF_STORE_AND_FORWARD)
+            if(data){
+                _on_ant_sent(data);
+            }
+#endif
             break;
     }
     return SUCCESS;
@@ -255,23 +377,19 @@ MSG_Base_t * MSG_Time_Init(const MSG_Central_t * central){
         self.minutes = 0;
         self.last_wakeup = 0;
         self.onesec_runtime = 0;
-      
-        if(app_timer_create(&self.timer_id_1sec,APP_TIMER_MODE_REPEATED,_1sec_timer_handler) == NRF_SUCCESS
-           && app_timer_create(&self.timer_id_1min,APP_TIMER_MODE_REPEATED,_1min_timer_handler) == NRF_SUCCESS
-          ){
-            self.initialized = 1;
-            TF_Initialize();
+        self.timer_id_1sec = MSG_TIMED_NONE;
+        self.timer_id_1min = MSG_TIMED_NONE;
+        self.initialized = 1;
+        TF_Initialize();
 
 #if defined(PLATFORM_HAS_REED) && !defined(PLATFORM_HAS_VLED)
-            nrf_gpio_cfg_input(LED_REED_ENABLE, NRF_GPIO_PIN_NOPULL);
-            APP_OK(app_gpiote_user_register(&_gpiote_user, 1 << LED_REED_ENABLE, 1 << LED_REED_ENABLE, _reed_gpiote_process));
-            APP_OK(app_gpiote_user_disable(_gpiote_user));
-            
+        nrf_gpio_cfg_input(LED_REED_ENABLE, NRF_GPIO_PIN_NOPULL);
+        APP_OK(app_gpiote_user_register(&_gpiote_user, 1 << LED_REED_ENABLE, 1 << LED_REED_ENABLE, _reed_gpiote_process));
+        APP_OK(app_gpiote_user_disable(_gpiote_user));
+        
 #elif defined(PLATFORM_HAS_REED)
-            APP_OK(1);
+        APP_OK(1);
 #endif
-
-        }
     }
     return &self.base;
 }
@@ -13,6 +13,9 @@ typedef enum{
     MSG_TIME_STOP_PERIODIC,
     MSG_TIME_SET_START_1SEC,
     MSG_TIME_SET_START_1MIN,
+    MSG_TIME_TICK_1SEC,     //periodic ticks from the central's timed dispatch
+    MSG_TIME_TICK_1MIN,
+    MSG_TIME_ANT_SENT,      //MSG_TOPIC_ANT_SENT, acks stored minutes
 }MSG_Time_Commands;
 
 MSG_Base_t * MSG_Time_Init(const MSG_Central_t * central);
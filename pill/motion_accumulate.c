@@ -0,0 +1,40 @@
+#include "motion_accumulate.h"
+
+void motion_accumulate_block(const int16_t * xyz, uint16_t samples, uint32_t * mags, motion_block_t * out){
+    int32_t sx = 0, sy = 0, sz = 0;
+    uint32_t max = 0;
+    const int16_t * end = xyz + 3 * samples;
+    //unrolled over the axes, each square fits 31 bits so the sum fits 32 unsigned
+    while(xyz < end){
+        int32_t x = xyz[0];
+        int32_t y = xyz[1];
+        int32_t z = xyz[2];
+        uint32_t mag = (uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z);
+        sx += x;
+        sy += y;
+        sz += z;
+        if(mag > max){
+            max = mag;
+        }
+        *mags++ = mag;
+        xyz += 3;
+    }
+    out->sum[0] = sx;
+    out->sum[1] = sy;
+    out->sum[2] = sz;
+    out->max_mag = max;
+}
+
+void motion_accumulate_mean(const int32_t sum[3], uint32_t count, int16_t out[3]){
+    uint32_t recip;
+    int i;
+    if(!count){
+        out[0] = out[1] = out[2] = 0;
+        return;
+    }
+    //0.32 fixed point reciprocal, off by at most one ulp, which stays below half a count for |sum| < 2^31
+    recip = 0xFFFFFFFFu / count;
+    for(i = 0; i < 3; i++){
+        out[i] = (int16_t)(((int64_t)sum[i] * recip + (1ll << 31)) >> 32);
+    }
+}
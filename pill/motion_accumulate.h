@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+/**
+ * Batch accumulation of x,y,z int16 accelerometer samples.
+ *
+ * The kernel walks a whole FIFO block at once and only adds, there is no
+ * division per sample (the M0 has no divider, every / is a library call).
+ * The mean is taken once at minute close from the running sums.
+ * Kept free of sdk headers so the host bench can build it.
+ */
+
+typedef struct{
+    int32_t sum[3];
+    uint32_t max_mag;
+}motion_block_t;
+
+/*
+ * xyz holds samples * 3 int16 values as read from the fifo.
+ * Writes the squared magnitude of every sample into mags (for the shake
+ * detector) and the block's axis sums and largest magnitude into out.
+ */
+void motion_accumulate_block(const int16_t * xyz, uint16_t samples, uint32_t * mags, motion_block_t * out);
+/*
+ * rounded mean of the three sums over count samples, one division total
+ */
+void motion_accumulate_mean(const int32_t sum[3], uint32_t count, int16_t out[3]);
@@ -0,0 +1,208 @@
+#include <string.h>
+#include "motion_features.h"
+
+#define AXIS_NONE 0xFF
+//per sample energy scale, keeps a second of shaking at 100Hz inside 32 bits
+#define ENERGY_SHIFT 16
+//the lowest bin holds everything up to 2^ENERGY_BIN_SHIFT, sensor noise at rest stays a few bins up
+#define ENERGY_BIN_SHIFT 6
+
+static uint8_t
+_bitlen(uint32_t v){
+    //no clz on the M0, runs once a second
+    uint8_t n = 0;
+    while(v){
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static uint8_t
+_dominant_axis(const int32_t sum[3]){
+    uint32_t best = 0;
+    uint8_t axis = 0;
+    int i;
+    for(i = 0; i < 3; i++){
+        uint32_t a = sum[i] < 0 ? -(uint32_t)sum[i] : (uint32_t)sum[i];
+        if(a > best){
+            best = a;
+            axis = 2 * i + (sum[i] < 0);
+        }
+    }
+    return axis;
+}
+
+static void
+_close_second(motion_features_t * f){
+    uint8_t bin, axis;
+    if(!f->sec_samples){
+        return;
+    }
+    bin = _bitlen(f->sec_energy >> ENERGY_BIN_SHIFT);
+    if(bin >= MOTION_FEATURES_BINS){
+        bin = MOTION_FEATURES_BINS - 1;
+    }
+    if(f->hist[bin] < UINT8_MAX){
+        f->hist[bin]++;
+    }
+    if(f->seconds < UINT8_MAX){
+        f->seconds++;
+    }
+    axis = _dominant_axis(f->sec_sum);
+    if(f->last_axis != AXIS_NONE && axis != f->last_axis && f->orientation_changes < UINT8_MAX){
+        f->orientation_changes++;
+    }
+    f->last_axis = axis;
+    f->sec_samples = 0;
+    f->sec_energy = 0;
+    memset(f->sec_sum, 0, sizeof(f->sec_sum));
+}
+
+void motion_features_init(motion_features_t * f, uint32_t one_g, uint16_t samples_per_sec){
+    memset(f, 0, sizeof(*f));
+    f->one_g_sq = one_g * one_g;
+    f->samples_per_sec = samples_per_sec ? samples_per_sec : 1;
+    f->last_axis = AXIS_NONE;
+}
+
+void motion_features_reset(motion_features_t * f){
+    uint32_t one_g_sq = f->one_g_sq;
+    uint16_t samples_per_sec = f->samples_per_sec;
+    uint8_t last_axis = f->last_axis;
+    memset(f, 0, sizeof(*f));
+    f->one_g_sq = one_g_sq;
+    f->samples_per_sec = samples_per_sec;
+    f->last_axis = last_axis;
+}
+
+void motion_features_add(motion_features_t * f, const int16_t * xyz, const uint32_t * mags, uint16_t samples){
+    //band of +-1/8 g^2 around rest, about +-6% in magnitude
+    const uint32_t hi = f->one_g_sq + (f->one_g_sq >> 3);
+    const uint32_t lo = f->one_g_sq - (f->one_g_sq >> 3);
+    const int16_t * end = xyz + 3 * samples;
+    while(xyz < end){
+        uint32_t mag = *mags++;
+        f->sec_energy += (mag > f->one_g_sq ? mag - f->one_g_sq : f->one_g_sq - mag) >> ENERGY_SHIFT;
+        f->sec_sum[0] += xyz[0];
+        f->sec_sum[1] += xyz[1];
+        f->sec_sum[2] += xyz[2];
+        //one crossing per swing from above the band to below it
+        if(mag > hi){
+            f->above = 1;
+        }else if(mag < lo){
+            if(f->above > 0){
+                f->crossings++;
+            }
+            f->above = -1;
+        }
+        if(++f->sec_samples == f->samples_per_sec){
+            _close_second(f);
+        }
+        xyz += 3;
+    }
+}
+
+static uint8_t
+_quantile(const motion_features_t * f, uint8_t percent){
+    uint32_t need = ((uint32_t)f->seconds * percent + 99) / 100;
+    uint32_t seen = 0;
+    uint8_t i;
+    if(!f->seconds){
+        return 0;
+    }
+    for(i = 0; i < MOTION_FEATURES_BINS; i++){
+        seen += f->hist[i];
+        if(seen >= need){
+            return i;
+        }
+    }
+    return MOTION_FEATURES_BINS - 1;
+}
+
+void motion_features_close(motion_features_t * f, uint64_t motion_mask, motion_summary_t * out){
+    uint8_t run = 0, i;
+    int8_t top;
+    _close_second(f);
+
+    out->coarse_mask = 0;
+    out->motion_seconds = 0;
+    out->longest_still = 0;
+    for(i = 0; i < 60; i++){
+        if(motion_mask & (1ull << i)){
+            out->coarse_mask |= 1 << (i >> 2);
+            out->motion_seconds++;
+            run = 0;
+        }else if(++run > out->longest_still){
+            out->longest_still = run;
+        }
+    }
+    out->active_seconds = f->seconds > 63 ? 63 : f->seconds;
+    out->energy_p50 = _quantile(f, 50);
+    out->energy_p90 = _quantile(f, 90);
+    for(top = MOTION_FEATURES_BINS - 1; top > 0 && !f->hist[top]; top--){
+    }
+    out->energy_max = top;
+    out->crossings = f->crossings > UINT8_MAX ? UINT8_MAX : f->crossings;
+    out->orientation_changes = f->orientation_changes > 31 ? 31 : f->orientation_changes;
+}
+
+static void
+_put(uint8_t * buf, uint8_t * pos, uint32_t value, uint8_t bits){
+    while(bits--){
+        if(value & 1){
+            buf[*pos >> 3] |= 1 << (*pos & 7);
+        }
+        value >>= 1;
+        (*pos)++;
+    }
+}
+
+static uint32_t
+_get(const uint8_t * buf, uint8_t * pos, uint8_t bits){
+    uint32_t value = 0;
+    uint8_t i;
+    for(i = 0; i < bits; i++, (*pos)++){
+        if(buf[*pos >> 3] & (1 << (*pos & 7))){
+            value |= 1u << i;
+        }
+    }
+    return value;
+}
+
+/*
+ * 80 bits, least significant bit first, the same 10 bytes as MotionPayload_t
+ *   0 max 8, 8 cos_theta 8, 16 coarse_mask 15, 31 motion_seconds 6,
+ *  37 longest_still 6, 43 active_seconds 6, 49 energy_p50 4, 53 energy_p90 4,
+ *  57 energy_max 4, 61 crossings 8, 69 orientation_changes 5, 74 reserved 6
+ */
+void motion_features_pack(const motion_summary_t * s, uint8_t out[MOTION_FEATURES_PACKED_SIZE]){
+    uint8_t pos = 0;
+    memset(out, 0, MOTION_FEATURES_PACKED_SIZE);
+    _put(out, &pos, s->max, 8);
+    _put(out, &pos, s->cos_theta, 8);
+    _put(out, &pos, s->coarse_mask, 15);
+    _put(out, &pos, s->motion_seconds, 6);
+    _put(out, &pos, s->longest_still, 6);
+    _put(out, &pos, s->active_seconds, 6);
+    _put(out, &pos, s->energy_p50, 4);
+    _put(out, &pos, s->energy_p90, 4);
+    _put(out, &pos, s->energy_max, 4);
+    _put(out, &pos, s->crossings, 8);
+    _put(out, &pos, s->orientation_changes, 5);
+}
+
+void motion_features_unpack(const uint8_t in[MOTION_FEATURES_PACKED_SIZE], motion_summary_t * s){
+    uint8_t pos = 0;
+    s->max = _get(in, &pos, 8);
+    s->cos_theta = _get(in, &pos, 8);
+    s->coarse_mask = _get(in, &pos, 15);
+    s->motion_seconds = _get(in, &pos, 6);
+    s->longest_still = _get(in, &pos, 6);
+    s->active_seconds = _get(in, &pos, 6);
+    s->energy_p50 = _get(in, &pos, 4);
+    s->energy_p90 = _get(in, &pos, 4);
+    s->energy_max = _get(in, &pos, 4);
+    s->crossings = _get(in, &pos, 8);
+    s->orientation_changes = _get(in, &pos, 5);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+/**
+ * Per-minute motion features beyond max, orientation change and the motion mask.
+ *
+ * Fed with the same fifo blocks as motion_accumulate_block, constant work per
+ * sample (adds, compares, no division, no multiply beyond the squares the
+ * block kernel already made). A second here is samples_per_sec consecutive
+ * samples, the imu only delivers samples while active so these are active
+ * seconds. Anything that needs wall clock seconds comes from the motion mask.
+ * Kept free of sdk headers so the host harness can build it.
+ */
+
+#define MOTION_FEATURES_BINS 16
+#define MOTION_FEATURES_PACKED_SIZE 10
+
+typedef struct{
+    uint32_t one_g_sq;              // squared magnitude at rest, raw counts
+    uint16_t samples_per_sec;
+    // second in progress
+    uint16_t sec_samples;
+    uint32_t sec_energy;
+    int32_t sec_sum[3];
+    uint8_t last_axis;              // dominant gravity axis of the last second, 0-5, 0xFF before the first
+    // minute in progress
+    int8_t above;                   // magnitude above (1) or below (-1) the 1g band, 0 inside it
+    uint8_t seconds;
+    uint8_t orientation_changes;
+    uint16_t crossings;
+    uint8_t hist[MOTION_FEATURES_BINS];
+}motion_features_t;
+
+/*
+ * unpacked form of the feature payload, see motion_features_pack for the wire layout
+ */
+typedef struct{
+    uint8_t max;                    // same as MotionPayload_t
+    uint8_t cos_theta;              // same as MotionPayload_t
+    uint16_t coarse_mask;           // motion mask folded into 4 second groups, bit n is seconds 4n-4n+3
+    uint8_t motion_seconds;         // bits set in the motion mask
+    uint8_t longest_still;          // longest run of seconds without motion
+    uint8_t active_seconds;         // seconds of samples seen, saturates at 63
+    uint8_t energy_p50;             // per second energy quantiles, log2 bins
+    uint8_t energy_p90;
+    uint8_t energy_max;
+    uint8_t crossings;              // swings through the 1g band, step like movement, saturates
+    uint8_t orientation_changes;    // changes of the dominant gravity axis between seconds, saturates at 31
+}motion_summary_t;
+
+void motion_features_init(motion_features_t * f, uint32_t one_g, uint16_t samples_per_sec);
+/*
+ * start of a minute, keeps the configuration and the last orientation
+ */
+void motion_features_reset(motion_features_t * f);
+/*
+ * xyz and mags as passed to and filled by motion_accumulate_block
+ */
+void motion_features_add(motion_features_t * f, const int16_t * xyz, const uint32_t * mags, uint16_t samples);
+/*
+ * closes the partial second and fills everything but max and cos_theta
+ */
+void motion_features_close(motion_features_t * f, uint64_t motion_mask, motion_summary_t * out);
+
+void motion_features_pack(const motion_summary_t * s, uint8_t out[MOTION_FEATURES_PACKED_SIZE]);
+void motion_features_unpack(const uint8_t in[MOTION_FEATURES_PACKED_SIZE], motion_summary_t * s);
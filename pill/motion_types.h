@@ -10,4 +10,24 @@ typedef struct {
     uint64_t motion_mask;
 } __attribute__((packed))  MotionPayload_t;
 
+/*
+ * same size on the air as MotionPayload_t, bit-packed motion_summary_t,
+ * layout in pill/motion_features.c, sent with ANT_PROTOCOL_VER_MOTION_FEATURES
+ */
+typedef struct {
+    uint8_t packed[10];
+} __attribute__((packed))  MotionFeaturesPayload_t;
+
+/*
+ * one stored minute as it goes over the air with TF_STORE_AND_FORWARD, 12 bytes
+ * so the encrypted record still fits morpheus' 20 byte pill data field.
+ * seq counts stored minutes and wraps, age is taken when the record is built,
+ * so the minute it describes is arrival - age. Resent records repeat seq.
+ */
+typedef struct {
+    uint8_t seq;
+    uint8_t age;            // minutes, saturates at 255
+    uint8_t payload[10];    // MotionPayload_t or MotionFeaturesPayload_t
+} __attribute__((packed))  MotionRecord_t;
+
 #endif
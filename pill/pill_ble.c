@@ -89,6 +89,27 @@ static void _command_write_handler(ble_gatts_evt_write_t* event)
 	case PILL_COMMAND_READ_PROX:
 		central->dispatch( ADDR(BLE, 0), ADDR(PROX, PROX_READ_REPLY_BLE), NULL);
 		break;
+	case PILL_COMMAND_READ_DISPATCH_STATS:
+		{
+			//notify holds on to the buffer until the last packet goes out
+			static MSG_App_ModuleStats_t stats;
+			if(MSG_App_GetModuleStats(command->module, &stats)){
+				hlo_ble_notify(0xD00D, (uint8_t*)&stats, sizeof(stats), NULL);
+			}else{
+				hlo_ble_notify(0xD00D, "NoStats", 7, NULL);
+			}
+		}
+		break;
+	case PILL_COMMAND_READ_ALLOC_STATS:
+		{
+			static MSG_Base_AllocStats_t alloc;
+			if(MSG_Base_GetAllocStats(command->module, &alloc)){
+				hlo_ble_notify(0xD00D, (uint8_t*)&alloc, sizeof(alloc), NULL);
+			}else{
+				hlo_ble_notify(0xD00D, "NoStats", 7, NULL);
+			}
+		}
+		break;
     default:
         break;
     };
@@ -144,6 +165,7 @@ void pill_ble_load_modules(void){
 			};
 			central->loadmod(MSG_Uart_Base(&uart_params, central));
 			central->loadmod(MSG_Cli_Base(central, Cli_User_Init(central, NULL)));
+			central->subscribe(MSG_TOPIC_PILL_MOTION, ADDR(UART, MSG_UART_HEX));
 		}
 		central->loadmod(MSG_Time_Init(central));
 #ifdef PLATFORM_HAS_IMU
@@ -156,6 +178,13 @@ void pill_ble_load_modules(void){
 #else
         central->loadmod(MSG_ANT_Base(central, ANT_UserInit(central), HLO_ANT_ROLE_PERIPHERAL, HLO_ANT_DEVICE_TYPE_PILL));
 #endif
+#ifdef TF_STORE_AND_FORWARD
+        //records go full duplex, sent then means morpheus echoed every page
+        central->subscribe(MSG_TOPIC_PILL_MOTION, ADDR(ANT, MSG_ANT_TRANSMIT_RECEIVE));
+        central->subscribe(MSG_TOPIC_ANT_SENT, ADDR(TIME, MSG_TIME_ANT_SENT));
+#else
+        central->subscribe(MSG_TOPIC_PILL_MOTION, ADDR(ANT, 1));
+#endif
 
 #endif
 
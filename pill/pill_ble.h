@@ -21,6 +21,8 @@ enum pill_command_type {
     PILL_COMMAND_RESET = 9,
     PILL_COMMAND_WIPE_CALIBRATION,
     PILL_COMMAND_READ_PROX,
+    PILL_COMMAND_READ_DISPATCH_STATS,
+    PILL_COMMAND_READ_ALLOC_STATS,
 } __attribute__((packed));
 
 struct pill_command
@@ -28,6 +30,7 @@ struct pill_command
     enum pill_command_type command;
     union {
         struct hlo_ble_time set_time;
+        uint8_t module; // PILL_COMMAND_READ_DISPATCH_STATS, PILL_COMMAND_READ_ALLOC_STATS
     };
 } __attribute__((packed));
 
@@ -1,13 +1,36 @@
 #include <string.h>
+#include <stdlib.h>
 #include "platform.h"
 #include "app.h"
 #include "app_timer.h"
 
 #include "timedfifo.h"
+#include "motion_accumulate.h"
+#include "motion_features.h"
 #include "util.h"
 
+#ifdef TF_STORE_AND_FORWARD
+#define TF_STORE_MASK (TF_CONDENSED_BUFFER_SIZE - 1)
+
+typedef struct{
+    uint32_t minute;
+    uint8_t seq;
+    uint8_t acked;
+    uint8_t payload[sizeof(((MotionRecord_t*)0)->payload)];
+}tf_stored_t;
+#endif
+
 static struct{
     tf_unit_t data;
+    motion_features_t features;     //kept out of the packed tf_unit_t, it has 32 bit members
+#ifdef TF_STORE_AND_FORWARD
+    //ring of unacked minutes, read and write are free running
+    tf_stored_t stored[TF_CONDENSED_BUFFER_SIZE];
+    uint8_t read;
+    uint8_t write;
+    uint8_t next_seq;
+    uint32_t drops;
+#endif
 }self;
 
 static void
@@ -15,24 +38,58 @@ _reset_tf_unit(tf_unit_t * current){
     for (int i = 0; i < 3; i++) {
         current->prev_avg_accel[i] = current->avg_accel[i];
         current->avg_accel[i] = 0;
+        current->sum_accel[i] = 0;
     }
     current->has_motion = 0;
     current->motion_mask = 0;
     current->max_amp = 0;
+    current->num_meas = 0;
+}
+//the only division of the minute
+static void
+_close_minute(tf_unit_t * current){
+    int32_t sum[3];
+    int16_t avg[3];
+    memcpy(sum, current->sum_accel, sizeof(sum));
+    motion_accumulate_mean(sum, current->num_meas, avg);
+    memcpy(current->avg_accel, avg, sizeof(avg));
 }
 void TF_Initialize(){
-    memset(&self.data, 0, sizeof(self.data));
+#ifdef TF_STORE_AND_FORWARD
+    //power of two so the ring index is a mask
+    APP_ASSERT(TF_CONDENSED_BUFFER_SIZE && !(TF_CONDENSED_BUFFER_SIZE & TF_STORE_MASK));
+#endif
+    memset(&self, 0, sizeof(self));
     _reset_tf_unit(&self.data);
+    motion_features_init(&self.features, IMU_ONE_G, IMU_ACTIVE_SAMPLES_PER_SEC);
 }
 
 void TF_TickOneMinute() {
+    _close_minute(&self.data);
     _reset_tf_unit(&self.data);
+    motion_features_reset(&self.features);
     PRINTS("^");
 }
 
 tf_unit_t * TF_GetCurrent(void){
     return &self.data;
 }
+
+uint32_t TF_AccumulateSamples(const int16_t * xyz, uint16_t samples, uint32_t * mags){
+    motion_block_t block;
+    tf_unit_t * current = &self.data;
+    motion_accumulate_block(xyz, samples, mags, &block);
+    for (int i = 0; i < 3; i++) {
+        current->sum_accel[i] += block.sum[i];
+    }
+    current->num_meas += samples;
+    motion_features_add(&self.features, xyz, mags, samples);
+    if(current->max_amp < block.max_mag){
+        current->max_amp = block.max_mag;
+        PRINTF( "NEW MAX: %u\r\n", block.max_mag);
+    }
+    return block.max_mag;
+}
 #define PRINT_HEX_X(x) PRINT_HEX(&x, sizeof(x)); PRINTS("\r\n");
 
 //assumes result is near 1 in 16.16
@@ -45,10 +102,11 @@ static uint32_t _fastinvsqrt( uint32_t x ) {
     x = (uint32_t)(((uint64_t)x * ( (one|half) - (((uint64_t)x * x)>>17)))>>16); //thanks quake - http://betterexplained.com/articles/understanding-quakes-fast-inverse-square-root/
     return x;
 }
-static uint32_t _mag( uint16_t * x ) {
+static uint32_t _mag( const int16_t * x ) {
     uint32_t m=0;
     for (int k = 0; k < 3; k++) {
-        m += ((uint32_t)x[k]*x[k])>>16;
+        //square signed, a negative axis read as uint16 squares to nearly 2^32
+        m += ((uint32_t)((int32_t)x[k]*x[k]))>>16;
     }
     return m;
 }
@@ -88,7 +146,9 @@ static uint8_t _bitlog(uint32_t n) {
 // for posterity -- this used to be used instead of dump payload
 bool TF_GetCondensed(MotionPayload_t* payload){
     bool has_data = false;
-    tf_unit_t datum = self.data;
+    tf_unit_t datum;
+    _close_minute(&self.data);
+    datum = self.data;
     
     if(payload && datum.motion_mask ){
         int32_t dot = 0;
@@ -124,3 +184,81 @@ bool TF_GetCondensed(MotionPayload_t* payload){
     return has_data;
 }
 
+bool TF_GetFeatures(MotionFeaturesPayload_t* payload){
+    MotionPayload_t condensed;
+    motion_summary_t summary;
+    if(!payload || !TF_GetCondensed(&condensed)){
+        return false;
+    }
+    motion_features_close(&self.features, condensed.motion_mask, &summary);
+    summary.max = condensed.max;
+    summary.cos_theta = condensed.cos_theta;
+    motion_features_pack(&summary, payload->packed);
+    PRINTF("features active %d still %d p90 %d crossings %d turns %d\r\n", summary.active_seconds, summary.longest_still, summary.energy_p90, summary.crossings, summary.orientation_changes);
+    return true;
+}
+
+#ifdef TF_STORE_AND_FORWARD
+//acks only mark their minute, trimming waits until no walk is in progress
+static void
+_trim_stored(void){
+    while(self.read != self.write && self.stored[self.read & TF_STORE_MASK].acked){
+        self.read++;
+    }
+}
+
+void TF_StoreMinute(const void * payload, uint32_t minute){
+    tf_stored_t * entry;
+    _trim_stored();
+    if((uint8_t)(self.write - self.read) == TF_CONDENSED_BUFFER_SIZE){
+        //never got through, the newest minutes are worth more
+        self.read++;
+        self.drops++;
+    }
+    entry = &self.stored[self.write++ & TF_STORE_MASK];
+    entry->minute = minute;
+    entry->seq = self.next_seq++;
+    entry->acked = 0;
+    memcpy(entry->payload, payload, sizeof(entry->payload));
+}
+
+bool TF_GetStored(uint8_t * cursor, uint32_t now, MotionRecord_t * out){
+    if(!*cursor){
+        _trim_stored();
+    }
+    while((uint8_t)(self.write - self.read) > *cursor){
+        const tf_stored_t * entry = &self.stored[(self.read + (*cursor)++) & TF_STORE_MASK];
+        if(!entry->acked){
+            uint32_t age = now - entry->minute;
+            out->seq = entry->seq;
+            out->age = age > UINT8_MAX ? UINT8_MAX : age;
+            memcpy(out->payload, entry->payload, sizeof(out->payload));
+            return true;
+        }
+    }
+    return false;
+}
+
+void TF_AckStored(uint8_t seq){
+    uint8_t i;
+    for(i = self.read; i != self.write; i++){
+        tf_stored_t * entry = &self.stored[i & TF_STORE_MASK];
+        if(entry->seq == seq){
+            entry->acked = 1;
+            break;
+        }
+    }
+}
+
+uint8_t TF_StoredCount(void){
+    uint8_t i, n = 0;
+    for(i = self.read; i != self.write; i++){
+        n += !self.stored[i & TF_STORE_MASK].acked;
+    }
+    return n;
+}
+
+uint32_t TF_StoredDrops(void){
+    return self.drops;
+}
+#endif
@@ -15,8 +15,9 @@
 
 typedef struct {
     uint32_t max_amp;
-    int16_t avg_accel[3];
+    int16_t avg_accel[3];   //valid once the minute is closed
     int16_t prev_avg_accel[3];
+    int32_t sum_accel[3];
     uint64_t motion_mask;
     uint32_t num_meas;
     uint8_t has_motion;
@@ -26,3 +27,33 @@ void TF_Initialize();
 void TF_TickOneMinute(void);
 tf_unit_t* TF_GetCurrent(void);
 bool TF_GetCondensed(MotionPayload_t* buf);
+/*
+ * TF_GetCondensed plus the minute's motion_features, packed into the same 10 bytes
+ */
+bool TF_GetFeatures(MotionFeaturesPayload_t* buf);
+/*
+ * adds a block of x,y,z samples to the current minute, fills mags with the
+ * squared magnitude of each sample and returns the largest
+ */
+uint32_t TF_AccumulateSamples(const int16_t * xyz, uint16_t samples, uint32_t * mags);
+
+#ifdef TF_STORE_AND_FORWARD
+/*
+ * store and forward ring of the last TF_CONDENSED_BUFFER_SIZE minutes with
+ * motion, each a 10 byte payload from TF_GetCondensed or TF_GetFeatures.
+ * Minutes stay until acked, a full ring drops the oldest.
+ * minute is any free running minute count, only differences are used.
+ */
+void TF_StoreMinute(const void * payload, uint32_t minute);
+/*
+ * walks the unacked minutes oldest first, *cursor starts at 0, acks may come in
+ * during a walk. Fills out with the age relative to now, false past the newest
+ */
+bool TF_GetStored(uint8_t * cursor, uint32_t now, MotionRecord_t * out);
+/*
+ * the minute with this seq has been delivered, unknown seqs are ignored
+ */
+void TF_AckStored(uint8_t seq);
+uint8_t TF_StoredCount(void);
+uint32_t TF_StoredDrops(void);
+#endif
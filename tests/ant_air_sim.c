@@ -0,0 +1,541 @@
+// vi:noet:sw=4 ts=4
+
+// Discrete event simulation of one central and up to 16 peripherals on the
+// ant network channel, both ends running ant/ant_packet.c through their
+// hlo_ant_event_listener_t the way ant_driver.c drives it.
+// Build and run from the top level:
+//make host && ./build/host/ant_air_sim
+//make host && ./build/host/ant_air_sim -n 8 -l 10 -s 120 -i 500 -t 120
+//make host ANT_SIM_FLAGS="-DANT_PACKET_BURST -DANT_PACKET_SELECTIVE" && ./build/host/ant_air_sim
+//
+// Without options a fixed set of runs is printed and checked, make host-bench
+// runs it as a regression benchmark. Any option runs that one setup instead:
+//   -n peripherals     -l loss in percent    -s message bytes
+//   -i ms between messages per peripheral, +-50% jitter
+//   -t simulated seconds   -b period bias (HLO_ANT_NETWORK_PERIOD_BIAS)
+//   -c ticks on air per packet     -u unacknowledged, pill style
+//   -r random seed
+//
+// Time runs in 1/32768 s ticks. Every peripheral opens its channel when a
+// message is queued and sends one packet per channel period of
+// HLO_ANT_NETWORK_PERIOD - bias / 2 + device number % bias ticks, the central
+// scans and echoes in the same slot, an acknowledged slot is on the air for
+// three packets: the packet, the turnaround and the echo. Packets and echoes
+// are lost at random, two transmissions that overlap on the air are both
+// lost. A burst sends its packets BURST_TICKS apart, each in an acknowledged
+// slot, and tries each one BURST_TRIES times. A burst packet that collides
+// loses its first try.
+// Queued messages go out back to back, a failed one is retried
+// APP_RETRIES times like message_ant.c does, the channel closes when the
+// queue is empty. Time to deliver runs from queueing to the central's
+// on_message. All nodes share the host heap, the build grows it.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ant_packet.h"
+#include "ant_packet_peer.h"
+#include "ant_devices.h"
+#include "crc16.h"
+
+#define TICKS_PER_SEC 32768
+#define NETWORK_PERIOD 128			// HLO_ANT_NETWORK_PERIOD in ant_driver.c
+#define NETWORK_PERIOD_BIAS 8		// HLO_ANT_NETWORK_PERIOD_BIAS
+#define MAX_BURST 8					// HLO_ANT_BURST_MAX_PACKETS
+#define BURST_TICKS 102				// 8 byte packet at 20 kbps
+#define BURST_TRIES 3
+#define APP_RETRIES 3				// _on_message_failed in message_ant.c
+#define MAX_NODES ANT_PACKET_MAX_CONCURRENT_SESSIONS
+#define QUEUE 8
+#define MAX_LATENCIES 65536
+#define AIR_LOG 128
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+typedef struct {
+	uint32_t nodes;
+	uint32_t loss_pct;
+	uint32_t size;
+	uint32_t interval_ms;
+	uint32_t seconds;
+	uint32_t bias;
+	uint32_t air;
+	bool broadcast;
+} setup_t;
+
+typedef struct {
+	uint64_t messages, delivered, failed, dropped, duplicates, bad, sent_undelivered;
+	uint64_t bytes, packets, retransmits, collisions, bursts;
+	uint32_t latency_count;
+} result_t;
+
+typedef struct {
+	hlo_ant_device_t device;
+	uint32_t period;
+	bool open;
+	uint64_t next;				// next channel event while open
+	uint64_t arrival;			// next message queued
+	uint64_t queue[QUEUE];		// queueing times, queue[head] is on the air
+	uint8_t head, queued;
+	uint32_t seq;				// message on the air
+	uint8_t retries;
+	bool delivered;
+	bool done;					// sent or failed, next one goes after the event
+	bool failed;
+	uint8_t seen[256];			// copies of each page of the message sent
+	uint8_t count;				// packets on the air until end, 0 if none
+	bool burst;
+	uint64_t start, end;
+	uint8_t buf[MAX_BURST * 8];
+} node_t;
+
+static struct {
+	uint64_t start, end;
+	uint8_t node;
+} _air[AIR_LOG];
+static uint32_t _air_pos;
+
+static setup_t _setup;
+static result_t _res;
+static node_t _nodes[MAX_NODES];
+static uint64_t _now;
+static uint32_t _latency[MAX_LATENCIES];
+static hlo_ant_event_listener_t *_central, *_peripheral;
+static uint32_t _seed = 0x2545F491;
+
+static uint32_t
+_rand(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+static bool
+_lost(void)
+{
+	return _rand() % 100 < _setup.loss_pct;
+}
+
+static node_t *
+_node(const hlo_ant_device_t *device)
+{
+	return &_nodes[device->device_number - 0x3000];
+}
+
+static void
+_fill(uint8_t *buf, uint32_t size, uint16_t device_number, uint32_t seq)
+{
+	uint32_t i;
+	for (i = 0; i < size; i++)
+		buf[i] = (uint8_t)(seq * 131 + device_number * 7 + i);
+	memcpy(buf, &seq, sizeof(seq) < size ? sizeof(seq) : size);
+}
+
+// central side
+
+static void
+_on_message(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	node_t *n = _node(device);
+	uint8_t expect[256];
+	uint32_t seq = 0;
+
+	memcpy(&seq, message->buf, sizeof(seq) < message->len ? sizeof(seq) : message->len);
+	_fill(expect, _setup.size, device->device_number, seq);
+	if (message->len != _setup.size || memcmp(message->buf, expect, _setup.size)) {
+		_res.bad++;
+	} else if (seq != n->seq || n->delivered || !n->queued) {
+		_res.duplicates++;
+	} else {
+		n->delivered = true;
+		_res.delivered++;
+		_res.bytes += message->len;
+		if (_res.latency_count < MAX_LATENCIES)
+			_latency[_res.latency_count++] = (uint32_t)(_now - n->queue[n->head]);
+	}
+}
+
+static MSG_Data_t *
+_on_connect(const hlo_ant_device_t *device)
+{
+	return NULL;
+}
+
+static void
+_on_central_done(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+}
+
+static const hlo_ant_packet_listener _central_listener = { _on_connect, _on_message, _on_central_done, _on_central_done };
+
+// peripheral side
+
+static void
+_on_sent(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	node_t *n = _node(device);
+	if (!n->delivered)
+		_res.sent_undelivered++;
+	n->done = true;
+	n->failed = false;
+}
+
+static void
+_on_failed(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	node_t *n = _node(device);
+	n->done = true;
+	n->failed = true;
+}
+
+static const hlo_ant_packet_listener _peripheral_listener = { _on_connect, _on_message, _on_sent, _on_failed };
+
+int32_t hlo_ant_connect(const hlo_ant_device_t *device, bool full_duplex)
+{
+	node_t *n = _node(device);
+	if (!n->open) {
+		n->open = true;
+		n->next = _now;
+	}
+	return 0;
+}
+
+static void
+_send_head(node_t *n)
+{
+	uint8_t buf[256];
+	MSG_Data_t *msg;
+
+	_fill(buf, _setup.size, n->device.device_number, n->seq);
+	msg = MSG_Base_AllocateObjectAtomic(buf, _setup.size);
+	if (!msg || hlo_ant_packet_send_message_peer(&n->device, msg, !_setup.broadcast) != 0) {
+		// out of memory counts as a failed attempt
+		n->done = true;
+		n->failed = true;
+	}
+	if (msg)
+		MSG_Base_ReleaseDataAtomic(msg);
+}
+
+// what message_ant.c does once the packet layer is done with a message
+static void
+_next_message(node_t *n)
+{
+	n->done = false;
+	if (n->failed && n->retries++ < APP_RETRIES) {
+		_send_head(n);
+		return;
+	}
+	if (n->failed)
+		_res.failed++;
+	n->head = (n->head + 1) % QUEUE;
+	n->queued--;
+	if (!n->queued) {
+		n->open = false;
+		return;
+	}
+	n->seq++;
+	n->retries = 0;
+	n->delivered = false;
+	memset(n->seen, 0, sizeof(n->seen));
+	_send_head(n);
+}
+
+static void
+_arrive(node_t *n)
+{
+	_res.messages++;
+	n->arrival = _now + (uint64_t)_setup.interval_ms * TICKS_PER_SEC / 1000 / 2
+			+ (uint64_t)(_rand() % (_setup.interval_ms + 1)) * TICKS_PER_SEC / 1000;
+	if (n->queued == QUEUE) {
+		_res.dropped++;
+		return;
+	}
+	n->queue[(n->head + n->queued) % QUEUE] = _now;
+	if (!n->queued++) {
+		n->seq++;
+		n->retries = 0;
+		n->delivered = false;
+		memset(n->seen, 0, sizeof(n->seen));
+		_send_head(n);
+	}
+}
+
+// count packets spacing ticks apart, each on the air for slot ticks
+static void
+_on_air(node_t *n, uint8_t count, uint64_t slot, uint64_t spacing)
+{
+	uint8_t i;
+	n->count = count;
+	n->start = _now;
+	n->end = _now + (count - 1) * spacing + slot;
+	for (i = 0; i < count; i++) {
+		const uint8_t *packet = &n->buf[i * 8];
+		_air[_air_pos].start = _now + i * spacing;
+		_air[_air_pos].end = _now + i * spacing + slot;
+		_air[_air_pos].node = n - _nodes;
+		_air_pos = (_air_pos + 1) % AIR_LOG;
+		// the packet after the last page carries no payload, it is not a copy of anything
+		if ((packet[1] || !packet[0]) && n->seen[packet[0]]++)
+			_res.retransmits++;
+	}
+}
+
+// channel event of n, what ant_driver.c _handle_tx does
+static void
+_channel_event(node_t *n)
+{
+	uint8_t count = 0;
+	if (!_setup.broadcast && _peripheral->on_burst_event)
+		count = _peripheral->on_burst_event(&n->device, n->buf, MAX_BURST);
+	if (count) {
+		_res.bursts++;
+		n->burst = true;
+		_on_air(n, count, 3 * _setup.air, BURST_TICKS);
+		return;
+	}
+	n->burst = false;
+	memset(n->buf, 0, 8);
+	if (_peripheral->on_tx_event(&n->device, n->buf, HLO_ANT_ROLE_PERIPHERAL, !_setup.broadcast)) {
+		_res.packets++;
+		_on_air(n, 1, _setup.broadcast ? _setup.air : 3 * _setup.air, 0);
+	} else {
+		n->next += n->period;
+	}
+}
+
+// another node on the air between start and end
+static bool
+_collided(const node_t *n, uint64_t start, uint64_t end)
+{
+	uint32_t i;
+	for (i = 0; i < AIR_LOG; i++)
+		if (_air[i].node != n - _nodes && _air[i].end > _air[i].start
+				&& _air[i].start < end && _air[i].end > start)
+			return true;
+	return false;
+}
+
+// the central answers in the same slot
+static void
+_echo(node_t *n)
+{
+	uint8_t echo[8] = { 0 };
+	bool ack = true;
+	if (!_central->on_tx_event(&n->device, echo, HLO_ANT_ROLE_CENTRAL, true))
+		return;
+	_res.packets++;
+	if (_lost())
+		_peripheral->on_error_event(&n->device, HLO_ANT_EVENT_TX_FAILED);
+	else
+		_peripheral->on_rx_event(&n->device, echo, sizeof(echo), HLO_ANT_ROLE_PERIPHERAL, &ack);
+}
+
+// end of n's transmission
+static void
+_deliver(node_t *n)
+{
+	bool ack = true;
+	uint8_t i, count = n->count;
+
+	n->count = 0;
+	do
+		n->next += n->period;
+	while (n->next < n->end);
+	if (n->burst) {
+		for (i = 0; i < count; i++) {
+			uint64_t start = n->start + i * BURST_TICKS;
+			uint8_t tries = 0;
+			if (_collided(n, start, start + 3 * _setup.air)) {
+				_res.collisions++;
+				_res.packets++;
+				tries++;
+			}
+			while (tries++ < BURST_TRIES && (_res.packets++, _lost()))
+				;
+			if (tries > BURST_TRIES)
+				break;
+			_res.packets++;
+			_central->on_rx_event(&n->device, &n->buf[i * 8], 8, HLO_ANT_ROLE_CENTRAL, &ack);
+		}
+		if (i < count)
+			_peripheral->on_error_event(&n->device, HLO_ANT_EVENT_TX_FAILED);
+		else
+			_echo(n);
+		return;
+	}
+	if (_collided(n, n->start, n->end)) {
+		_res.collisions++;
+		if (!_setup.broadcast)
+			_peripheral->on_error_event(&n->device, HLO_ANT_EVENT_TX_FAILED);
+		return;
+	}
+	if (_lost()) {
+		if (!_setup.broadcast)
+			_peripheral->on_error_event(&n->device, HLO_ANT_EVENT_TX_FAILED);
+		return;
+	}
+	_central->on_rx_event(&n->device, n->buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+	if (ack && !_setup.broadcast)
+		_echo(n);
+}
+
+static int
+_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double
+_ms(uint32_t ticks)
+{
+	return ticks * 1000.0 / TICKS_PER_SEC;
+}
+
+static void
+_run(const setup_t *setup)
+{
+	uint64_t end;
+	uint32_t i;
+
+	_setup = *setup;
+	memset(&_res, 0, sizeof(_res));
+	memset(_nodes, 0, sizeof(_nodes));
+	memset(_air, 0, sizeof(_air));
+	_now = 0;
+	_central = hlo_ant_packet_init(&_central_listener);
+	_peripheral = hlo_ant_packet_init_peer(&_peripheral_listener);
+	for (i = 0; i < _setup.nodes; i++) {
+		node_t *n = &_nodes[i];
+		n->device.device_number = 0x3000 + i;
+		// the central does not echo pills, full duplex peers are pill 1.5 and up
+		n->device.device_type = _setup.broadcast ? HLO_ANT_DEVICE_TYPE_PILL : HLO_ANT_DEVICE_TYPE_PILL1_5;
+		n->period = NETWORK_PERIOD - _setup.bias / 2 + (_setup.bias ? n->device.device_number % _setup.bias : 0);
+		n->arrival = (uint64_t)(_rand() % (_setup.interval_ms + 1)) * TICKS_PER_SEC / 1000;
+	}
+
+	end = (uint64_t)_setup.seconds * TICKS_PER_SEC;
+	while (1) {
+		node_t *next = NULL;
+		uint64_t t = UINT64_MAX;
+		int what = 0;
+
+		// arrivals stop at the end, what is queued then still gets its chance
+		for (i = 0; i < _setup.nodes; i++) {
+			node_t *n = &_nodes[i];
+			if (n->arrival < end && n->arrival < t)
+				t = n->arrival, next = n, what = 0;
+			if (n->count && n->end < t)
+				t = n->end, next = n, what = 1;
+			else if (!n->count && n->open && n->next < t)
+				t = n->next, next = n, what = 2;
+		}
+		if (!next)
+			break;
+		_now = t;
+		if (what == 0)
+			_arrive(next);
+		else if (what == 1)
+			_deliver(next);
+		else
+			_channel_event(next);
+		// message_ant.c moves on from the scheduler, not from inside the packet layer
+		for (i = 0; i < _setup.nodes; i++)
+			if (_nodes[i].done && !_nodes[i].count)
+				_next_message(&_nodes[i]);
+	}
+
+	qsort(_latency, _res.latency_count, sizeof(_latency[0]), _cmp);
+	printf("  %2u nodes, %s, %2u%% loss, %3u bytes every %4u ms, bias %u: %6.0f B/s, %5.2f retransmissions and %4.1f packets per delivered, %5llu collisions, %5.1f%% delivered, %llu failed, %llu dropped\n",
+			_setup.nodes, _setup.broadcast ? "broadcast" : "reliable ", _setup.loss_pct, _setup.size,
+			_setup.interval_ms, _setup.bias, (double)_res.bytes * TICKS_PER_SEC / _now,
+			_res.delivered ? (double)_res.retransmits / _res.delivered : 0.0,
+			_res.delivered ? (double)_res.packets / _res.delivered : 0.0, (unsigned long long)_res.collisions,
+			_res.messages ? 100.0 * _res.delivered / _res.messages : 0.0,
+			(unsigned long long)_res.failed, (unsigned long long)_res.dropped);
+	if (_res.latency_count)
+		printf("      time to deliver ms: p50 %6.1f  p90 %6.1f  p99 %6.1f  max %6.1f\n",
+				_ms(_latency[_res.latency_count / 2]), _ms(_latency[_res.latency_count * 9 / 10]),
+				_ms(_latency[_res.latency_count * 99 / 100]), _ms(_latency[_res.latency_count - 1]));
+}
+
+int main(int argc, char **argv)
+{
+	static const struct { uint32_t nodes, loss, size, interval, bias; bool broadcast; } runs[] = {
+		{ 1, 0, 30, 1000, NETWORK_PERIOD_BIAS, false },
+		{ 4, 0, 30, 1000, NETWORK_PERIOD_BIAS, false },
+		{ 16, 0, 30, 500, 0, false },
+		{ 16, 0, 30, 500, NETWORK_PERIOD_BIAS, false },
+		{ 8, 10, 30, 500, NETWORK_PERIOD_BIAS, false },
+		{ 8, 10, 120, 500, NETWORK_PERIOD_BIAS, false },
+		{ 16, 20, 30, 500, NETWORK_PERIOD_BIAS, false },
+		{ 8, 10, 30, 500, NETWORK_PERIOD_BIAS, true },
+	};
+	setup_t setup = { 4, 0, 30, 1000, 60, NETWORK_PERIOD_BIAS, 5, false };
+	uint32_t r, unbiased = 0;
+	int argi;
+
+	for (argi = 1; argi < argc; argi++) {
+		const char *opt = argv[argi];
+		uint32_t v = argi + 1 < argc ? (uint32_t)atoi(argv[argi + 1]) : 0;
+		if (!strcmp(opt, "-u")) {
+			setup.broadcast = true;
+			continue;
+		}
+		if (argi + 1 == argc)
+			break;
+		argi++;
+		if (!strcmp(opt, "-n") && v && v <= MAX_NODES)
+			setup.nodes = v;
+		else if (!strcmp(opt, "-l") && v <= 100)
+			setup.loss_pct = v;
+		else if (!strcmp(opt, "-s") && v && v <= 255)
+			setup.size = v;
+		else if (!strcmp(opt, "-i") && v)
+			setup.interval_ms = v;
+		else if (!strcmp(opt, "-t") && v)
+			setup.seconds = v;
+		else if (!strcmp(opt, "-b") && v <= NETWORK_PERIOD / 2)
+			setup.bias = v;
+		else if (!strcmp(opt, "-c") && v)
+			setup.air = v;
+		else if (!strcmp(opt, "-r") && v)
+			_seed = v;
+		else
+			break;
+	}
+	if (argi < argc) {
+		fprintf(stderr, "usage: %s [-n peripherals] [-l loss %%] [-s bytes] [-i ms] [-t seconds] [-b bias] [-c air ticks] [-u] [-r seed]\n", argv[0]);
+		return 2;
+	}
+
+	printf("ant air simulation, %u tick channel period, %u ticks on air per packet\n", NETWORK_PERIOD, setup.air);
+	if (argc > 1) {
+		_run(&setup);
+		return _res.bad ? 1 : 0;
+	}
+	for (r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+		setup.nodes = runs[r].nodes;
+		setup.loss_pct = runs[r].loss;
+		setup.size = runs[r].size;
+		setup.interval_ms = runs[r].interval;
+		setup.bias = runs[r].bias;
+		setup.broadcast = runs[r].broadcast;
+		_run(&setup);
+		CHECK(!_res.bad);
+		// a reliable sender only calls a message sent once the central has it
+		CHECK(setup.broadcast || !_res.sent_undelivered);
+		if (!setup.loss_pct && setup.nodes == 1)
+			CHECK(_res.delivered == _res.messages && !_res.retransmits);
+		// the period bias keeps channels from colliding period after period
+		if (!setup.bias)
+			unbiased = (uint32_t)_res.delivered;
+		else if (r && !runs[r - 1].bias)
+			CHECK(_res.delivered > unbiased);
+	}
+	return 0;
+}
@@ -0,0 +1,209 @@
+// vi:noet:sw=4 ts=4
+
+// Sends full duplex messages from a peripheral copy of ant/ant_packet.c to a
+// central copy over a simulated channel, with and without ANT_PACKET_BURST.
+// Build and run from the top level:
+//make host && ./build/host/ant_burst_test
+//
+// One channel period at a time the peripheral gets its tx event the way
+// ant_driver.c hands it out: a burst if the packet layer has one, else a
+// single acknowledged packet the central echoes back in the same period.
+// A central built without ANT_PACKET_BURST echoes the header with flags 0,
+// the legacy runs clear them on the way back.
+//
+// Channel model: every packet, echo or burst packet is lost at random. ANT
+// retries a burst packet up to BURST_TRIES times before it fails the whole
+// transfer, every burst packet that made it is acknowledged. A burst runs at
+// 20 kbps, 5 packets in the time of 4 broadcasts at the 256 Hz channel
+// period. A radio wakeup is one channel event or one burst.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ant_packet.h"
+#include "ant_packet_peer.h"
+#include "ant_devices.h"
+#include "crc16.h"
+
+#define MAX_BURST 8			// HLO_ANT_BURST_MAX_PACKETS in ant_driver.c
+#define BURST_TRIES 3
+#define MESSAGES 2000
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static hlo_ant_event_listener_t *_central, *_peripheral;
+static const hlo_ant_device_t _pill = { .device_number = 0x2001, .device_type = HLO_ANT_DEVICE_TYPE_PILL1_5 };
+
+static uint8_t _msg[240];
+static uint16_t _size;
+static uint32_t _delivered, _bad, _sent, _failed;
+
+static void
+_on_message(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	if (message->len == _size && !memcmp(message->buf, _msg, _size))
+		_delivered++;
+	else
+		_bad++;
+}
+
+static MSG_Data_t *
+_on_connect(const hlo_ant_device_t *device)
+{
+	return NULL;
+}
+
+static void
+_on_sent(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	_sent++;
+}
+
+static void
+_on_failed(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	_failed++;
+}
+
+static const hlo_ant_packet_listener _listener = { _on_connect, _on_message, _on_sent, _on_failed };
+
+int32_t hlo_ant_connect(const hlo_ant_device_t *device, bool full_duplex)
+{
+	return 0;
+}
+
+static uint32_t _seed = 0x2545F491;
+static uint32_t _loss_pct;
+
+static bool
+_lost(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed % 100 < _loss_pct;
+}
+
+typedef struct {
+	uint32_t periods;
+	uint32_t wakeups;
+	uint32_t packets;		// on air, echoes and burst acks included
+	uint32_t bursts;
+	uint32_t bursts_failed;
+} link_t;
+
+// the central answers what it just got, legacy centrals never set flags
+static void
+_echo(link_t *l, bool legacy)
+{
+	uint8_t echo[8] = { 0 };
+	bool ack = true;
+	if (!_central->on_tx_event(&_pill, echo, HLO_ANT_ROLE_CENTRAL, true))
+		return;
+	if (legacy)
+		echo[2] = 0;
+	l->packets++;
+	if (!_lost())
+		_peripheral->on_rx_event(&_pill, echo, sizeof(echo), HLO_ANT_ROLE_PERIPHERAL, &ack);
+}
+
+// one message from the peripheral until it is sent or failed
+static void
+_run(link_t *l, bool legacy)
+{
+	uint8_t buf[MAX_BURST * 8];
+	uint32_t done = _sent + _failed, busy = 0;
+	MSG_Data_t *msg = MSG_Base_AllocateObjectAtomic(_msg, _size);
+
+	hlo_ant_packet_send_message_peer(&_pill, msg, true);
+	MSG_Base_ReleaseDataAtomic(msg);
+	while (_sent + _failed == done) {
+		uint8_t i, count;
+		bool ack = true;
+
+		l->periods++;
+		if (busy) {
+			busy--;
+			continue;
+		}
+		count = _peripheral->on_burst_event(&_pill, buf, MAX_BURST);
+		if (count) {
+			l->wakeups++;
+			l->bursts++;
+			busy = (count * 4 + 4) / 5 - 1;
+			for (i = 0; i < count; i++) {
+				uint8_t tries = 0;
+				while (tries++ < BURST_TRIES && (l->packets++, _lost()))
+					;
+				if (tries > BURST_TRIES)
+					break;
+				l->packets++;
+				_central->on_rx_event(&_pill, &buf[i * 8], 8, HLO_ANT_ROLE_CENTRAL, &ack);
+			}
+			if (i < count) {
+				l->bursts_failed++;
+				_peripheral->on_error_event(&_pill, HLO_ANT_EVENT_TX_FAILED);
+			} else {
+				_echo(l, legacy);
+			}
+			continue;
+		}
+		if (!_peripheral->on_tx_event(&_pill, buf, HLO_ANT_ROLE_PERIPHERAL, true))
+			continue;
+		l->wakeups++;
+		l->packets++;
+		if (_lost())
+			continue;
+		_central->on_rx_event(&_pill, buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+		if (ack)
+			_echo(l, legacy);
+	}
+}
+
+int main()
+{
+	static const uint16_t sizes[] = { 30, 120, 240 };
+	static const uint32_t losses[] = { 0, 10 };
+	uint32_t s, p, i, n = 0;
+
+	_central = hlo_ant_packet_init(&_listener);
+	_peripheral = hlo_ant_packet_init_peer(&_listener);
+	CHECK(_central->on_burst_event && _peripheral->on_burst_event);
+
+	printf("ant burst, full duplex, %u messages per run, bursts of up to %u pages\n", MESSAGES, MAX_BURST);
+	for (p = 0; p < sizeof(losses) / sizeof(losses[0]); p++) {
+		_loss_pct = losses[p];
+		for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			link_t lockstep = { 0 }, burst = { 0 };
+			uint32_t r, delivered[2], failed[2];
+			_size = sizes[s];
+			for (r = 0; r < 2; r++) {
+				_delivered = _failed = _sent = 0;
+				for (i = 0; i < MESSAGES; i++) {
+					uint32_t b;
+					for (b = 0; b < _size; b++)
+						_msg[b] = (uint8_t)(++n * 37 + b);
+					_run(r ? &burst : &lockstep, !r);
+				}
+				CHECK(!_bad);
+				delivered[r] = _delivered;
+				failed[r] = _failed;
+			}
+			// every message the peripheral counts as sent made it, nothing was lost without loss
+			CHECK(!_loss_pct || delivered[1] >= MESSAGES - failed[1]);
+			if (!_loss_pct)
+				CHECK(delivered[0] == MESSAGES && delivered[1] == MESSAGES && !burst.bursts_failed);
+			// a legacy central never agrees, the peripheral stays in lockstep
+			CHECK(!lockstep.bursts && burst.bursts);
+			printf("  %3u bytes, %2u%% loss:\n", _size, _loss_pct);
+			printf("    lockstep: %5.1f periods, %5.1f wakeups, %5.1f packets per message, %4.1f%% delivered\n",
+					(double)lockstep.periods / MESSAGES, (double)lockstep.wakeups / MESSAGES,
+					(double)lockstep.packets / MESSAGES, 100.0 * delivered[0] / MESSAGES);
+			printf("    burst:    %5.1f periods, %5.1f wakeups, %5.1f packets per message, %4.1f%% delivered, %u bursts failed\n",
+					(double)burst.periods / MESSAGES, (double)burst.wakeups / MESSAGES,
+					(double)burst.packets / MESSAGES, 100.0 * delivered[1] / MESSAGES, burst.bursts_failed);
+		}
+	}
+	return 0;
+}
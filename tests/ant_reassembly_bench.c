@@ -0,0 +1,261 @@
+// vi:noet:sw=4 ts=4
+
+// Feeds pill messages page by page into the central side of ant/ant_packet.c
+// and reports the cpu cost of reassembling them, before (the whole object crc
+// the baseline ran on every page copy) and after (page bitmap, running crc).
+// Build and run from the top level:
+//make host && ./build/host/ant_reassembly_bench
+//
+// Pages arrive like a pill sends them outside lockstep: the header, then every
+// page DEFAULT_ANT_RETRANSMIT_COUNT (4) times in a row. Crc work is counted in
+// bytes through the host crc16_compute. The lossy run drops a fixed share of
+// the packets at random, a message whose page never made it is not delivered.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ant_packet.h"
+#include "ant_devices.h"
+#include "crc16.h"
+
+#define REPEATS 4
+#define ROUNDS 20000
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static const uint16_t _sizes[] = { 30, 120, 384 };
+
+static hlo_ant_event_listener_t *_ant;
+static uint32_t _delivered;
+static uint8_t _corrupt_page;		// first copy of this page arrives with a flipped bit
+static bool _before;				// packets go to _before_rx instead
+
+// the baseline's _assemble_rx for one session: every copy of every page is
+// written in and the whole object is crc'd again, a match is the message
+static struct {
+	uint8_t page_count;
+	uint16_t checksum;
+	MSG_Data_t *obj;
+} _old;
+
+static void
+_before_rx(const uint8_t *packet)
+{
+	uint16_t crc = (uint16_t)(packet[7] << 8) | packet[6], off, i;
+
+	if (packet[0] == 0 && packet[1] > 0) {
+		uint16_t size = (uint16_t)(packet[5] << 8) | packet[4];
+		if (crc != _old.checksum) {
+			_old.page_count = packet[1];
+			_old.checksum = crc;
+			if (size <= MSG_Base_FreeCount() && size != 0) {
+				if (_old.obj)
+					MSG_Base_ReleaseDataAtomic(_old.obj);
+				_old.obj = MSG_Base_AllocateDataAtomic(size);
+			}
+		}
+	} else if (_old.obj && packet[0] && packet[1] && packet[0] <= _old.page_count) {
+		off = (packet[0] - 1) * 6;
+		for (i = 0; i < 6 && off + i < _old.obj->len; i++)
+			_old.obj->buf[off + i] = packet[2 + i];
+		if (crc16_compute(_old.obj->buf, _old.obj->len, NULL) == _old.checksum) {
+			_delivered++;
+			MSG_Base_ReleaseDataAtomic(_old.obj);
+			_old.obj = NULL;
+		}
+	}
+}
+
+static void
+_on_message(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	_delivered++;
+}
+
+static MSG_Data_t *
+_on_connect(const hlo_ant_device_t *device)
+{
+	return NULL;
+}
+
+static void
+_on_done(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+}
+
+static const hlo_ant_packet_listener _listener = { _on_connect, _on_message, _on_done, _on_done };
+
+int32_t hlo_ant_connect(const hlo_ant_device_t *device, bool full_duplex)
+{
+	return 0;
+}
+
+static uint32_t _seed = 0x2545F491;
+
+static uint32_t
+_rand(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+static void
+_rx(const hlo_ant_device_t *device, uint8_t *packet, uint32_t loss_pct)
+{
+	bool ack = true;
+	if (loss_pct && _rand() % 100 < loss_pct)
+		return;
+	if (_before)
+		_before_rx(packet);
+	else
+		_ant->on_rx_event(device, packet, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+}
+
+// one message of size bytes, distinct content every call so each is a new object
+static void
+_send(const hlo_ant_device_t *device, uint16_t size, uint32_t n, uint32_t loss_pct)
+{
+	static uint8_t msg[255 * 6];
+	uint8_t packet[8];
+	uint16_t crc, i, page, pages = (size + 5) / 6;
+	uint32_t crc_bytes = crc16_host_bytes;
+	int r;
+
+	for (i = 0; i < size; i++)
+		msg[i] = (uint8_t)(n * 131 + i);
+	crc = crc16_compute(msg, size, NULL);
+	crc16_host_bytes = crc_bytes;		// the sender's crc is not the receiver's work
+
+	packet[0] = 0;
+	packet[1] = pages;
+	packet[2] = packet[3] = 0;
+	packet[4] = size & 0xFF;
+	packet[5] = size >> 8;
+	packet[6] = crc & 0xFF;
+	packet[7] = crc >> 8;
+	for (r = 0; r < REPEATS; r++)
+		_rx(device, packet, loss_pct);
+	for (page = 1; page <= pages; page++) {
+		uint16_t off = (page - 1) * 6;
+		memset(packet, 0, sizeof(packet));
+		packet[0] = page;
+		packet[1] = pages;
+		memcpy(&packet[2], &msg[off], size - off < 6 ? size - off : 6);
+		for (r = 0; r < REPEATS; r++) {
+			if (page == _corrupt_page && !r) {
+				packet[2] ^= 0x10;
+				_rx(device, packet, loss_pct);
+				packet[2] ^= 0x10;
+				continue;
+			}
+			_rx(device, packet, loss_pct);
+		}
+	}
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+	hlo_ant_device_t pill = { .device_number = 0x1234, .device_type = HLO_ANT_DEVICE_TYPE_PILL };
+	uint32_t i, s, b, n = 0;
+	double start, elapsed;
+
+	_ant = hlo_ant_packet_init(&_listener);
+
+	// a bad copy of a page is replaced by a later good one
+	_corrupt_page = 3;
+	_send(&pill, 120, n++, 0);
+	CHECK(_delivered == 1);
+	_corrupt_page = 0;
+	// a header whose page count does not match its size is ignored, its pages too
+	{
+		uint8_t header[8] = { 0, 2, 0, 0, 30, 0, 0x55, 0xAA }, page[8] = { 2, 2, 1, 2, 3, 4, 5, 6 };
+		hlo_ant_packet_stats_t stats;
+		_rx(&pill, header, 0);
+		_rx(&pill, header, 0);
+		_rx(&pill, page, 0);
+		CHECK(_delivered == 1);
+		hlo_ant_packet_get_stats(&stats);
+		CHECK(stats.refused == 1);
+		// past 64 pages, as long as the heap has room
+		_send(&pill, 70 * 6, n++, 0);
+		CHECK(_delivered == 2);
+		// the largest page count, more than the host heap holds
+		_send(&pill, 255 * 6, n++, 0);
+		hlo_ant_packet_get_stats(&stats);
+		CHECK(_delivered == 2 && stats.refused == 2);
+	}
+	// a session nobody used has a zeroed header, a message whose crc is 0 is still new to it
+	{
+		hlo_ant_device_t other = { .device_number = 0x4321, .device_type = HLO_ANT_DEVICE_TYPE_PILL };
+		uint8_t msg[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, header[8] = { 0, 2, 0, 0, 12, 0, 0, 0 }, page[8];
+		uint32_t v;
+		for (v = 0; v < 0x10000 && crc16_compute(msg, sizeof(msg), NULL); v++) {
+			msg[10] = v & 0xFF;
+			msg[11] = v >> 8;
+		}
+		CHECK(!crc16_compute(msg, sizeof(msg), NULL));
+		_rx(&other, header, 0);
+		for (i = 0; i < 2; i++) {
+			page[0] = i + 1;
+			page[1] = 2;
+			memcpy(&page[2], &msg[i * 6], 6);
+			_rx(&other, page, 0);
+		}
+		CHECK(_delivered == 3);
+	}
+
+	printf("ant reassembly, pages repeated %u times\n", REPEATS);
+	for (s = 0; s < sizeof(_sizes) / sizeof(_sizes[0]); s++) {
+		printf("  %3u bytes, %2u pages:\n", _sizes[s], (_sizes[s] + 5) / 6);
+		for (b = 0; b < 2; b++) {
+			uint32_t crc_bytes;
+			_before = !b;
+			_delivered = 0;
+			crc_bytes = crc16_host_bytes;
+			start = _now();
+			for (i = 0; i < ROUNDS; i++)
+				_send(&pill, _sizes[s], n++, 0);
+			elapsed = _now() - start;
+			crc_bytes = crc16_host_bytes - crc_bytes;
+			if (_delivered != ROUNDS) {
+				printf("FAIL %u of %u messages of %u bytes delivered\n", _delivered, ROUNDS, _sizes[s]);
+				return 1;
+			}
+			printf("    %s %6u crc bytes, %7.2f us per message\n", b ? "after: " : "before:",
+					crc_bytes / ROUNDS, elapsed * 1e6 / ROUNDS);
+		}
+	}
+
+	// the same with 20% of packets lost on the air
+	for (s = 0; s < sizeof(_sizes) / sizeof(_sizes[0]); s++) {
+		uint32_t delivered[2], first = n;
+		for (b = 0; b < 2; b++) {
+			_before = !b;
+			_delivered = 0;
+			// both get the same messages and lose the same packets
+			_seed = 0x2545F491 + s;
+			for (i = 0, n = first; i < ROUNDS; i++)
+				_send(&pill, _sizes[s], n++, 20);
+			delivered[b] = _delivered;
+		}
+		// a page counts whatever copy of it made it, the same as before
+		CHECK(delivered[1] == delivered[0]);
+		printf("  %3u bytes, 20%% loss: %5.1f%% delivered before, %5.1f%% after\n", _sizes[s],
+				100.0 * delivered[0] / ROUNDS, 100.0 * delivered[1] / ROUNDS);
+	}
+	if (_old.obj)
+		MSG_Base_ReleaseDataAtomic(_old.obj);
+	return 0;
+}
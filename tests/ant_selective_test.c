@@ -0,0 +1,268 @@
+// vi:noet:sw=4 ts=4
+
+// Sends full duplex messages from a peripheral copy of ant/ant_packet.c to a
+// central copy over a lossy simulated channel, with and without
+// ANT_PACKET_SELECTIVE, and counts what goes on the air.
+// Build and run from the top level:
+//make host && ./build/host/ant_selective_test
+//
+// One channel period at a time the peripheral gets its tx event and sends one
+// acknowledged packet, the central echoes it back in the same period. A
+// central built without ANT_PACKET_SELECTIVE echoes the page and nothing
+// else, the lockstep runs clear the rest on the way back.
+//
+// Channel model: every packet and every echo is lost at random. A
+// retransmission is any page or header sent past the first copy of each,
+// counted against the messages that made it since lockstep gives up sooner.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ant_packet.h"
+#include "ant_packet_peer.h"
+#include "ant_devices.h"
+#include "crc16.h"
+
+#define MESSAGES 2000
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static hlo_ant_event_listener_t *_central, *_peripheral;
+static const hlo_ant_device_t _pill = { .device_number = 0x2002, .device_type = HLO_ANT_DEVICE_TYPE_PILL1_5 };
+static const hlo_ant_device_t _other = { .device_number = 0x3003, .device_type = HLO_ANT_DEVICE_TYPE_PILL1_5 };
+
+static uint8_t _msg[240];
+static uint16_t _size;
+static uint32_t _delivered, _bad, _sent, _failed;
+
+static void
+_on_message(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	if (message->len == _size && !memcmp(message->buf, _msg, _size))
+		_delivered++;
+	else
+		_bad++;
+}
+
+static MSG_Data_t *
+_on_connect(const hlo_ant_device_t *device)
+{
+	return NULL;
+}
+
+static void
+_on_sent(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	_sent++;
+}
+
+static void
+_on_failed(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	_failed++;
+}
+
+static const hlo_ant_packet_listener _listener = { _on_connect, _on_message, _on_sent, _on_failed };
+
+int32_t hlo_ant_connect(const hlo_ant_device_t *device, bool full_duplex)
+{
+	return 0;
+}
+
+static uint32_t _seed = 0x2545F491;
+static uint32_t _loss_pct;
+
+static bool
+_lost(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed % 100 < _loss_pct;
+}
+
+typedef struct {
+	uint32_t periods;
+	uint32_t packets;		// on air, echoes included
+	uint32_t retransmits;
+	uint32_t delivered;
+	uint32_t sent_lost;		// counted as sent by the peripheral, never delivered
+} link_t;
+
+// the central answers what it just got, legacy centrals echo the page only
+static void
+_echo(link_t *l, bool legacy)
+{
+	uint8_t echo[8] = { 0 };
+	bool ack = true;
+	if (!_central->on_tx_event(&_pill, echo, HLO_ANT_ROLE_CENTRAL, true))
+		return;
+	if (legacy)
+		memset(&echo[2], 0, 6);
+	l->packets++;
+	if (!_lost())
+		_peripheral->on_rx_event(&_pill, echo, sizeof(echo), HLO_ANT_ROLE_PERIPHERAL, &ack);
+}
+
+// one message from the peripheral until it is sent or failed
+static void
+_run(link_t *l, bool legacy)
+{
+	uint8_t buf[8], seen[64] = { 0 };
+	uint32_t done = _sent + _failed, delivered = _delivered;
+	MSG_Data_t *msg = MSG_Base_AllocateObjectAtomic(_msg, _size);
+
+	hlo_ant_packet_send_message_peer(&_pill, msg, true);
+	MSG_Base_ReleaseDataAtomic(msg);
+	while (_sent + _failed == done) {
+		bool ack = true;
+
+		l->periods++;
+		if (!_peripheral->on_tx_event(&_pill, buf, HLO_ANT_ROLE_PERIPHERAL, true))
+			continue;
+		l->packets++;
+		if (seen[buf[0]]++)
+			l->retransmits++;
+		if (_lost())
+			continue;
+		_central->on_rx_event(&_pill, buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+		if (ack)
+			_echo(l, legacy);
+	}
+	l->delivered += _delivered - delivered;
+	if (_sent > done && _delivered == delivered)
+		l->sent_lost++;
+}
+
+// a header from another device lands between delivery and the central's
+// final report, the report still has to reach the peripheral
+static int
+_handover(void)
+{
+	uint8_t buf[8], header[8] = { 0, 2, 0, 0, 12, 0, 0x34, 0x12 };
+	uint32_t sent = _sent, failed = _failed, delivered = _delivered;
+	MSG_Data_t *msg;
+	hlo_ant_packet_stats_t stats;
+	bool ack = true;
+	uint32_t i;
+
+	_size = 30;
+	for (i = 0; i < _size; i++)
+		_msg[i] = (uint8_t)(i * 11);
+	msg = MSG_Base_AllocateObjectAtomic(_msg, _size);
+	hlo_ant_packet_send_message_peer(&_pill, msg, true);
+	MSG_Base_ReleaseDataAtomic(msg);
+	for (i = 0; i < 64 && _delivered == delivered; i++) {
+		CHECK(_peripheral->on_tx_event(&_pill, buf, HLO_ANT_ROLE_PERIPHERAL, true));
+		_central->on_rx_event(&_pill, buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+		if (_delivered == delivered)
+			_echo(&(link_t){ 0 }, false);
+	}
+	CHECK(_delivered == delivered + 1);
+	_central->on_rx_event(&_other, header, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+	hlo_ant_packet_get_stats(&stats);
+	CHECK(!stats.evictions && !stats.full);
+	for (i = 0; i < 64 && _sent + _failed == sent + failed; i++) {
+		_echo(&(link_t){ 0 }, false);
+		if (_peripheral->on_tx_event(&_pill, buf, HLO_ANT_ROLE_PERIPHERAL, true))
+			_central->on_rx_event(&_pill, buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+	}
+	CHECK(_sent == sent + 1 && _failed == failed && !_bad);
+	return 0;
+}
+
+// a pill broadcasts unless it asks for the echo, then it is only sent once
+// the central has echoed every page, and failed with nobody listening
+static int
+_pill_ack(void)
+{
+	static const hlo_ant_device_t pill = { .device_number = 0x4004, .device_type = HLO_ANT_DEVICE_TYPE_PILL };
+	uint8_t buf[8], echo[8];
+	uint32_t sent, failed, delivered, i;
+	bool reliable, ack;
+	MSG_Data_t *msg;
+
+	_size = 30;
+	for (reliable = false; ; reliable = true) {
+		for (i = 0; i < _size; i++)
+			_msg[i] = (uint8_t)(i * 7 + reliable);
+		sent = _sent, failed = _failed, delivered = _delivered;
+		msg = MSG_Base_AllocateObjectAtomic(_msg, _size);
+		hlo_ant_packet_send_message_peer(&pill, msg, reliable);
+		MSG_Base_ReleaseDataAtomic(msg);
+		for (i = 0; i < 256 && _sent + _failed == sent + failed; i++) {
+			if (!_peripheral->on_tx_event(&pill, buf, HLO_ANT_ROLE_PERIPHERAL, reliable))
+				continue;
+			ack = true;
+			_central->on_rx_event(&pill, buf, 8, HLO_ANT_ROLE_CENTRAL, &ack);
+			CHECK(ack == reliable);
+			if (reliable && _sent == sent) {
+				CHECK(_central->on_tx_event(&pill, echo, HLO_ANT_ROLE_CENTRAL, true));
+				_peripheral->on_rx_event(&pill, echo, sizeof(echo), HLO_ANT_ROLE_PERIPHERAL, &ack);
+			}
+			// sent only after the central has it all
+			CHECK(_sent == sent || _delivered == delivered + 1);
+		}
+		CHECK(_sent == sent + 1 && _failed == failed && _delivered == delivered + 1);
+		if (reliable)
+			break;
+	}
+
+	// nobody echoes, a full duplex send fails where a broadcast would call it sent
+	msg = MSG_Base_AllocateObjectAtomic(_msg, _size);
+	hlo_ant_packet_send_message_peer(&pill, msg, true);
+	MSG_Base_ReleaseDataAtomic(msg);
+	for (i = 0; i < 256 && _sent + _failed == sent + failed + 1; i++)
+		_peripheral->on_tx_event(&pill, buf, HLO_ANT_ROLE_PERIPHERAL, true);
+	CHECK(_sent == sent + 1 && _failed == failed + 1 && !_bad);
+	return 0;
+}
+
+int main()
+{
+	static const uint16_t sizes[] = { 30, 120, 240 };
+	static const uint32_t losses[] = { 0, 10, 20, 30 };
+	uint32_t s, p, i, n = 0;
+
+	_central = hlo_ant_packet_init(&_listener);
+	_peripheral = hlo_ant_packet_init_peer(&_listener);
+	if (_handover() || _pill_ack())
+		return 1;
+
+	printf("ant selective retransmission, full duplex, %u messages per run\n", MESSAGES);
+	for (p = 0; p < sizeof(losses) / sizeof(losses[0]); p++) {
+		_loss_pct = losses[p];
+		for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			link_t runs[2];
+			uint32_t r;
+			memset(runs, 0, sizeof(runs));
+			_size = sizes[s];
+			for (r = 0; r < 2; r++) {
+				for (i = 0; i < MESSAGES; i++) {
+					uint32_t b;
+					for (b = 0; b < _size; b++)
+						_msg[b] = (uint8_t)(++n * 37 + b);
+					_run(&runs[r], !r);
+				}
+				CHECK(!_bad);
+				// the peripheral only calls a message sent once the central has it
+				CHECK(!runs[r].sent_lost);
+			}
+			if (!_loss_pct)
+				CHECK(runs[0].delivered == MESSAGES && runs[1].delivered == MESSAGES
+						&& !runs[0].retransmits && !runs[1].retransmits);
+			else	// lockstep gives up sooner, compare per message that made it
+				CHECK(runs[1].delivered >= runs[0].delivered
+						&& (uint64_t)runs[1].retransmits * runs[0].delivered
+						< (uint64_t)runs[0].retransmits * runs[1].delivered);
+			printf("  %3u bytes, %2u%% loss:\n", _size, _loss_pct);
+			for (r = 0; r < 2; r++)
+				printf("    %s %5.1f periods, %5.1f packets, %5.1f retransmissions per delivered message, %5.1f%% delivered\n",
+						r ? "selective:" : "lockstep: ", (double)runs[r].periods / MESSAGES,
+						(double)runs[r].packets / MESSAGES, (double)runs[r].retransmits / runs[r].delivered,
+						100.0 * runs[r].delivered / MESSAGES);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,305 @@
+// vi:noet:sw=4 ts=4
+
+// Interleaves the packets of 50 pills into the central side of ant/ant_packet.c
+// and reports how many messages get through the session table, before (the
+// baseline's linear table, rebuilt below) and after (hash and lru list).
+// Build and run from the top level:
+//make host && ./build/host/ant_session_stress
+//
+// Every pill sends 30 byte messages, the header and each page 4 times like the
+// pill does outside lockstep. A fixed number of pills are on the air at once,
+// each packet comes from one of them at random, and a pill that finished its
+// message hands over to one that was quiet. The session table is sized by
+// tests/host/message_config.h like morpheus, for both. Both runs see the same
+// packets in the same order.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ant_packet.h"
+#include "ant_devices.h"
+#include "crc16.h"
+
+#define PILLS 50
+#define MESSAGE_SIZE 30
+#define PAGES ((MESSAGE_SIZE + 5) / 6)
+#define REPEATS 4
+#define PACKETS ((PAGES + 1) * REPEATS)
+#define MESSAGES 100000
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+typedef struct {
+	hlo_ant_device_t device;
+	uint32_t n;				// messages started
+	uint32_t delivered;
+	uint8_t pos;			// next packet of the current message
+	uint8_t active;
+	uint8_t msg[MESSAGE_SIZE];
+	uint16_t crc;
+} pill_t;
+
+static pill_t _pills[PILLS];
+static hlo_ant_event_listener_t *_ant;
+static uint32_t _bad, _run;
+static bool _before;		// packets go to _before_rx instead
+
+// the baseline's sessions: up to four passes over the table per packet, a
+// session with a message under way is only taken over once OLD_AGE_LIMIT
+// packets came in since its last one, every page copy crcs the whole message
+#define OLD_AGE_LIMIT 4
+static struct {
+	uint16_t cid;
+	uint8_t page_count;
+	uint16_t checksum;
+	MSG_Data_t *obj;
+	uint32_t age;
+} _old[ANT_PACKET_MAX_CONCURRENT_SESSIONS];
+static uint32_t _old_age, _old_evictions, _old_dropped;
+
+static void
+_on_message(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+	pill_t *p = &_pills[device->device_number - 0x100];
+	if (message->len != MESSAGE_SIZE || memcmp(message->buf, p->msg, MESSAGE_SIZE))
+		_bad++;
+	else
+		p->delivered++;
+}
+
+static int
+_old_acquire(uint16_t cid)
+{
+	int i;
+	++_old_age;
+	for (i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++)
+		if (_old[i].cid == cid) {
+			_old[i].age = _old_age;
+			return i;
+		}
+	for (i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++)
+		if (_old[i].cid == 0) {
+			_old[i].cid = cid;
+			_old[i].age = _old_age;
+			return i;
+		}
+	for (i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++)
+		if (!_old[i].obj) {
+			_old_evictions++;
+			_old[i].cid = cid;
+			_old[i].age = _old_age;
+			return i;
+		}
+	for (i = 0; i < ANT_PACKET_MAX_CONCURRENT_SESSIONS; i++)
+		if (_old_age - _old[i].age >= OLD_AGE_LIMIT) {
+			_old_evictions++;
+			_old_dropped++;
+			MSG_Base_ReleaseDataAtomic(_old[i].obj);
+			_old[i].obj = NULL;
+			_old[i].cid = cid;
+			_old[i].age = _old_age;
+			return i;
+		}
+	return -1;
+}
+
+static void _on_message(const hlo_ant_device_t *device, MSG_Data_t *message);
+
+static void
+_before_rx(const hlo_ant_device_t *device, const uint8_t *packet)
+{
+	uint16_t crc = (uint16_t)(packet[7] << 8) | packet[6], size, off, i;
+	int s = _old_acquire(device->device_number);
+
+	if (s < 0)
+		return;
+	if (packet[0] == 0 && packet[1] > 0) {
+		size = (uint16_t)(packet[5] << 8) | packet[4];
+		if (crc != _old[s].checksum) {
+			_old[s].page_count = packet[1];
+			_old[s].checksum = crc;
+			if (size <= MSG_Base_FreeCount() && size != 0) {
+				if (_old[s].obj)
+					MSG_Base_ReleaseDataAtomic(_old[s].obj);
+				_old[s].obj = MSG_Base_AllocateDataAtomic(size);
+			}
+		}
+	} else if (_old[s].obj && packet[0] && packet[1] && packet[0] <= _old[s].page_count) {
+		MSG_Data_t *obj = _old[s].obj;
+		off = (packet[0] - 1) * 6;
+		for (i = 0; i < 6 && off + i < obj->len; i++)
+			obj->buf[off + i] = packet[2 + i];
+		if (crc16_compute(obj->buf, obj->len, NULL) == _old[s].checksum) {
+			_on_message(device, obj);
+			MSG_Base_ReleaseDataAtomic(obj);
+			_old[s].obj = NULL;
+		}
+	}
+}
+
+static MSG_Data_t *
+_on_connect(const hlo_ant_device_t *device)
+{
+	return NULL;
+}
+
+static void
+_on_done(const hlo_ant_device_t *device, MSG_Data_t *message)
+{
+}
+
+static const hlo_ant_packet_listener _listener = { _on_connect, _on_message, _on_done, _on_done };
+
+int32_t hlo_ant_connect(const hlo_ant_device_t *device, bool full_duplex)
+{
+	return 0;
+}
+
+static uint32_t _seed = 0x2545F491;
+
+static uint32_t
+_rand(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+static void
+_start(pill_t *p)
+{
+	// distinct for every run, pill and message, like the pill's nonce makes them
+	uint32_t i, x = (_run << 24) ^ (p->device.device_number << 12) ^ ++p->n;
+	uint16_t last = p->crc;
+	do {
+		for (i = 0; i < MESSAGE_SIZE; i++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			p->msg[i] = (uint8_t)x;
+		}
+		p->crc = crc16_compute(p->msg, MESSAGE_SIZE, NULL);
+	} while (p->crc == last);	// taken for a copy of the last message otherwise
+	p->pos = 0;
+	p->active = 1;
+}
+
+// the next packet of p's message, true when it was the last
+static bool
+_next_packet(pill_t *p)
+{
+	uint8_t packet[8] = { 0 };
+	uint8_t page = p->pos / REPEATS;
+	bool ack = true;
+
+	if (!page) {
+		packet[1] = PAGES;
+		packet[4] = MESSAGE_SIZE;
+		packet[6] = p->crc & 0xFF;
+		packet[7] = p->crc >> 8;
+	} else {
+		uint16_t off = (page - 1) * 6;
+		packet[0] = page;
+		packet[1] = PAGES;
+		memcpy(&packet[2], &p->msg[off], MESSAGE_SIZE - off < 6 ? MESSAGE_SIZE - off : 6);
+	}
+	if (_before)
+		_before_rx(&p->device, packet);
+	else
+		_ant->on_rx_event(&p->device, packet, sizeof(packet), HLO_ANT_ROLE_CENTRAL, &ack);
+	return ++p->pos == PACKETS;
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+	static const uint32_t concurrency[] = { 2, 8, 16, 24, 50 };
+	uint32_t c, i;
+
+	_ant = hlo_ant_packet_init(&_listener);
+	for (i = 0; i < PILLS; i++) {
+		_pills[i].device.device_number = 0x100 + i;
+		_pills[i].device.device_type = HLO_ANT_DEVICE_TYPE_PILL;
+	}
+
+	printf("ant sessions: %u pills, %u session table, %u packets per message\n", PILLS,
+			ANT_PACKET_MAX_CONCURRENT_SESSIONS, PACKETS);
+	for (c = 0; c < sizeof(concurrency) / sizeof(concurrency[0]); c++) {
+		uint32_t b;
+		for (b = 0; b < 2; b++) {
+			hlo_ant_packet_stats_t before, after;
+			uint32_t active[PILLS], sent = 0, delivered = 0, evictions, dropped;
+			double start, elapsed;
+
+			_before = !b;
+			_run++;
+			_seed = 0x2545F491 + c;
+			for (i = 0; i < PILLS; i++) {
+				_pills[i].active = 0;
+				_pills[i].n = 0;
+				_pills[i].delivered = 0;
+			}
+			for (i = 0; i < concurrency[c]; i++) {
+				active[i] = i;
+				_start(&_pills[i]);
+			}
+			hlo_ant_packet_get_stats(&before);
+			_bad = 0;
+			evictions = _old_evictions;
+			dropped = _old_dropped;
+			start = _now();
+			while (sent < MESSAGES) {
+				uint32_t slot = _rand() % concurrency[c];
+				pill_t *p = &_pills[active[slot]];
+				if (_next_packet(p)) {
+					uint32_t next;
+					sent++;
+					p->active = 0;
+					// hand over to a pill that is not on the air
+					if (concurrency[c] == PILLS)
+						next = active[slot];
+					else
+						do
+							next = _rand() % PILLS;
+						while (_pills[next].active);
+					active[slot] = next;
+					_start(&_pills[next]);
+				}
+			}
+			// let the ones on the air finish
+			for (i = 0; i < concurrency[c]; i++, sent++)
+				while (!_next_packet(&_pills[active[i]]))
+					;
+			elapsed = _now() - start;
+			hlo_ant_packet_get_stats(&after);
+			if (b) {
+				evictions = after.evictions - before.evictions;
+				dropped = after.dropped - before.dropped;
+			} else {
+				evictions = _old_evictions - evictions;
+				dropped = _old_dropped - dropped;
+			}
+			for (i = 0; i < PILLS; i++)
+				delivered += _pills[i].delivered;
+			// the baseline checks the crc with pages missing, now and then it matches
+			CHECK(!b || !_bad);
+			printf("  %2u on air, %s %5.1f%% delivered, %8.0f messages/s, %6u evictions, %6u unfinished dropped, %3u corrupt\n",
+					concurrency[c], b ? "after: " : "before:", 100.0 * delivered / sent, delivered / elapsed,
+					evictions, dropped, _bad);
+			// as long as the table covers the pills on the air nothing is lost
+			if (b && concurrency[c] <= ANT_PACKET_MAX_CONCURRENT_SESSIONS)
+				CHECK(delivered == sent && !dropped);
+		}
+	}
+	return 0;
+}
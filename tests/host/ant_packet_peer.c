@@ -0,0 +1,9 @@
+// vi:noet:sw=4 ts=4
+// second copy of ant/ant_packet.c with its own sessions, the public functions
+// get a _peer suffix so both copies link into one test
+
+#define hlo_ant_packet_init hlo_ant_packet_init_peer
+#define hlo_ant_packet_send_message hlo_ant_packet_send_message_peer
+#define hlo_ant_packet_get_stats hlo_ant_packet_get_stats_peer
+
+#include "../../ant/ant_packet.c"
@@ -0,0 +1,11 @@
+// vi:noet:sw=4 ts=4
+// second copy of ant/ant_packet.c for host tests that run both ends of a link,
+// see tests/host/ant_packet_peer.c
+
+#pragma once
+
+#include "ant_packet.h"
+
+hlo_ant_event_listener_t * hlo_ant_packet_init_peer(const hlo_ant_packet_listener * user_listener);
+int hlo_ant_packet_send_message_peer(const hlo_ant_device_t * device, MSG_Data_t * msg, bool full_duplex);
+void hlo_ant_packet_get_stats_peer(hlo_ant_packet_stats_t * out_stats);
@@ -0,0 +1,4 @@
+// vi:noet:sw=4 ts=4
+// host stub of the per-app app.h
+
+#pragma once
@@ -0,0 +1,16 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_error.h, see tests/host/host_stubs.c
+
+#pragma once
+
+#include <stdint.h>
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name);
+
+#define APP_ERROR_CHECK(ERR_CODE) \
+	do { \
+		const uint32_t LOCAL_ERR_CODE = (ERR_CODE); \
+		if (LOCAL_ERR_CODE != 0) { \
+			app_error_handler(LOCAL_ERR_CODE, __LINE__, (uint8_t*)__FILE__); \
+		} \
+	} while (0)
@@ -0,0 +1,49 @@
+// vi:noet:sw=4 ts=4
+// host implementation of the nRF51 SDK byte fifo, same semantics and error codes
+
+#include <stddef.h>
+
+#include "app_fifo.h"
+#include "nrf_soc.h"
+
+static uint32_t _length(const app_fifo_t * p_fifo)
+{
+	return p_fifo->write_pos - p_fifo->read_pos;
+}
+
+uint32_t app_fifo_init(app_fifo_t * p_fifo, uint8_t * p_buf, uint16_t buf_size)
+{
+	if (p_buf == NULL)
+		return NRF_ERROR_NULL;
+	if (!buf_size || (buf_size & (buf_size - 1)))
+		return NRF_ERROR_INVALID_LENGTH;
+	p_fifo->p_buf = p_buf;
+	p_fifo->buf_size_mask = buf_size - 1;
+	p_fifo->read_pos = 0;
+	p_fifo->write_pos = 0;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_fifo_put(app_fifo_t * p_fifo, uint8_t byte)
+{
+	if (_length(p_fifo) > p_fifo->buf_size_mask)
+		return NRF_ERROR_NO_MEM;
+	p_fifo->p_buf[p_fifo->write_pos & p_fifo->buf_size_mask] = byte;
+	p_fifo->write_pos++;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_fifo_get(app_fifo_t * p_fifo, uint8_t * p_byte)
+{
+	if (!_length(p_fifo))
+		return NRF_ERROR_NOT_FOUND;
+	*p_byte = p_fifo->p_buf[p_fifo->read_pos & p_fifo->buf_size_mask];
+	p_fifo->read_pos++;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_fifo_flush(app_fifo_t * p_fifo)
+{
+	p_fifo->read_pos = p_fifo->write_pos;
+	return NRF_SUCCESS;
+}
@@ -0,0 +1,18 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_fifo.h, see tests/host/app_fifo.c
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+	uint8_t * p_buf;
+	uint16_t buf_size_mask;
+	volatile uint32_t read_pos;
+	volatile uint32_t write_pos;
+} app_fifo_t;
+
+uint32_t app_fifo_init(app_fifo_t * p_fifo, uint8_t * p_buf, uint16_t buf_size);
+uint32_t app_fifo_put(app_fifo_t * p_fifo, uint8_t byte);
+uint32_t app_fifo_get(app_fifo_t * p_fifo, uint8_t * p_byte);
+uint32_t app_fifo_flush(app_fifo_t * p_fifo);
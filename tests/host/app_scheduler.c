@@ -0,0 +1,70 @@
+// vi:noet:sw=4 ts=4
+// host implementation of the nRF51 SDK scheduler, single threaded
+
+#include <string.h>
+
+#include "app_scheduler.h"
+#include "nrf_soc.h"
+
+typedef struct {
+	app_sched_event_handler_t handler;
+	uint16_t size;
+	uint8_t data[APP_SCHED_HOST_MAX_EVENT_SIZE];
+} event_t;
+
+static struct {
+	event_t queue[APP_SCHED_HOST_MAX_QUEUE_SIZE];
+	uint16_t max_event_size;
+	uint16_t queue_size;
+	uint16_t head;
+	uint16_t count;
+	uint16_t high_water;
+} self = { .max_event_size = APP_SCHED_HOST_MAX_EVENT_SIZE, .queue_size = 16 };
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void * p_evt_buffer)
+{
+	if (max_event_size > APP_SCHED_HOST_MAX_EVENT_SIZE || !queue_size || queue_size > APP_SCHED_HOST_MAX_QUEUE_SIZE)
+		return NRF_ERROR_INVALID_PARAM;
+	memset(&self, 0, sizeof(self));
+	self.max_event_size = max_event_size;
+	self.queue_size = queue_size;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+	event_t * evt;
+	if (event_size > self.max_event_size)
+		return NRF_ERROR_INVALID_LENGTH;
+	if (self.count >= self.queue_size)
+		return NRF_ERROR_NO_MEM;
+	evt = &self.queue[(self.head + self.count) % self.queue_size];
+	evt->handler = handler;
+	evt->size = event_size;
+	if (p_event_data && event_size)
+		memcpy(evt->data, p_event_data, event_size);
+	self.count++;
+	if (self.count > self.high_water)
+		self.high_water = self.count;
+	return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+	while (self.count) {
+		event_t evt = self.queue[self.head];
+		self.head = (self.head + 1) % self.queue_size;
+		self.count--;
+		evt.handler(evt.size ? evt.data : NULL, evt.size);
+	}
+}
+
+uint16_t app_sched_host_pending(void)
+{
+	return self.count;
+}
+
+uint16_t app_sched_host_high_water(void)
+{
+	return self.high_water;
+}
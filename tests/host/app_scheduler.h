@@ -0,0 +1,24 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_scheduler.h, see tests/host/app_scheduler.c
+// events are copied into a fixed queue like on the target, app_sched_execute drains it
+
+#pragma once
+
+#include <stdint.h>
+#include "app_error.h"
+
+#define APP_SCHED_HOST_MAX_EVENT_SIZE	32
+#define APP_SCHED_HOST_MAX_QUEUE_SIZE	64
+
+typedef void (*app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+#define APP_SCHED_INIT(EVENT_SIZE, QUEUE_SIZE) \
+	APP_ERROR_CHECK(app_sched_init((EVENT_SIZE), (QUEUE_SIZE), NULL))
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void * p_evt_buffer);
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void app_sched_execute(void);
+
+// host only, number of events waiting and the deepest the queue has been
+uint16_t app_sched_host_pending(void);
+uint16_t app_sched_host_high_water(void);
@@ -0,0 +1,131 @@
+// vi:noet:sw=4 ts=4
+// host implementation of the app_timer tick counter and timers
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "app_timer.h"
+#include "nrf_soc.h"
+
+#define MAX_RTC_COUNTER_VAL 0x00FFFFFF
+
+typedef struct {
+	app_timer_timeout_handler_t handler;
+	app_timer_mode_t mode;
+	bool running;
+	uint64_t deadline;
+	uint32_t period;
+	void * context;
+} timer_t_;
+
+static struct {
+	timer_t_ timers[APP_TIMER_HOST_MAX_TIMERS];
+	uint8_t count;
+	bool manual;
+	uint64_t now;
+	uint32_t wakeups;
+	uint32_t starts;
+	uint32_t fail_starts;
+} self;
+
+static uint64_t _now(void)
+{
+	struct timespec ts;
+	if (self.manual)
+		return self.now;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * APP_TIMER_CLOCK_FREQ + ((uint64_t)ts.tv_nsec * APP_TIMER_CLOCK_FREQ) / 1000000000ull;
+}
+
+uint32_t app_timer_create(app_timer_id_t * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+	if (!timeout_handler)
+		return NRF_ERROR_INVALID_PARAM;
+	if (self.count >= APP_TIMER_HOST_MAX_TIMERS)
+		return NRF_ERROR_NO_MEM;
+	self.timers[self.count] = (timer_t_){ .handler = timeout_handler, .mode = mode };
+	*p_timer_id = self.count++;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+	timer_t_ * t;
+	if (timer_id >= self.count || timeout_ticks < 5 || timeout_ticks > MAX_RTC_COUNTER_VAL)
+		return NRF_ERROR_INVALID_PARAM;
+	if (self.fail_starts) {
+		self.fail_starts--;
+		return NRF_ERROR_NO_MEM;
+	}
+	self.starts++;
+	t = &self.timers[timer_id];
+	t->running = true;
+	t->deadline = _now() + timeout_ticks;
+	t->period = timeout_ticks;
+	t->context = p_context;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+	if (timer_id >= self.count)
+		return NRF_ERROR_INVALID_PARAM;
+	self.timers[timer_id].running = false;
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+	*p_ticks = (uint32_t)(_now() & MAX_RTC_COUNTER_VAL);
+	return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+	*p_ticks_diff = (ticks_to - ticks_from) & MAX_RTC_COUNTER_VAL;
+	return NRF_SUCCESS;
+}
+
+void app_timer_host_advance(uint32_t ticks)
+{
+	uint64_t target;
+	if (!self.manual) {
+		self.now = _now();
+		self.manual = true;
+	}
+	target = self.now + ticks;
+	for (;;) {
+		timer_t_ * next = NULL;
+		uint8_t i;
+		for (i = 0; i < self.count; i++) {
+			timer_t_ * t = &self.timers[i];
+			if (t->running && t->deadline <= target && (!next || t->deadline < next->deadline))
+				next = t;
+		}
+		if (!next)
+			break;
+		self.now = next->deadline;
+		if (next->mode == APP_TIMER_MODE_REPEATED)
+			next->deadline += next->period;
+		else
+			next->running = false;
+		self.wakeups++;
+		next->handler(next->context);
+	}
+	self.now = target;
+}
+
+uint32_t app_timer_host_wakeups(void)
+{
+	return self.wakeups;
+}
+
+uint32_t app_timer_host_starts(void)
+{
+	return self.starts;
+}
+
+void app_timer_host_fail_starts(uint32_t count)
+{
+	self.fail_starts = count;
+}
@@ -0,0 +1,39 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_timer.h, see tests/host/app_timer.c
+// the tick counter follows the host monotonic clock at the rtc rate, 24 bits wide,
+// until app_timer_host_advance switches it to a manual clock that also fires the timers
+
+#pragma once
+
+#include <stdint.h>
+#include "app_scheduler.h"
+
+#define APP_TIMER_CLOCK_FREQ	32768
+#define APP_TIMER_PRESCALER		0
+#define APP_TIMER_TICKS(MS, PRESCALER) \
+	((uint32_t)(((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ) / (((PRESCALER) + 1) * 1000)))
+
+#define APP_TIMER_HOST_MAX_TIMERS	8
+
+typedef uint32_t app_timer_id_t;
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+typedef enum {
+	APP_TIMER_MODE_SINGLE_SHOT,
+	APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+uint32_t app_timer_create(app_timer_id_t * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(uint32_t * p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff);
+
+// host only, moves the manual clock forward, calling the handler of every timer that expires on the way
+void app_timer_host_advance(uint32_t ticks);
+// host only, number of timeouts delivered so far, i.e. rtc compare wakeups on the target
+uint32_t app_timer_host_wakeups(void);
+// host only, successful app_timer_start calls so far, each one is an op queue entry on the target
+uint32_t app_timer_host_starts(void);
+// host only, the next count app_timer_start calls fail with NRF_ERROR_NO_MEM like a full op queue
+void app_timer_host_fail_starts(uint32_t count);
@@ -0,0 +1,16 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_uart.h
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+	uint8_t rx_pin_no;
+	uint8_t tx_pin_no;
+	uint8_t rts_pin_no;
+	uint8_t cts_pin_no;
+	uint8_t flow_control;
+	uint8_t use_parity;
+	uint32_t baud_rate;
+} app_uart_comm_params_t;
@@ -0,0 +1,20 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK app_util.h, host builds are single threaded
+// unless built with HOST_THREADED, which maps the critical region onto a
+// recursive lock the harness provides and gives it a preemption point to
+// hang barriers on
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef HOST_THREADED
+void host_critical_enter(void);
+void host_critical_exit(void);
+void host_preempt_point(void);
+#define CRITICAL_REGION_ENTER() { host_critical_enter();
+#define CRITICAL_REGION_EXIT() host_critical_exit(); }
+#else
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
+#endif
@@ -0,0 +1,4 @@
+// vi:noet:sw=4 ts=4
+// host stub, nothing from the bond manager is needed on the host
+
+#pragma once
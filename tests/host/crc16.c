@@ -0,0 +1,23 @@
+// vi:noet:sw=4 ts=4
+// host copy of the nRF51 SDK crc16_compute, CRC-16-CCITT starting at 0xFFFF
+
+#include <stddef.h>
+#include "crc16.h"
+
+uint32_t crc16_host_bytes;
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc)
+{
+	uint32_t i;
+	uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+	crc16_host_bytes += size;
+	for (i = 0; i < size; i++) {
+		crc = (uint8_t)(crc >> 8) | (crc << 8);
+		crc ^= p_data[i];
+		crc ^= (uint8_t)(crc & 0xFF) >> 4;
+		crc ^= (crc << 8) << 4;
+		crc ^= ((crc & 0xFF) << 4) << 1;
+	}
+	return crc;
+}
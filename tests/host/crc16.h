@@ -0,0 +1,11 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK crc16.h, see tests/host/crc16.c
+
+#pragma once
+
+#include <stdint.h>
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc);
+
+// bytes run through crc16_compute so far, for benches that count crc work
+extern uint32_t crc16_host_bytes;
@@ -0,0 +1,91 @@
+// vi:noet:sw=4 ts=4
+// host implementations of the uart print and error hooks used by common/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "message_uart.h"
+#include "app_error.h"
+#include "nrf_soc.h"
+
+const uint8_t hex[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+
+NRF_FICR_Type nrf_ficr_host = { .DEVICEID = { 0x89ABCDEF, 0x01234567 } };
+
+// set by harnesses whose stdout is compared against golden output, drops the firmware's prints
+int host_uart_quiet;
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+	fprintf(stderr, "app error 0x%x at %s:%u\n", error_code, p_file_name, line_num);
+	abort();
+}
+
+void MSG_Uart_Prints(const char * str)
+{
+	if (host_uart_quiet)
+		return;
+	fputs(str, stdout);
+}
+
+void MSG_Uart_Printc(char c)
+{
+	if (host_uart_quiet)
+		return;
+	putchar(c);
+}
+
+void MSG_Uart_PrintDec(const int * ptr)
+{
+	if (host_uart_quiet)
+		return;
+	printf("%d", *ptr);
+}
+
+void MSG_Uart_PrintHex(const uint8_t * ptr, uint32_t len)
+{
+	if (host_uart_quiet)
+		return;
+	while (len-- > 0)
+		printf("%02X", *ptr++);
+}
+
+void MSG_Uart_PrintByte(const uint8_t * ptr, uint32_t len)
+{
+	if (host_uart_quiet)
+		return;
+	fwrite(ptr, 1, len, stdout);
+}
+
+void MSG_Uart_Printf(char * fmt, ...)
+{
+	va_list args;
+	if (host_uart_quiet)
+		return;
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+}
+
+void simple_uart_put(uint8_t cr)
+{
+	putchar(cr);
+}
+
+void simple_uart_putstring(const uint8_t * str)
+{
+	fputs((const char *)str, stdout);
+}
+
+uint32_t sd_rand_application_bytes_available_get(uint8_t * p_bytes_available)
+{
+	*p_bytes_available = 0;
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_rand_application_vector_get(uint8_t * p_buff, uint8_t length)
+{
+	return NRF_ERROR_NOT_FOUND;
+}
@@ -0,0 +1,21 @@
+// vi:noet:sw=4 ts=4
+// host message_config.h, mirrors morpheus/message_config.h except for the
+// pool, which is on here so the tests cover it, sized from the in flight
+// means message_pool_bench prints
+// build with -DHOST_NO_MSG_POOL to compare against the plain heap
+
+#pragma once
+
+#include "platform.h"
+
+#if !defined(HOST_NO_MSG_POOL) && !defined(MSG_BASE_POOL_CLASS_SIZES)
+#define MSG_BASE_POOL_CLASS_SIZES  {16, 24, 40}
+#define MSG_BASE_POOL_CLASS_COUNTS {1, 1, 2}
+#endif
+
+#define MSG_CENTRAL_MODULE_NUM  (MOD_END)
+
+// morpheus session table, build with -DANT_PACKET_MAX_CONCURRENT_SESSIONS=2 for the pill's
+#ifndef ANT_PACKET_MAX_CONCURRENT_SESSIONS
+#define ANT_PACKET_MAX_CONCURRENT_SESSIONS 16
+#endif
@@ -0,0 +1,74 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK nrf51.h, only the SPI master block and the device id are modelled
+// the peripherals are plain memory, nrf_spi_host_step in nrf_spi.c plays the bus
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+	SPI0_TWI0_IRQn = 3,
+	SPI1_TWI1_IRQn = 4,
+} IRQn_Type;
+
+typedef struct {
+	volatile uint32_t EVENTS_READY;
+	volatile uint32_t INTEN;
+	volatile uint32_t INTENSET;
+	volatile uint32_t INTENCLR;
+	volatile uint32_t ENABLE;
+	volatile uint32_t PSELSCK;
+	volatile uint32_t PSELMOSI;
+	volatile uint32_t PSELMISO;
+	volatile uint32_t RXD;
+	volatile uint32_t TXD;
+	volatile uint32_t FREQUENCY;
+	volatile uint32_t CONFIG;
+} NRF_SPI_Type;
+
+typedef struct {
+	volatile uint32_t DEVICEID[2];
+} NRF_FICR_Type;
+
+extern NRF_SPI_Type nrf_spi_host[2];
+extern NRF_FICR_Type nrf_ficr_host;	// in host_stubs.c
+#define NRF_FICR (&nrf_ficr_host)
+#define NRF_SPI0 (&nrf_spi_host[0])
+#define NRF_SPI1 (&nrf_spi_host[1])
+
+#define SPI_INTENSET_READY_Msk (1UL << 2)
+#define SPI_INTENCLR_READY_Msk (1UL << 2)
+
+#define SPI_ENABLE_ENABLE_Pos 0
+#define SPI_ENABLE_ENABLE_Disabled 0
+#define SPI_ENABLE_ENABLE_Enabled 1
+
+#define SPI_CONFIG_ORDER_Pos 0
+#define SPI_CONFIG_ORDER_MsbFirst 0
+#define SPI_CONFIG_CPHA_Pos 1
+#define SPI_CONFIG_CPHA_Leading 0
+#define SPI_CONFIG_CPHA_Trailing 1
+#define SPI_CONFIG_CPOL_Pos 2
+#define SPI_CONFIG_CPOL_ActiveHigh 0
+#define SPI_CONFIG_CPOL_ActiveLow 1
+
+// the device on the other end, returns the MISO byte for a MOSI byte while cs is low
+// first is set on the first byte after cs was released
+typedef uint8_t (*nrf_spi_host_device_t)(uint8_t mosi, int first);
+
+// TXD writes go through here, the mock keeps the chip's double buffer: the byte in the
+// shift register plus one waiting, a third write before a byte is clocked is an overrun
+void nrf_spi_host_txd(NRF_SPI_Type *spi, uint8_t byte);
+#define SPI_TXD_WRITE(spi, byte) nrf_spi_host_txd((spi), (byte))
+
+void nrf_spi_host_attach(NRF_SPI_Type *spi, uint8_t cs_pin, nrf_spi_host_device_t device);
+
+// clocks out the oldest byte written to TXD, raises READY and runs the vector if INTENSET asks for it
+// returns 0 if the bus was idle
+uint32_t nrf_spi_host_step(NRF_SPI_Type *spi);
+
+// bytes clocked and interrupts taken so far
+uint32_t nrf_spi_host_bytes(NRF_SPI_Type *spi);
+uint32_t nrf_spi_host_irqs(NRF_SPI_Type *spi);
+// bytes of a frame the shift register had to wait for, nothing was queued behind the byte before
+uint32_t nrf_spi_host_stalls(NRF_SPI_Type *spi);
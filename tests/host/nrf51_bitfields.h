@@ -0,0 +1,4 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK nrf51_bitfields.h, pill/app.h includes it for nothing the host uses
+
+#pragma once
@@ -0,0 +1,30 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK nrf_gpio.h, pin levels are kept in nrf_gpio_host_out
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+	NRF_GPIO_PIN_NOPULL,
+	NRF_GPIO_PIN_PULLDOWN,
+	NRF_GPIO_PIN_PULLUP = 3,
+} nrf_gpio_pin_pull_t;
+
+extern uint32_t nrf_gpio_host_out;
+extern uint32_t nrf_gpio_host_rising_edges[32];
+
+static inline void nrf_gpio_cfg_output(uint32_t pin) { (void)pin; }
+static inline void nrf_gpio_cfg_input(uint32_t pin, nrf_gpio_pin_pull_t pull) { (void)pin; (void)pull; }
+
+static inline void nrf_gpio_pin_set(uint32_t pin)
+{
+	if (!(nrf_gpio_host_out & (1UL << pin)))
+		nrf_gpio_host_rising_edges[pin]++;
+	nrf_gpio_host_out |= 1UL << pin;
+}
+
+static inline void nrf_gpio_pin_clear(uint32_t pin)
+{
+	nrf_gpio_host_out &= ~(1UL << pin);
+}
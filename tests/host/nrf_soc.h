@@ -0,0 +1,23 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK nrf_soc.h
+
+#pragma once
+
+#include <stdint.h>
+#include "nrf51.h"
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_NOT_FOUND 5
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_LENGTH 9
+#define NRF_ERROR_NULL 14
+
+// softdevice calls used by common/spi.c, implemented next to the SPI mock in nrf_spi.c
+uint32_t sd_nvic_SetPriority(int irq, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(int irq);
+uint32_t sd_app_evt_wait(void);
+
+// rng used for ant nonces, implemented in host_stubs.c, the pool is always empty
+uint32_t sd_rand_application_bytes_available_get(uint8_t * p_bytes_available);
+uint32_t sd_rand_application_vector_get(uint8_t * p_buff, uint8_t length);
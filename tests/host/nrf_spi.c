@@ -0,0 +1,143 @@
+// vi:noet:sw=4 ts=4
+// host model of the nRF51 SPI master: one byte per step, READY raised per byte,
+// the SPIx_TWIx vector called from "hardware" when the interrupt is enabled.
+// TXD is the chip's double buffer, a byte shifting out and one waiting behind it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "nrf51.h"
+#include "nrf_gpio.h"
+#include "nrf_soc.h"
+
+NRF_SPI_Type nrf_spi_host[2];
+uint32_t nrf_gpio_host_out;
+uint32_t nrf_gpio_host_rising_edges[32];
+
+void SPI0_TWI0_IRQHandler(void);
+
+static struct {
+	nrf_spi_host_device_t device;
+	uint8_t cs_pin;
+	uint8_t selected;
+	uint32_t releases;
+	uint32_t bytes;
+	uint32_t irqs;
+	uint8_t txd[2];
+	uint8_t txd_count;
+	uint8_t starved;	// the last byte went out with nothing behind it
+	uint32_t stalls;
+} _bus[2];
+static uint32_t _enabled_irqs;
+
+#define BUS(spi) (&_bus[(spi) - nrf_spi_host])
+
+void nrf_spi_host_attach(NRF_SPI_Type *spi, uint8_t cs_pin, nrf_spi_host_device_t device)
+{
+	BUS(spi)->device = device;
+	BUS(spi)->cs_pin = cs_pin;
+	BUS(spi)->selected = 0;
+	BUS(spi)->releases = nrf_gpio_host_rising_edges[cs_pin];
+	BUS(spi)->txd_count = 0;
+	BUS(spi)->starved = 0;
+}
+
+void nrf_spi_host_txd(NRF_SPI_Type *spi, uint8_t byte)
+{
+	if (BUS(spi)->txd_count == 2) {
+		fprintf(stderr, "spi TXD overrun\n");
+		abort();
+	}
+	BUS(spi)->txd[BUS(spi)->txd_count++] = byte;
+}
+
+// no handler for SPI1 on the host, like on hardware where spi_slave owns it
+static void _vector(NRF_SPI_Type *spi)
+{
+	if (spi != NRF_SPI0 || !(_enabled_irqs & (1 << SPI0_TWI0_IRQn))) {
+		fprintf(stderr, "spi irq without a vector\n");
+		abort();
+	}
+	SPI0_TWI0_IRQHandler();
+}
+
+// INTENSET/INTENCLR are write-one strobes on hardware, here they are latched after the fact.
+// Clear goes first: a vector that idles the engine and is handed a new transaction by the
+// completion callback clears and then sets READY.
+static void _latch_inten(NRF_SPI_Type *spi)
+{
+	spi->INTEN = (spi->INTEN & ~spi->INTENCLR) | spi->INTENSET;
+	spi->INTENSET = 0;
+	spi->INTENCLR = 0;
+}
+
+uint32_t nrf_spi_host_step(NRF_SPI_Type *spi)
+{
+	uint8_t mosi, miso = 0xFF;
+	int first;
+
+	_latch_inten(spi);
+
+	if (!BUS(spi)->txd_count || spi->ENABLE != SPI_ENABLE_ENABLE_Enabled)
+		return 0;
+	mosi = BUS(spi)->txd[0];
+	BUS(spi)->txd[0] = BUS(spi)->txd[1];
+	BUS(spi)->txd_count--;
+
+	// a byte is the first of a frame if cs went up since the last one
+	first = !BUS(spi)->selected || BUS(spi)->releases != nrf_gpio_host_rising_edges[BUS(spi)->cs_pin];
+	if (!first && BUS(spi)->starved)
+		BUS(spi)->stalls++;
+	BUS(spi)->starved = !BUS(spi)->txd_count;
+	BUS(spi)->selected = 1;
+	BUS(spi)->releases = nrf_gpio_host_rising_edges[BUS(spi)->cs_pin];
+	if (!(nrf_gpio_host_out & (1UL << BUS(spi)->cs_pin)) && BUS(spi)->device)
+		miso = BUS(spi)->device(mosi, first);
+
+	BUS(spi)->bytes++;
+	spi->RXD = miso;
+	spi->EVENTS_READY = 1;
+	if (spi->INTEN & SPI_INTENSET_READY_Msk) {
+		BUS(spi)->irqs++;
+		_vector(spi);
+		_latch_inten(spi);
+	}
+	return 1;
+}
+
+uint32_t nrf_spi_host_bytes(NRF_SPI_Type *spi)
+{
+	return BUS(spi)->bytes;
+}
+
+uint32_t nrf_spi_host_irqs(NRF_SPI_Type *spi)
+{
+	return BUS(spi)->irqs;
+}
+
+uint32_t nrf_spi_host_stalls(NRF_SPI_Type *spi)
+{
+	return BUS(spi)->stalls;
+}
+
+uint32_t sd_nvic_SetPriority(int irq, uint32_t priority)
+{
+	return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_EnableIRQ(int irq)
+{
+	_enabled_irqs |= 1 << irq;
+	return NRF_SUCCESS;
+}
+
+// the only thing that wakes the host up is the next byte on the bus
+uint32_t sd_app_evt_wait(void)
+{
+	if (!nrf_spi_host_step(NRF_SPI0) && !nrf_spi_host_step(NRF_SPI1)) {
+		fprintf(stderr, "sd_app_evt_wait with nothing pending\n");
+		abort();
+	}
+	return NRF_SUCCESS;
+}
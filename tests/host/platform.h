@@ -0,0 +1,8 @@
+// vi:noet:sw=4 ts=4
+// host stub of the per-platform platform.h, mirrors morpheus_PVT1
+
+#pragma once
+
+#ifndef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE 1152
+#endif
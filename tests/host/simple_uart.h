@@ -0,0 +1,9 @@
+// vi:noet:sw=4 ts=4
+// host stub of the nRF51 SDK simple_uart.h
+
+#pragma once
+
+#include <stdint.h>
+
+void simple_uart_put(uint8_t cr);
+void simple_uart_putstring(const uint8_t * str);
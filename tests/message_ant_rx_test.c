@@ -0,0 +1,159 @@
+// vi:noet:sw=4 ts=4
+
+// Runs received ANT messages through common/message_ant.c and the central the
+// way morpheus does, with receives landing before, between and inside the
+// handler runs.
+// Build and run from the top level:
+//make host && ./build/host/message_ant_rx_test
+//
+// The packet layer is replaced by this file, it only keeps the listener the
+// ANT module registers so receives can be injected. Every message must reach
+// the handler once, in order and with the device it came from, anything else
+// is counted in MSG_ANT_RxStats_t.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "message_app.h"
+#include "message_ant.h"
+
+#define MESSAGES 24
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static MSG_Central_t *central;
+static MSG_Base_t *ant;
+static const hlo_ant_packet_listener *_packet;
+
+static MSG_Data_t *_msgs[MESSAGES];
+static uint32_t _handled, _bad, _next_rx, _nested;
+
+static void
+_on_message(const hlo_ant_device_t *id, MSG_Data_t *msg)
+{
+	uint32_t n;
+	// the payload names the device it was sent from
+	MSG_Base_Read(msg, 0, (uint8_t *)&n, sizeof(n));
+	if (n >= MESSAGES || _msgs[n] != msg || id->device_number != 0x100 + n)
+		_bad++;
+	_handled++;
+	// the next receive lands while this one is handled
+	if (_nested && _next_rx < MESSAGES) {
+		hlo_ant_device_t dev = { .device_number = 0x100 + _next_rx };
+		_packet->on_message(&dev, _msgs[_next_rx++]);
+		_nested--;
+	}
+}
+
+static MSG_Data_t *
+_on_connection(const hlo_ant_device_t *id)
+{
+	return NULL;
+}
+
+static const MSG_ANTHandler_t _handler = { _on_message, _on_connection, NULL };
+
+// the packet layer's side of the ANT module
+hlo_ant_event_listener_t *
+hlo_ant_packet_init(const hlo_ant_packet_listener *user_listener)
+{
+	static hlo_ant_event_listener_t listener;
+	_packet = user_listener;
+	return &listener;
+}
+int hlo_ant_packet_send_message(const hlo_ant_device_t *device, MSG_Data_t *msg, bool full_duplex) { return 0; }
+int32_t hlo_ant_init(hlo_ant_role role, const hlo_ant_event_listener_t *callbacks) { return 0; }
+int32_t hlo_ant_disconnect(const hlo_ant_device_t *device) { return 0; }
+uint32_t aes128_ctr_encrypt_inplace(uint8_t *message, uint32_t message_size, const uint8_t *key, const uint8_t *nonce) { return 0; }
+const uint8_t *get_aes128_key(void) { return NULL; }
+
+// the next message off the air, as the packet layer hands it over
+static MSG_Status
+_rx(void)
+{
+	hlo_ant_device_t dev = { .device_number = 0x100 + _next_rx };
+	MSG_Status ret = MSG_ANT_HandleMessage(&dev, _msgs[_next_rx]);
+	_next_rx++;
+	return ret;
+}
+
+static void
+_reset(void)
+{
+	_handled = _bad = _next_rx = _nested = 0;
+}
+
+int main()
+{
+	MSG_ANT_RxStats_t stats;
+	uint32_t i;
+
+	APP_SCHED_INIT(sizeof(void *), 16);
+	central = MSG_App_Central(NULL);
+	central->loadmod(MSG_App_Base(central));
+	ant = MSG_ANT_Base(central, &_handler, HLO_ANT_ROLE_CENTRAL, 0);
+	central->loadmod(ant);
+	CHECK(_packet);
+	for (i = 0; i < MESSAGES; i++)
+		_msgs[i] = MSG_Base_AllocateObjectAtomic(&i, sizeof(i));
+
+	// a few at a time, handled between receives
+	_reset();
+	while (_next_rx < MESSAGES) {
+		for (i = 0; i < 3 && _next_rx < MESSAGES; i++)
+			CHECK(_rx() == SUCCESS);
+		app_sched_execute();
+	}
+	CHECK(_handled == MESSAGES && !_bad);
+
+	// every handler run takes a receive, its entry queues behind the one being handled
+	_reset();
+	_nested = MESSAGES - 1;
+	CHECK(_rx() == SUCCESS);
+	app_sched_execute();
+	CHECK(_handled == MESSAGES && !_bad);
+	MSG_ANT_GetRxStats(&stats);
+	CHECK(!stats.dropped && !stats.lost);
+
+	// a full ring refuses, counts it, and keeps the ones it has
+	_reset();
+	for (i = 0; i < MSG_ANT_RX_PENDING; i++)
+		CHECK(_rx() == SUCCESS);
+	CHECK(_rx() == OOM);
+	app_sched_execute();
+	CHECK(_handled == MSG_ANT_RX_PENDING && !_bad);
+	MSG_ANT_GetRxStats(&stats);
+	CHECK(stats.dropped == 1 && !stats.lost);
+
+	// a full central queue leaves nothing behind in the ring
+	_reset();
+	for (i = 0; central->dispatch(ADDR(ANT, 0), ADDR(ANT, MSG_ANT_PING), NULL) == SUCCESS; i++)
+		;
+	CHECK(i && _rx() == OOM);
+	app_sched_execute();
+	CHECK(_rx() == SUCCESS);
+	app_sched_execute();
+	CHECK(_handled == 1 && !_bad);
+	MSG_ANT_GetRxStats(&stats);
+	CHECK(stats.dropped == 2 && !stats.lost);
+
+	// a dispatch that never reaches the module is counted once the next one does
+	_reset();
+	CHECK(_rx() == SUCCESS);
+	central->unloadmod(ant);
+	app_sched_execute();
+	central->loadmod(ant);
+	CHECK(_rx() == SUCCESS);
+	app_sched_execute();
+	CHECK(_handled == 1 && !_bad);
+	MSG_ANT_GetRxStats(&stats);
+	CHECK(stats.dropped == 2 && stats.lost == 1);
+
+	// the ring held no references, the messages are the test's alone
+	for (i = 0; i < MESSAGES; i++) {
+		CHECK(_msgs[i]->ref == 1);
+		MSG_Base_ReleaseDataAtomic(_msgs[i]);
+	}
+	printf("ant rx: %u messages handled in order, %u dropped, %u lost\n", MESSAGES, stats.dropped, stats.lost);
+	return 0;
+}
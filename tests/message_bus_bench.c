@@ -0,0 +1,271 @@
+// vi:noet:sw=4 ts=4
+
+// Pushes dispatches through MSG_Central_t with a set of fake modules loaded,
+// using the host scheduler, fifo and timer stubs from tests/host.
+// Build and run from the top level:
+//make host && ./build/host/message_bus_bench
+//
+// The workload follows the morpheus pipeline: ant parcels arrive in bursts from
+// "interrupt" context, the ant module forwards a view of the payload to time,
+// time encodes a protobuf sized message for sspi, imu samples go out at high
+// priority and cli lines go through an hlo_queue at low priority.
+// Reports delivered events per second, dispatch drops, the heap high water mark
+// and the worst heap fragmentation seen while messages were in flight.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf_soc.h"
+#include "message_app.h"
+#include "message_base.h"
+#include "message_pool.h"
+#include "hlo_queue.h"
+#include "heap.h"
+
+#define EVENTS 4000000
+#define MAX_BURST 6
+#define SCHED_QUEUE_SIZE 16
+
+static MSG_Central_t *central;
+static struct hlo_queue_t *cli_queue;
+
+static struct {
+	uint32_t injected;
+	uint32_t delivered;
+	uint32_t forwarded;
+	uint32_t drops;
+	uint32_t oom;
+	uint32_t samples;
+	size_t min_free;
+	size_t worst_largest;
+	double worst_fragmentation;
+} stats = { .min_free = configTOTAL_HEAP_SIZE, .worst_largest = configTOTAL_HEAP_SIZE };
+
+static uint32_t _seed = 0x9e3779b9;
+
+static uint32_t
+_rand(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+// same as MSG_Base_AllocateDataAtomic without the APP_OK, exhaustion is counted instead
+static MSG_Data_t *
+_allocate(uint16_t size)
+{
+	MSG_Data_t *msg = MSG_Pool_Alloc(size + sizeof(MSG_Data_t));
+	if (!msg)
+		msg = pvPortMalloc(size + sizeof(MSG_Data_t));
+	if (msg) {
+		msg->len = size;
+		msg->ref = 1;
+		msg->context = 0;
+	} else {
+		stats.oom++;
+	}
+	return msg;
+}
+
+// largest single message the heap can still hand out
+static size_t
+_largest_heap_block(void)
+{
+	size_t lo = 0, hi = xPortGetFreeHeapSize();
+	while (lo < hi) {
+		size_t mid = (lo + hi + 1) / 2;
+		void *p = pvPortMalloc(mid);
+		if (p) {
+			vPortFree(p);
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return lo;
+}
+
+// the fragmentation probe drains the heap, so xPortGetMinimumEverFreeHeapSize is useless here
+static void
+_track_heap(void)
+{
+	size_t free = xPortGetFreeHeapSize();
+	if (free < stats.min_free)
+		stats.min_free = free;
+}
+
+static void
+_sample_fragmentation(void)
+{
+	size_t largest = _largest_heap_block();
+	size_t free = xPortGetFreeHeapSize();
+	stats.samples++;
+	if (largest < stats.worst_largest)
+		stats.worst_largest = largest;
+	if (free && 1.0 - (double)largest / free > stats.worst_fragmentation)
+		stats.worst_fragmentation = 1.0 - (double)largest / free;
+}
+
+static void
+_forward(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	if (!data)
+		return;
+	if (central->dispatch(src, dst, data) == SUCCESS)
+		stats.forwarded++;
+	else
+		stats.drops++;
+	MSG_Base_ReleaseDataAtomic(data);
+}
+
+static MSG_Status _ok(void) { return SUCCESS; }
+
+static MSG_Status
+_ant_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	stats.delivered++;
+	_track_heap();
+	// strip the parcel header and hand the payload on, like ant_user does
+	if (data && data->len > 4 && (_rand() & 1))
+		_forward(ADDR(ANT, 0), ADDR(TIME, 0), MSG_Base_AllocateViewAtomic(data, 4, data->len - 4));
+	return SUCCESS;
+}
+
+static MSG_Status
+_time_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	MSG_Data_t *pb;
+	stats.delivered++;
+	_track_heap();
+	pb = _allocate(30 + _rand() % 50);
+	if (pb && data)
+		MSG_Base_Read(data, 0, pb->buf, data->len < pb->len ? data->len : pb->len);
+	_forward(ADDR(TIME, 0), ADDR(SSPI, 0), pb);
+	return SUCCESS;
+}
+
+static MSG_Status
+_sspi_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	stats.delivered++;
+	_track_heap();
+	// the deepest point of the pipeline, most messages are in flight here
+	if ((stats.delivered & 0x3ff) == 0)
+		_sample_fragmentation();
+	return SUCCESS;
+}
+
+static MSG_Status
+_imu_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	stats.delivered++;
+	_track_heap();
+	return SUCCESS;
+}
+
+static MSG_Status
+_cli_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	uint8_t line[64];
+	stats.delivered++;
+	_track_heap();
+	if (data && data->len <= sizeof(line)) {
+		MSG_Base_Read(data, 0, line, data->len);
+		if (hlo_queue_write(cli_queue, line, data->len) == NRF_SUCCESS)
+			hlo_queue_read(cli_queue, line, data->len);
+	}
+	return SUCCESS;
+}
+
+static MSG_Base_t _mods[] = {
+	{ ANT, "ANT", _ok, _ok, _ok, _ant_send },
+	{ TIME, "TIME", _ok, _ok, _ok, _time_send },
+	{ SSPI, "SSPI", _ok, _ok, _ok, _sspi_send },
+	{ IMU, "IMU", _ok, _ok, _ok, _imu_send },
+	{ CLI, "CLI", _ok, _ok, _ok, _cli_send },
+};
+
+// one message as it would be produced by an interrupt or a ble event
+static void
+_inject(void)
+{
+	uint32_t r = _rand() % 100;
+	MSG_Data_t *data;
+	MSG_Address_t dst;
+	if (r < 60) {
+		data = _allocate(10 + _rand() % 20);
+		dst = ADDR(ANT, 0);
+	} else if (r < 85) {
+		data = _allocate(6);
+		dst = ADDR(IMU, 0);
+	} else if (r < 95) {
+		data = _allocate(8 + _rand() % 24);
+		dst = ADDR(CLI, 0);
+	} else {
+		data = _allocate(17);
+		dst = ADDR(TIME, 0);
+	}
+	if (!data)
+		return;
+	stats.injected++;
+	_track_heap();
+	if (central->dispatch(ADDR(CENTRAL, 0), dst, data) != SUCCESS)
+		stats.drops++;
+	MSG_Base_ReleaseDataAtomic(data);
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+	double start, elapsed;
+	size_t i;
+
+	APP_SCHED_INIT(sizeof(void *), SCHED_QUEUE_SIZE);
+	central = MSG_App_Central(NULL);
+	central->loadmod(MSG_App_Base(central));
+	for (i = 0; i < sizeof(_mods) / sizeof(_mods[0]); i++)
+		central->loadmod(&_mods[i]);
+	cli_queue = hlo_queue_init(128);
+
+	start = _now();
+	while (stats.delivered < EVENTS) {
+		uint32_t burst = 1 + _rand() % MAX_BURST;
+		while (burst--)
+			_inject();
+		app_sched_execute();
+	}
+	elapsed = _now() - start;
+
+	printf("message bus, %s\n", MSG_Pool_ClassCount() ? "slab pool + heap" : "heap only");
+	printf("  delivered      %u (%u injected, %u forwarded)\n", stats.delivered, stats.injected, stats.forwarded);
+	printf("  events/sec     %.0f\n", stats.delivered / elapsed);
+	printf("  ns per event   %.1f\n", elapsed * 1e9 / stats.delivered);
+	printf("  dispatch drops %u, allocation failures %u\n", stats.drops, stats.oom);
+	printf("  scheduler high water %u/%u\n", app_sched_host_high_water(), SCHED_QUEUE_SIZE);
+	printf("  heap high water %zu/%u bytes\n", (size_t)configTOTAL_HEAP_SIZE - stats.min_free, configTOTAL_HEAP_SIZE);
+	printf("  worst largest free heap block in flight: %zu (%u samples)\n", stats.worst_largest, stats.samples);
+	printf("  worst heap fragmentation  %.0f%%\n", stats.worst_fragmentation * 100);
+	for (i = 0; i < MSG_Pool_ClassCount(); i++) {
+		MSG_PoolClassStats_t st;
+		MSG_Pool_GetClassStats(i, &st);
+		printf("  class %3u: %u/%u free, low water %u\n", st.block_size, st.free_count, st.block_count, st.min_free_count);
+	}
+	for (i = 0; i < sizeof(_mods) / sizeof(_mods[0]); i++) {
+		MSG_App_ModuleStats_t st;
+		if (!MSG_App_GetModuleStats(_mods[i].type, &st))
+			break;
+		printf("  %-4s count %u drops %u max wait %u max run %u ticks\n", _mods[i].typestr, st.count, st.drops, st.max_wait, st.max_handler);
+	}
+	return 0;
+}
@@ -0,0 +1,194 @@
+// vi:noet:sw=4 ts=4
+
+// Checks the central's priority queues, its recovery from a full scheduler and
+// its timed dispatch, also into a full queue, against the host scheduler and
+// app_timer.
+// Build and run from the top level:
+//make host && ./build/host/message_central_test
+//
+// The clock only moves through app_timer_host_advance, a delivery is counted
+// when the scheduler hands it to the fake module.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf_soc.h"
+#include "message_app.h"
+#include "message_base.h"
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+// the central splits waits longer than this into several app_timer runs
+#define TIMED_MAX_TICKS 0x7FFFFF
+
+static MSG_Central_t *central;
+static uint32_t _runs[8];
+static uint8_t _order[32], _delivered;
+static uint8_t _inject;		// submodule whose delivery dispatches a high priority 7
+
+static MSG_Status _ok(void) { return SUCCESS; }
+
+static MSG_Status
+_time_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	_runs[dst.submodule]++;
+	if (_delivered < sizeof(_order))
+		_order[_delivered++] = dst.submodule;
+	if (_inject && dst.submodule == _inject) {
+		_inject = 0;
+		central->dispatch_priority(src, ADDR(TIME, 7), NULL, MSG_PRIORITY_HIGH);
+	}
+	return SUCCESS;
+}
+
+static MSG_Base_t _time = { TIME, "TIME", _ok, _ok, _ok, _time_send };
+
+static void
+_advance(uint32_t ticks)
+{
+	app_timer_host_advance(ticks);
+	app_sched_execute();
+}
+
+static void
+_dummy(void *event_data, uint16_t event_size)
+{
+}
+
+static int
+_priorities(void)
+{
+	static const uint8_t expect[] = { 3, 4, 1, 7, 2, 5, 6 };
+	static const struct {
+		uint8_t sub;
+		MSG_Priority priority;
+	} sent[] = {
+		{ 5, MSG_PRIORITY_LOW }, { 1, MSG_PRIORITY_NORMAL }, { 3, MSG_PRIORITY_HIGH },
+		{ 2, MSG_PRIORITY_NORMAL }, { 6, MSG_PRIORITY_LOW }, { 4, MSG_PRIORITY_HIGH },
+	};
+	uint8_t i;
+
+	// highest priority first, in order within one, and a high one sent from a
+	// handler gets ahead of the normal ones still queued
+	_delivered = 0;
+	_inject = 1;
+	for (i = 0; i < sizeof(sent) / sizeof(sent[0]); i++)
+		CHECK(central->dispatch_priority(ADDR(TIME, 0), ADDR(TIME, sent[i].sub), NULL, sent[i].priority) == SUCCESS);
+	app_sched_execute();
+	CHECK(_delivered == sizeof(expect) && !memcmp(_order, expect, sizeof(expect)));
+	return 0;
+}
+
+static int
+_sched_full(void)
+{
+	uint32_t i;
+
+	// the scheduler has no room for the drain and nothing else is dispatched after
+	APP_SCHED_INIT(sizeof(void *), 2);
+	memset(_runs, 0, sizeof(_runs));
+	CHECK(app_sched_event_put(NULL, 0, _dummy) == NRF_SUCCESS);
+	CHECK(app_sched_event_put(NULL, 0, _dummy) == NRF_SUCCESS);
+	CHECK(central->dispatch(ADDR(TIME, 0), ADDR(TIME, 1), NULL) == SUCCESS);
+	app_sched_execute();
+	CHECK(_runs[1] == 0);
+	// still full when the retry comes, it tries again
+	for (i = 0; i < 2; i++)
+		CHECK(app_sched_event_put(NULL, 0, _dummy) == NRF_SUCCESS);
+	app_timer_host_advance(5);
+	CHECK(_runs[1] == 0);
+	app_sched_execute();
+	_advance(5);
+	CHECK(_runs[1] == 1);
+	// the ones dispatched meanwhile go out with it
+	CHECK(central->dispatch(ADDR(TIME, 0), ADDR(TIME, 2), NULL) == SUCCESS);
+	app_sched_execute();
+	CHECK(_runs[2] == 1);
+	APP_SCHED_INIT(sizeof(void *), 16);
+	return 0;
+}
+
+static int
+_timed(void)
+{
+	uint32_t long_wait = 3 * TIMED_MAX_TICKS + 100, starts, i;
+	uint8_t h, h2, later[2];
+
+	// a wait past one app_timer run fires on time, not at the first step
+	CHECK(central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 1), NULL, 0x80000000) == MSG_TIMED_NONE);
+	h = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 1), NULL, long_wait);
+	CHECK(h != MSG_TIMED_NONE);
+	_advance(long_wait - 1);
+	CHECK(_runs[1] == 0);
+	_advance(1);
+	CHECK(_runs[1] == 1);
+
+	// a handle that fired does not cancel the entry that reuses its slot
+	h = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 2), NULL, 10);
+	_advance(10);
+	CHECK(_runs[2] == 1);
+	h2 = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 2), NULL, 100);
+	CHECK(h2 != MSG_TIMED_NONE && h2 != h);
+	CHECK(central->cancel(h) == FAIL);
+	_advance(100);
+	CHECK(_runs[2] == 2);
+	CHECK(central->cancel(h2) == FAIL);
+
+	// later entries and their cancels leave the running timer alone
+	starts = app_timer_host_starts();
+	h = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 3), NULL, 1000);
+	later[0] = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 3), NULL, 2000);
+	later[1] = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 3), NULL, 3000);
+	CHECK(app_timer_host_starts() == starts + 1);
+	CHECK(central->cancel(later[1]) == SUCCESS);
+	CHECK(app_timer_host_starts() == starts + 1);
+	// the earliest one going moves the timer
+	CHECK(central->cancel(h) == SUCCESS);
+	CHECK(app_timer_host_starts() == starts + 2);
+	_advance(2000);
+	CHECK(_runs[3] == 1);
+
+	// a full app_timer op queue is retried from the scheduler, not asserted on
+	app_timer_host_fail_starts(2);
+	h = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 4), NULL, 50);
+	CHECK(h != MSG_TIMED_NONE);
+	app_sched_execute();
+	_advance(50);
+	CHECK(_runs[4] == 1);
+
+	// a one shot that finds its ring full stays due and goes with the next
+	// wakeup, until then its handle still cancels it
+	for (i = 0; i < 64 && central->dispatch(ADDR(TIME, 0), ADDR(TIME, 6), NULL) == SUCCESS; i++)
+		;
+	CHECK(i < 64);
+	h = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 5), NULL, 10);
+	h2 = central->dispatch_at(ADDR(TIME, 0), ADDR(TIME, 5), NULL, 10);
+	app_timer_host_advance(10);
+	CHECK(_runs[5] == 0);
+	CHECK(central->cancel(h2) == SUCCESS);
+	app_sched_execute();
+	CHECK(_runs[6] == i && _runs[5] == 0);
+	_advance(5);
+	CHECK(_runs[5] == 1);
+	CHECK(central->cancel(h) == FAIL);
+	_advance(100);
+	CHECK(_runs[5] == 1);
+	return 0;
+}
+
+int main()
+{
+	APP_SCHED_INIT(sizeof(void *), 16);
+	central = MSG_App_Central(NULL);
+	central->loadmod(MSG_App_Base(central));
+	central->loadmod(&_time);
+
+	if (_priorities() || _sched_full())
+		return 1;
+	memset(_runs, 0, sizeof(_runs));
+	if (_timed())
+		return 1;
+	printf("central: priorities, full scheduler and timed dispatch ok\n");
+	return 0;
+}
@@ -0,0 +1,165 @@
+// vi:noet:sw=4 ts=4
+
+// Checks the reference counting of MSG_Data_t objects, views and chains in
+// common/message_base.c against the host heap and slab pool.
+// Build and run from the top level:
+//make host && ./build/host/message_data_test
+//
+// Every case ends with everything released, the free count must be back
+// where it started.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "message_base.h"
+#include "message_pool.h"
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static const char _text[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static uint32_t _free;
+
+static int
+_refcounts(void)
+{
+	MSG_Data_t *d = MSG_Base_AllocateStringAtomic(_text);
+	CHECK(d && d->ref == 1 && d->len == sizeof(_text));
+	CHECK(MSG_Base_AcquireDataAtomic(d) == SUCCESS && d->ref == 2);
+	MSG_Base_ReleaseDataAtomic(d);
+	CHECK(d->ref == 1);
+	MSG_Base_ReleaseDataAtomic(d);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+static int
+_views(void)
+{
+	MSG_Data_t *d = MSG_Base_AllocateStringAtomic(_text);
+	MSG_Data_t *v, *vv;
+
+	CHECK(!MSG_Base_AllocateViewAtomic(d, 30, 10));
+	v = MSG_Base_AllocateViewAtomic(d, 10, 20);
+	CHECK(v && d->ref == 2 && v->len == 20);
+	CHECK(!memcmp(MSG_Base_Buffer(v), &_text[10], 20));
+
+	// a view of a view holds the original, not the view in between
+	vv = MSG_Base_AllocateViewAtomic(v, 5, 4);
+	CHECK(vv && d->ref == 3 && v->ref == 1);
+	CHECK(!memcmp(MSG_Base_Buffer(vv), &_text[15], 4));
+
+	// the owner goes first, the views keep its memory
+	MSG_Base_ReleaseDataAtomic(d);
+	MSG_Base_ReleaseDataAtomic(v);
+	CHECK(d->ref == 1);
+	CHECK(!memcmp(MSG_Base_Buffer(vv), "fghi", 4));
+	MSG_Base_ReleaseDataAtomic(vv);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+static int
+_chains(void)
+{
+	MSG_Data_t *a = MSG_Base_AllocateObjectAtomic(_text, 8);
+	MSG_Data_t *b = MSG_Base_AllocateStringAtomic(_text);
+	MSG_Data_t *v = MSG_Base_AllocateViewAtomic(b, 20, 6);
+	MSG_Data_t *segs[MSG_CHAIN_MAX_SEGMENTS + 1];
+	MSG_Data_t *c, *cc, *f;
+	uint8_t out[64];
+	uint16_t len;
+	int i;
+
+	segs[0] = a;
+	segs[1] = v;
+	c = MSG_Base_AllocateChainAtomic(segs, 2);
+	CHECK(c && c->len == 14 && a->ref == 2 && v->ref == 2);
+	CHECK(MSG_Base_SegmentCount(c) == 2 && !MSG_Base_Buffer(c));
+	CHECK(MSG_Base_Segment(c, 1, &len) && len == 6 && !MSG_Base_Segment(c, 2, &len));
+	// reads run across the segment boundary
+	CHECK(MSG_Base_Read(c, 6, out, sizeof(out)) == 8 && !memcmp(out, "67klmnop", 8));
+
+	// a view over a chain would show the segment table
+	CHECK(!MSG_Base_AllocateViewAtomic(c, 0, 4));
+
+	// a chain in a chain is expanded into its segments
+	segs[0] = c;
+	segs[1] = a;
+	cc = MSG_Base_AllocateChainAtomic(segs, 2);
+	CHECK(cc && MSG_Base_SegmentCount(cc) == 3 && cc->len == 22 && a->ref == 4 && c->ref == 1);
+	for (i = 0; i <= MSG_CHAIN_MAX_SEGMENTS; i++)
+		segs[i] = a;
+	CHECK(!MSG_Base_AllocateChainAtomic(segs, MSG_CHAIN_MAX_SEGMENTS + 1));
+	CHECK(a->ref == 4);
+
+	// flattening a chain copies it, anything else is the same object
+	f = MSG_Base_FlattenAtomic(cc);
+	CHECK(f && f != cc && f->len == 22 && f->ref == 1 && cc->ref == 1);
+	CHECK(!memcmp(MSG_Base_Buffer(f), "01234567klmnop01234567", 22));
+	MSG_Base_ReleaseDataAtomic(f);
+	f = MSG_Base_FlattenAtomic(a);
+	CHECK(f == a && a->ref == 5);
+	MSG_Base_ReleaseDataAtomic(f);
+
+	// the segments outlive whoever dropped them first
+	MSG_Base_ReleaseDataAtomic(a);
+	MSG_Base_ReleaseDataAtomic(v);
+	MSG_Base_ReleaseDataAtomic(b);
+	MSG_Base_ReleaseDataAtomic(c);
+	CHECK(MSG_Base_Read(cc, 0, out, sizeof(out)) == 22 && !memcmp(out, "01234567klmnop01234567", 22));
+	MSG_Base_ReleaseDataAtomic(cc);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+// the free count adds up pool blocks and fragments, the largest free is what one object gets
+static int
+_largest(void)
+{
+	uint32_t n = MSG_Base_LargestFree();
+	MSG_Data_t *a, *b, *d;
+	CHECK(n > 0 && n < MSG_Base_FreeCount());
+	d = MSG_Base_AllocateDataAtomic(n);
+	CHECK(d && d->len == n);
+	MSG_Base_ReleaseDataAtomic(d);
+	// a hole in the middle of the heap is not one block with what follows it
+	a = MSG_Base_AllocateDataAtomic(n / 2);
+	b = MSG_Base_AllocateDataAtomic(n / 4);
+	CHECK(a && b);
+	MSG_Base_ReleaseDataAtomic(a);
+	CHECK(MSG_Base_LargestFree() < n - n / 4);
+	MSG_Base_ReleaseDataAtomic(b);
+	CHECK(MSG_Base_LargestFree() == n);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+// a small object takes its own class or the next one up, then the heap,
+// never a block it leaves a larger object short of
+static int
+_classes(void)
+{
+	MSG_Data_t *d[3];
+	int i;
+	for (i = 0; i < 3; i++)
+		CHECK((d[i] = MSG_Base_AllocateDataAtomic(8)));
+	CHECK(MSG_Pool_BlockSize(d[0]) == 16 && MSG_Pool_BlockSize(d[1]) == 24);
+	CHECK(MSG_Pool_BlockSize(d[2]) == 0);
+	for (i = 0; i < 3; i++)
+		MSG_Base_ReleaseDataAtomic(d[i]);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+int main()
+{
+	// the heap takes its own header out of the free count on first use
+	MSG_Base_ReleaseDataAtomic(MSG_Base_AllocateDataAtomic(200));
+	_free = MSG_Base_FreeCount();
+	if (_refcounts() || _views() || _chains() || _largest() || _classes())
+		return 1;
+	printf("message data: refcounts, views, chains, largest free and pool classes ok\n");
+	return 0;
+}
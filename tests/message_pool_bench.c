@@ -0,0 +1,173 @@
+// vi:noet:sw=4 ts=4
+
+// Compares MSG_Data_t allocation through the slab pool against the plain heap.
+// Build both flavours from the tests directory and run them side by side:
+//gcc -O2 -Ihost -I../common message_pool_bench.c ../common/message_base.c ../common/message_pool.c ../common/heap.c host/host_stubs.c -o pool_bench && ./pool_bench
+//gcc -O2 -Ihost -I../common -DHOST_NO_MSG_POOL message_pool_bench.c ../common/message_base.c ../common/message_pool.c ../common/heap.c host/host_stubs.c -o heap_bench && ./heap_bench
+//
+// The workload replays the message mix seen on morpheus: ant parcels, device
+// id strings, pill packets, uart commands, encoded protobufs and the odd large
+// sspi read, with a bounded number of messages in flight.
+// Note the host heap header is 16 bytes instead of 8 on the nRF51, so absolute
+// byte numbers are pessimistic for the heap-only flavour.
+//
+// An optional argument reseeds the workload. A pool config is only worth
+// turning on in an app when it has no failed allocations and no smaller worst
+// largest block than the heap only flavour, which none has met with the
+// morpheus heap so far.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "message_base.h"
+#include "message_pool.h"
+#include "heap.h"
+
+#define ITERATIONS 2000000
+#define MAX_LIVE 6
+
+static const struct {
+	uint16_t size;
+	uint8_t weight;
+} _mix[] = {
+	{ 10, 30 },		// MSG_ANT_Message_t parcel
+	{ 17, 20 },		// hex device id string
+	{ 30, 25 },		// encrypted pill packet
+	{ 32, 10 },		// uart command buffer
+	{ 80, 10 },		// encoded MorpheusCommand
+	{ 150, 5 },		// sspi read from the cc3200
+};
+
+static uint32_t _seed = 0x12345678;
+
+static uint32_t
+_rand(void)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+	return _seed;
+}
+
+#define MIX (sizeof(_mix) / sizeof(_mix[0]))
+
+static unsigned
+_pick(void)
+{
+	uint32_t total = 0, r, i;
+	for (i = 0; i < MIX; i++)
+		total += _mix[i].weight;
+	r = _rand() % total;
+	for (i = 0; i < MIX; i++) {
+		if (r < _mix[i].weight)
+			return i;
+		r -= _mix[i].weight;
+	}
+	return 0;
+}
+
+// same as MSG_Base_AllocateDataAtomic without the APP_OK, exhaustion is counted instead
+static MSG_Data_t *
+_allocate(uint16_t size)
+{
+	MSG_Data_t *msg = MSG_Pool_Alloc(size + sizeof(MSG_Data_t));
+	if (!msg)
+		msg = pvPortMalloc(size + sizeof(MSG_Data_t));
+	if (msg) {
+		msg->len = size;
+		msg->ref = 1;
+		msg->context = 0;
+	}
+	return msg;
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	MSG_Data_t *live[MAX_LIVE] = { 0 };
+	unsigned kind[MAX_LIVE];
+	uint32_t in_flight[MIX] = { 0 };
+	uint32_t in_flight_since[MIX] = { 0 };
+	uint64_t in_flight_sum[MIX] = { 0 };	// objects of each size times ops they stayed
+	uint32_t failures = 0, allocations = 0;
+	size_t worst_largest = configTOTAL_HEAP_SIZE;
+	double worst_fragmentation = 0;
+	uint32_t i;
+	double start, elapsed;
+
+	if (argc > 1)
+		_seed = strtoul(argv[1], NULL, 0);
+	start = _now();
+	for (i = 0; i < ITERATIONS; i++) {
+		uint32_t slot = _rand() % MAX_LIVE;
+		unsigned k;
+		if (live[slot]) {
+			MSG_Base_ReleaseDataAtomic(live[slot]);
+			live[slot] = NULL;
+			k = kind[slot];
+			in_flight_sum[k] += (uint64_t)in_flight[k]-- * (i - in_flight_since[k]);
+			in_flight_since[k] = i;
+		} else {
+			k = kind[slot] = _pick();
+			live[slot] = _allocate(_mix[k].size);
+			if (live[slot]) {
+				allocations++;
+				in_flight_sum[k] += (uint64_t)in_flight[k]++ * (i - in_flight_since[k]);
+				in_flight_since[k] = i;
+			} else {
+				failures++;
+			}
+		}
+	}
+	elapsed = _now() - start;
+	for (i = 0; i < MIX; i++)
+		in_flight_sum[i] += (uint64_t)in_flight[i] * (ITERATIONS - in_flight_since[i]);
+
+	// fragmentation snapshot with a full set of messages in flight
+	for (i = 0; i < 100000; i++) {
+		uint32_t slot = i % MAX_LIVE;
+		size_t largest;
+		if (live[slot])
+			MSG_Base_ReleaseDataAtomic(live[slot]);
+		live[slot] = _allocate(_mix[_pick()].size);
+		if (!live[slot])
+			failures++;
+		largest = xPortGetLargestFreeBlockSize();
+		if (largest < worst_largest)
+			worst_largest = largest;
+		// share of the free heap that is unusable for a single large message
+		if (xPortGetFreeHeapSize() && 1.0 - (double)largest / xPortGetFreeHeapSize() > worst_fragmentation)
+			worst_fragmentation = 1.0 - (double)largest / xPortGetFreeHeapSize();
+	}
+
+	printf("%s\n", MSG_Pool_ClassCount() ? "slab pool + heap" : "heap only");
+	printf("  ops            %u (%u allocations, %u failed)\n", ITERATIONS, allocations, failures);
+	printf("  ns per op      %.1f\n", elapsed * 1e9 / ITERATIONS);
+	printf("  free bytes     %u\n", MSG_Base_FreeCount());
+	printf("  worst largest free heap block with %d live: %zu\n", MAX_LIVE, worst_largest);
+	printf("  worst heap fragmentation  %.0f%%\n", worst_fragmentation * 100);
+	// the pool classes and counts in tests/host/message_config.h come from these
+	for (i = 0; i < MIX; i++)
+		printf("  %3zu byte objects in flight, mean %.2f\n", _mix[i].size + sizeof(MSG_Data_t),
+		       (double)in_flight_sum[i] / ITERATIONS);
+	for (i = 0; i < MSG_Pool_ClassCount(); i++) {
+		MSG_PoolClassStats_t st;
+		MSG_Pool_GetClassStats(i, &st);
+		printf("  class %3u: %u/%u free, low water %u\n", st.block_size, st.free_count, st.block_count, st.min_free_count);
+	}
+
+	for (i = 0; i < MAX_LIVE; i++)
+		if (live[i])
+			MSG_Base_ReleaseDataAtomic(live[i]);
+	return 0;
+}
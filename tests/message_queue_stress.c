@@ -0,0 +1,172 @@
+// vi:noet:sw=4 ts=4
+
+// Threaded stress test of common/message_queue.c, a consumer thread drains
+// while one (SPSC) or several (MPSC) producer threads push as fast as they
+// can into a small queue.
+// Build and run from the top level:
+//make host && ./build/host/message_queue_stress
+//
+// Stands in for main loop vs interrupt on the target. The critical region is
+// a recursive lock (HOST_THREADED) and QUEUE_BARRIER a full fence that
+// yields every few calls, so even a single core host switches threads between
+// writing an entry and publishing it, where an interrupt hurts most. The rest
+// of the queue runs as on the M0. Entries carry fake handles, producer in the
+// top byte and a sequence number below, the queue never dereferences them on
+// a MSG_QUEUE_DROP_NEWEST queue. Every producer's sequence has to come out
+// complete and in order.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "message_queue.h"
+#include "heap.h"
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+#define CAPACITY 8
+#define SPSC_COUNT 2000000
+#define MPSC_PRODUCERS 3
+#define MPSC_COUNT 500000
+
+static pthread_mutex_t _critical;
+static volatile int _done;	// producers finished
+
+void host_critical_enter(void)
+{
+	pthread_mutex_lock(&_critical);
+}
+
+void host_critical_exit(void)
+{
+	pthread_mutex_unlock(&_critical);
+}
+
+void host_preempt_point(void)
+{
+	static __thread uint32_t calls;
+	__sync_synchronize();
+	if ((++calls & 7) == 0)
+		sched_yield();
+}
+
+typedef struct {
+	MSG_Queue_t *queue;
+	uint8_t id;
+	uint32_t count;
+	uint32_t full;		// pushes refused and retried
+} producer_t;
+
+static void *
+_produce(void *arg)
+{
+	producer_t *p = arg;
+	uint32_t seq;
+	for (seq = 0; seq < p->count; seq++) {
+		MSG_Data_t *msg = (MSG_Data_t *)(uintptr_t)(((uint32_t)p->id << 24) | (seq + 1));
+		while (!MSG_Queue_Push(p->queue, msg, ADDR(p->id, (uint8_t)seq))) {
+			p->full++;
+			sched_yield();
+		}
+	}
+	__sync_fetch_and_add(&_done, 1);
+	return NULL;
+}
+
+// pops until every producer is done and the queue is empty, returns the
+// number of bad or missing entries
+static uint32_t
+_consume(MSG_Queue_t *queue, producer_t *producers, int n, uint32_t *empty)
+{
+	uint32_t next[MPSC_PRODUCERS] = { 0 };
+	uint32_t remaining = 0;
+	uint32_t bad = 0;
+	int i;
+	for (i = 0; i < n; i++)
+		remaining += producers[i].count;
+	while (remaining) {
+		MSG_QueueEntry_t e;
+		const MSG_QueueEntry_t *head = MSG_Queue_Peek(queue);
+		MSG_Data_t *peeked;
+		uint32_t v;
+		uint8_t id;
+		if (!head) {
+			if (_done == n && !MSG_Queue_Peek(queue))
+				break;
+			(*empty)++;
+			sched_yield();
+			continue;
+		}
+		// the slot is the producers' again once popped
+		peeked = head->msg;
+		if (!MSG_Queue_Pop(queue, &e) || e.msg != peeked) {
+			bad++;
+			continue;
+		}
+		v = (uint32_t)(uintptr_t)e.msg;
+		id = v >> 24;
+		if (id >= n || (v & 0xFFFFFF) != next[id] + 1 || e.address.module != id
+		    || e.address.submodule != (uint8_t)next[id] || e.tag != MSG_QUEUE_NO_TAG) {
+			if (bad++ < 4)
+				printf("bad entry %08x from %u, expected seq %u\n", v, id, next[id] + 1);
+		}
+		if (id < n)
+			next[id] = (v & 0xFFFFFF);
+		remaining--;
+	}
+	if (remaining)
+		printf("%u entries missing\n", remaining);
+	return bad + remaining;
+}
+
+static int
+_run(MSG_QueueMode mode, int n, uint32_t count, const char *name)
+{
+	MSG_Queue_t *queue = MSG_Queue_Init(CAPACITY, mode);
+	producer_t producers[MPSC_PRODUCERS];
+	pthread_t threads[MPSC_PRODUCERS];
+	MSG_QueueStats_t stats;
+	uint32_t full = 0;
+	uint32_t empty = 0;
+	uint32_t bad;
+	int i;
+	CHECK(queue);
+	_done = 0;
+	for (i = 0; i < n; i++) {
+		producers[i] = (producer_t){ .queue = queue, .id = i, .count = count };
+		CHECK(pthread_create(&threads[i], NULL, _produce, &producers[i]) == 0);
+	}
+	bad = _consume(queue, producers, n, &empty);
+	for (i = 0; i < n; i++) {
+		pthread_join(threads[i], NULL);
+		full += producers[i].full;
+	}
+	MSG_Queue_GetStats(queue, &stats);
+	printf("%s: %d x %u through %u entries, %u refused, %u empty polls, high water %u\n",
+	       name, n, count, CAPACITY, full, empty, stats.high_water);
+	CHECK(bad == 0);
+	CHECK(MSG_Queue_Depth(queue) == 0);
+	CHECK(stats.pushed == (uint32_t)n * count);
+	// drops is 16 bits and wraps under this load
+	CHECK(stats.drops == (uint16_t)full);
+	CHECK(stats.high_water <= CAPACITY);
+	vPortFree(queue);
+	return 0;
+}
+
+int main(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&_critical, &attr);
+
+	if (_run(MSG_QUEUE_SPSC, 1, SPSC_COUNT, "spsc"))
+		return 1;
+	if (_run(MSG_QUEUE_MPSC, MPSC_PRODUCERS, MPSC_COUNT, "mpsc"))
+		return 1;
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,216 @@
+// vi:noet:sw=4 ts=4
+
+// Checks the overflow policies and the pressure levels of MSG_Queue_t in
+// common/message_queue.c, single threaded against the host heap.
+// Build and run from the top level:
+//make host && ./build/host/message_queue_test
+//
+// The queue owns what it holds, every message here carries an extra
+// reference so the test can watch the queue release the ones it drops.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "message_queue.h"
+#include "heap.h"
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+#define MSGS 6
+
+static uint32_t _free;
+static MSG_Data_t *_msg[MSGS];
+
+// a fresh message with a reference for the queue and one for the test
+static MSG_Data_t *
+_new(int i)
+{
+	_msg[i] = MSG_Base_AllocateDataAtomic(4);
+	if (_msg[i]) {
+		_msg[i]->buf[0] = i;
+		MSG_Base_AcquireDataAtomic(_msg[i]);
+	}
+	return _msg[i];
+}
+
+static int
+_pop(MSG_Queue_t *q, int i)
+{
+	MSG_QueueEntry_t e;
+	CHECK(MSG_Queue_Pop(q, &e));
+	CHECK(e.msg == _msg[i] && e.address.submodule == i);
+	MSG_Base_ReleaseDataAtomic(e.msg);
+	return 0;
+}
+
+// drops the test's references and checks nothing leaked
+static int
+_done(MSG_Queue_t *q)
+{
+	int i;
+	CHECK(MSG_Queue_Depth(q) == 0 && !MSG_Queue_Pop(q, NULL));
+	for (i = 0; i < MSGS; i++) {
+		if (_msg[i]) {
+			CHECK(_msg[i]->ref == 1);
+			MSG_Base_ReleaseDataAtomic(_msg[i]);
+			_msg[i] = NULL;
+		}
+	}
+	vPortFree(q);
+	CHECK(MSG_Base_FreeCount() == _free);
+	return 0;
+}
+
+static int
+_drop_newest(void)
+{
+	MSG_Queue_t *q = MSG_Queue_Init(4, MSG_QUEUE_SPSC);
+	MSG_QueueStats_t stats;
+	int i;
+	CHECK(q);
+	for (i = 0; i < 4; i++)
+		CHECK(MSG_Queue_Push(q, _new(i), ADDR(0, i)));
+	// a refused push leaves the reference with the caller
+	CHECK(!MSG_Queue_Push(q, _new(4), ADDR(0, 4)));
+	CHECK(_msg[4]->ref == 2);
+	MSG_Base_ReleaseDataAtomic(_msg[4]);
+	MSG_Queue_GetStats(q, &stats);
+	CHECK(stats.depth == 4 && stats.drops == 1 && stats.evictions == 0 && stats.pushed == 4);
+	for (i = 0; i < 4; i++)
+		CHECK(!_pop(q, i));
+	return _done(q);
+}
+
+static int
+_drop_oldest(void)
+{
+	MSG_Queue_t *q = MSG_Queue_Init(4, MSG_QUEUE_SPSC);
+	MSG_QueueStats_t stats;
+	int i;
+	CHECK(q);
+	MSG_Queue_SetPolicy(q, MSG_QUEUE_DROP_OLDEST);
+	for (i = 0; i < 4; i++)
+		CHECK(MSG_Queue_Push(q, _new(i), ADDR(0, i)));
+	// each push into the full queue releases the head and keeps the order
+	CHECK(MSG_Queue_Push(q, _new(4), ADDR(0, 4)));
+	CHECK(_msg[0]->ref == 1 && _msg[1]->ref == 2);
+	CHECK(MSG_Queue_Push(q, _new(5), ADDR(0, 5)));
+	CHECK(_msg[1]->ref == 1 && MSG_Queue_Depth(q) == 4);
+	MSG_Queue_GetStats(q, &stats);
+	CHECK(stats.evictions == 2 && stats.drops == 0 && stats.pushed == 6 && stats.high_water == 4);
+	for (i = 2; i < MSGS; i++)
+		CHECK(!_pop(q, i));
+	return _done(q);
+}
+
+static int
+_coalesce(void)
+{
+	MSG_Queue_t *q = MSG_Queue_Init(4, MSG_QUEUE_SPSC);
+	MSG_QueueStats_t stats;
+	MSG_QueueEntry_t e;
+	int i;
+	CHECK(q);
+	MSG_Queue_SetPolicy(q, MSG_QUEUE_COALESCE);
+	// run the indices past the wrap so the queued entries straddle it
+	for (i = 0; i < 3; i++) {
+		CHECK(MSG_Queue_Push(q, _new(0), ADDR(0, 0)));
+		CHECK(!_pop(q, 0));
+		MSG_Base_ReleaseDataAtomic(_msg[0]);
+	}
+	CHECK(MSG_Queue_PushTagged(q, _new(0), ADDR(0, 0), 7));
+	CHECK(MSG_Queue_PushTagged(q, _new(1), ADDR(0, 1), 9));
+	CHECK(MSG_Queue_Push(q, _new(2), ADDR(0, 2)));
+	CHECK(MSG_Queue_PushTagged(q, _new(3), ADDR(0, 3), 8));
+
+	// the queue is full, a known tag still gets in and replaces the entry
+	// already queued under it, in its place in line
+	CHECK(MSG_Queue_Pressure(q, 9) == MSG_QUEUE_PRESSURE_HIGH);
+	CHECK(MSG_Queue_PushTagged(q, _new(4), ADDR(0, 4), 9));
+	CHECK(_msg[1]->ref == 1 && MSG_Queue_Depth(q) == 4);
+	// untagged pushes never coalesce, an unknown tag is refused
+	CHECK(MSG_Queue_Pressure(q, MSG_QUEUE_NO_TAG) == MSG_QUEUE_PRESSURE_FULL);
+	CHECK(MSG_Queue_Pressure(q, 5) == MSG_QUEUE_PRESSURE_FULL);
+	CHECK(!MSG_Queue_PushTagged(q, _new(5), ADDR(0, 5), 5));
+	MSG_Base_ReleaseDataAtomic(_msg[5]);
+	MSG_Queue_GetStats(q, &stats);
+	CHECK(stats.coalesced == 1 && stats.drops == 1 && stats.evictions == 0);
+
+	CHECK(!_pop(q, 0));
+	CHECK(MSG_Queue_Pop(q, &e) && e.msg == _msg[4] && e.address.submodule == 4 && e.tag == 9);
+	MSG_Base_ReleaseDataAtomic(e.msg);
+	// a popped tag is gone, the next push with it queues at the end
+	CHECK(MSG_Queue_Pressure(q, 9) == MSG_QUEUE_PRESSURE_NONE);
+	CHECK(!_pop(q, 2));
+	CHECK(!_pop(q, 3));
+	return _done(q);
+}
+
+static int
+_coalesce_oldest(void)
+{
+	MSG_Queue_t *q = MSG_Queue_Init(2, MSG_QUEUE_MPSC);
+	CHECK(q);
+	MSG_Queue_SetPolicy(q, MSG_QUEUE_COALESCE | MSG_QUEUE_DROP_OLDEST);
+	CHECK(MSG_Queue_PushTagged(q, _new(0), ADDR(0, 0), 1));
+	CHECK(MSG_Queue_PushTagged(q, _new(1), ADDR(0, 1), 2));
+	// a new tag evicts the head, a queued one replaces in place
+	CHECK(MSG_Queue_Pressure(q, 3) == MSG_QUEUE_PRESSURE_HIGH);
+	CHECK(MSG_Queue_PushTagged(q, _new(2), ADDR(0, 2), 3));
+	CHECK(_msg[0]->ref == 1);
+	CHECK(MSG_Queue_PushTagged(q, _new(3), ADDR(0, 3), 2));
+	CHECK(_msg[1]->ref == 1);
+	// the evicted tag went with its entry
+	CHECK(MSG_Queue_PushTagged(q, _new(4), ADDR(0, 4), 1));
+	CHECK(_msg[3]->ref == 1);
+	CHECK(!_pop(q, 2));
+	CHECK(!_pop(q, 4));
+	return _done(q);
+}
+
+// NONE below 3/4, HIGH from 3/4 on, FULL or HIGH when full depending on policy
+static int
+_pressure(void)
+{
+	static const uint8_t capacities[] = { 1, 2, 4, 8, 16 };
+	unsigned c;
+	for (c = 0; c < sizeof(capacities); c++) {
+		uint8_t cap = capacities[c];
+		uint8_t high = cap - cap / 4;
+		MSG_Queue_t *q = MSG_Queue_Init(cap, MSG_QUEUE_SPSC);
+		MSG_Data_t *m = MSG_Base_AllocateDataAtomic(4);
+		unsigned depth;
+		CHECK(q && m);
+		for (depth = 0; depth <= cap; depth++) {
+			MSG_QueuePressure want = depth == cap ? MSG_QUEUE_PRESSURE_FULL
+			    : depth >= high ? MSG_QUEUE_PRESSURE_HIGH : MSG_QUEUE_PRESSURE_NONE;
+			CHECK(MSG_Queue_Pressure(q, MSG_QUEUE_NO_TAG) == want);
+			if (depth < cap) {
+				MSG_Base_AcquireDataAtomic(m);
+				CHECK(MSG_Queue_Push(q, m, ADDR(0, 0)));
+			}
+		}
+		MSG_Queue_SetPolicy(q, MSG_QUEUE_DROP_OLDEST);
+		CHECK(MSG_Queue_Pressure(q, MSG_QUEUE_NO_TAG) == MSG_QUEUE_PRESSURE_HIGH);
+		while (MSG_Queue_Pop(q, NULL))
+			MSG_Base_ReleaseDataAtomic(m);
+		CHECK(m->ref == 1);
+		MSG_Base_ReleaseDataAtomic(m);
+		if (_done(q))
+			return 1;
+	}
+	CHECK(!MSG_Queue_Init(0, MSG_QUEUE_SPSC) && !MSG_Queue_Init(3, MSG_QUEUE_SPSC));
+	CHECK(!MSG_Queue_Init(129, MSG_QUEUE_SPSC));
+	return 0;
+}
+
+int main()
+{
+	// the heap takes its own header out of the free count on first use
+	MSG_Base_ReleaseDataAtomic(MSG_Base_AllocateDataAtomic(200));
+	_free = MSG_Base_FreeCount();
+	if (_drop_newest() || _drop_oldest() || _coalesce() || _coalesce_oldest() || _pressure())
+		return 1;
+	printf("message queue: drop newest, drop oldest, coalesce and pressure ok\n");
+	return 0;
+}
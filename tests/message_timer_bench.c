@@ -0,0 +1,111 @@
+// vi:noet:sw=4 ts=4
+
+// Counts rtc wakeups for the pill's periodic work, once with an app_timer per
+// job like the original firmware and once through the central's timed dispatch.
+// Build and run from the top level:
+//make host && ./build/host/message_timer_bench
+//
+// Ticks follow the pill, APP_TIMER_PRESCALER 255 (128 ticks per second). The
+// separate timers are started at staggered times, as they are at boot.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "message_app.h"
+#include "message_base.h"
+
+#define TICKS_PER_SEC 128
+#define HOUR (3600 * TICKS_PER_SEC)
+
+static const struct {
+	const char *name;
+	uint32_t period;
+	uint32_t start;		// when the module starts its timer
+} _jobs[] = {
+	{ "1sec", TICKS_PER_SEC, 3 },
+	{ "1min", 60 * TICKS_PER_SEC, 5 },
+	{ "imu wom", TICKS_PER_SEC / 2, 40 },
+	{ "prox", 15 * TICKS_PER_SEC, 77 },
+};
+#define NUM_JOBS (sizeof(_jobs) / sizeof(_jobs[0]))
+
+static MSG_Central_t *central;
+static uint32_t _runs[NUM_JOBS];
+
+static void _timer_handler(void *ctx)
+{
+	_runs[(uintptr_t)ctx]++;
+}
+
+static MSG_Status _ok(void) { return SUCCESS; }
+
+static MSG_Status
+_time_send(MSG_Address_t src, MSG_Address_t dst, MSG_Data_t *data)
+{
+	_runs[dst.submodule]++;
+	return SUCCESS;
+}
+
+static MSG_Base_t _time = { TIME, "TIME", _ok, _ok, _ok, _time_send };
+
+static uint32_t
+_total_runs(void)
+{
+	uint32_t total = 0, i;
+	for (i = 0; i < NUM_JOBS; i++) {
+		total += _runs[i];
+		_runs[i] = 0;
+	}
+	return total;
+}
+
+int main()
+{
+	app_timer_id_t timers[NUM_JOBS];
+	uint32_t wakeups, runs, elapsed = 0;
+	uint8_t handles[NUM_JOBS];
+	uint32_t i;
+
+	APP_SCHED_INIT(sizeof(void *), 16);
+	central = MSG_App_Central(NULL);
+	central->loadmod(MSG_App_Base(central));
+	central->loadmod(&_time);
+
+	// one app_timer per job
+	for (i = 0; i < NUM_JOBS; i++) {
+		app_timer_host_advance(_jobs[i].start - elapsed);
+		elapsed = _jobs[i].start;
+		app_timer_create(&timers[i], APP_TIMER_MODE_REPEATED, _timer_handler);
+		app_timer_start(timers[i], _jobs[i].period, (void *)(uintptr_t)i);
+	}
+	wakeups = app_timer_host_wakeups();
+	app_timer_host_advance(HOUR);
+	wakeups = app_timer_host_wakeups() - wakeups;
+	runs = _total_runs();
+	printf("separate app_timers: %u wakeups/hour for %u runs\n", wakeups, runs);
+	for (i = 0; i < NUM_JOBS; i++)
+		app_timer_stop(timers[i]);
+
+	// everything through the central's wheel, started at the same staggered times
+	elapsed = 0;
+	for (i = 0; i < NUM_JOBS; i++) {
+		app_timer_host_advance(_jobs[i].start - elapsed);
+		elapsed = _jobs[i].start;
+		handles[i] = central->dispatch_every(ADDR(TIME, 0), ADDR(TIME, i), NULL, _jobs[i].period);
+		if (handles[i] == MSG_TIMED_NONE) {
+			printf("out of timed slots\n");
+			return 1;
+		}
+	}
+	wakeups = app_timer_host_wakeups();
+	for (elapsed = 0; elapsed < HOUR; elapsed += TICKS_PER_SEC) {
+		app_timer_host_advance(TICKS_PER_SEC);
+		app_sched_execute();
+	}
+	wakeups = app_timer_host_wakeups() - wakeups;
+	runs = _total_runs();
+	printf("timed dispatch:      %u wakeups/hour for %u runs\n", wakeups, runs);
+	for (i = 0; i < NUM_JOBS; i++)
+		central->cancel(handles[i]);
+	return 0;
+}
@@ -0,0 +1,201 @@
+// vi:noet:sw=4 ts=4
+
+// Compares the pill's per-sample motion aggregation (a division per axis per
+// sample) against the batch kernel in pill/motion_accumulate.c, fed with the
+// recorded imu streams in tests/data/sensor_data.
+// Build and run from the top level:
+//make host && ./build/host/motion_accumulate_bench tests/data/sensor_data/*.bin
+//
+// Samples are replayed as fifo drains of IMU_FIFO_CAPACITY_SAMPLES and a
+// minute is closed every MINUTE_SAMPLES samples. Only imu profile records
+// (type 0-3) are used, the type 9 files carry phone metadata.
+// The host has a hardware divider, the nRF51 calls a library routine for
+// every division, so the per-drain division count matters more than the
+// host speedup.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sensor_data.h"
+#include "motion_accumulate.h"
+
+#define FIFO_SAMPLES 32		// IMU_FIFO_CAPACITY_BYTES / 6
+#define MINUTE_SAMPLES 600	// 10Hz
+#define ROUNDS 20000
+
+static int16_t *_xyz;
+static uint32_t _samples;
+
+// tf_unit_t fields the aggregation touches
+static struct {
+	uint32_t max_amp;
+	int16_t avg_accel[3];
+	uint32_t num_meas;
+} _old;
+
+static struct {
+	uint32_t max_amp;
+	int32_t sum_accel[3];
+	uint32_t num_meas;
+} _new;
+
+static uint32_t _divisions;
+
+// _aggregate_motion_data as it was in pill/message_imu.c
+static uint32_t
+_aggregate_motion_data(const int16_t *raw_xyz, size_t len)
+{
+	int16_t values[3];
+	memcpy(values, raw_xyz, len);
+	uint32_t aggregate = values[0] * values[0] + values[1] * values[1] + values[2] * values[2];
+	++_old.num_meas;
+	if (_old.max_amp < aggregate)
+		_old.max_amp = aggregate;
+	for (int i = 0; i < 3; ++i)
+		_old.avg_accel[i] += (values[i] - _old.avg_accel[i]) / (int32_t)_old.num_meas;
+	return aggregate;
+}
+
+static uint32_t _sink;
+
+static void
+_drain_old(const int16_t *ptr, uint32_t n)
+{
+	uint32_t i;
+	for (i = 0; i < n; i++) {
+		_sink += _aggregate_motion_data(ptr, 3 * sizeof(int16_t));
+		ptr += 3;
+	}
+	_divisions += 3 * n;
+}
+
+static void
+_drain_new(const int16_t *ptr, uint32_t n)
+{
+	uint32_t mags[FIFO_SAMPLES];
+	motion_block_t block;
+	uint32_t i;
+	motion_accumulate_block(ptr, n, mags, &block);
+	for (i = 0; i < 3; i++)
+		_new.sum_accel[i] += block.sum[i];
+	_new.num_meas += n;
+	if (_new.max_amp < block.max_mag)
+		_new.max_amp = block.max_mag;
+	for (i = 0; i < n; i++)
+		_sink += mags[i];
+}
+
+static int
+_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	struct sensor_data_header h;
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fread(&h, sizeof(h), 1, f) == 1) {
+		uint8_t *payload;
+		if (h.signature != 0x55AA) {
+			fprintf(stderr, "%s: bad signature\n", path);
+			break;
+		}
+		payload = malloc(h.size);
+		if (!payload || fread(payload, 1, h.size, f) != h.size) {
+			free(payload);
+			break;
+		}
+		if (h.type <= SENSOR_DATA_IMU_PROFILE_3) {
+			uint32_t n = h.size / 6;
+			_xyz = realloc(_xyz, (_samples + n) * 6);
+			memcpy(_xyz + 3 * _samples, payload, n * 6);
+			_samples += n;
+		}
+		free(payload);
+	}
+	fclose(f);
+	return 0;
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// replays the stream once, closing minutes along the way
+static uint32_t
+_replay(void (*drain)(const int16_t *, uint32_t), int16_t *worst_error)
+{
+	uint32_t off = 0, in_minute = 0, drains = 0;
+	while (off < _samples) {
+		uint32_t n = _samples - off < FIFO_SAMPLES ? _samples - off : FIFO_SAMPLES;
+		drain(_xyz + 3 * off, n);
+		off += n;
+		in_minute += n;
+		drains++;
+		if (in_minute >= MINUTE_SAMPLES || off == _samples) {
+			if (worst_error) {
+				int16_t mean[3];
+				int i;
+				motion_accumulate_mean(_new.sum_accel, _new.num_meas, mean);
+				for (i = 0; i < 3; i++) {
+					int16_t e = abs(mean[i] - _old.avg_accel[i]);
+					if (e > *worst_error)
+						*worst_error = e;
+				}
+			}
+			memset(&_old, 0, sizeof(_old));
+			memset(&_new, 0, sizeof(_new));
+			in_minute = 0;
+		}
+	}
+	return drains;
+}
+
+// old and new side by side on the same drains, for the accuracy check
+static void
+_drain_both(const int16_t *ptr, uint32_t n)
+{
+	_drain_old(ptr, n);
+	_drain_new(ptr, n);
+}
+
+int main(int argc, char **argv)
+{
+	double start, t_old, t_new;
+	uint32_t drains = 0, i;
+	int16_t worst_error = 0;
+
+	for (i = 1; i < (uint32_t)argc; i++)
+		_load(argv[i]);
+	if (!_samples) {
+		fprintf(stderr, "usage: %s tests/data/sensor_data/*.bin\n", argv[0]);
+		return 1;
+	}
+
+	_replay(_drain_both, &worst_error);
+	_divisions = 0;
+
+	start = _now();
+	for (i = 0; i < ROUNDS; i++)
+		drains += _replay(_drain_old, NULL);
+	t_old = _now() - start;
+
+	start = _now();
+	for (i = 0; i < ROUNDS; i++)
+		_replay(_drain_new, NULL);
+	t_new = _now() - start;
+
+	printf("motion accumulation, %u samples in %u fifo drains per replay\n", _samples, drains / ROUNDS);
+	printf("  per-sample loop  %.1f ns per drain, %u divisions per drain\n", t_old * 1e9 / drains, _divisions / drains);
+	printf("  batch kernel     %.1f ns per drain, 1 division per minute\n", t_new * 1e9 / drains);
+	printf("  speedup          %.1fx\n", t_old / t_new);
+	printf("  worst mean difference vs running average: %d counts\n", worst_error);
+	return _sink == 0;
+}
@@ -0,0 +1,253 @@
+// vi:noet:sw=4 ts=4
+
+// Replays recorded imu streams through the pill's motion pipeline as it runs on
+// the pill: fifo drains go into TF_AccumulateSamples and ShakeDetect, the imu
+// active timer ticks ShakeDetectDecWindow and every minute TF_GetCondensed
+// builds the MotionPayload_t that goes out over ant, TF_GetFeatures the packed
+// feature payload. The feature payload is unpacked again and checked against
+// the plain one.
+// Build and run from the top level:
+//make host && ./build/host/motion_replay -s 10 tests/data/sensor_data/*.bin attic/kodobannin.old/compression_research/imu.bin
+//make host && ./build/host/motion_replay -b tests/data/sensor_data/*.bin attic/kodobannin.old/compression_research/imu.bin
+//
+// Without -b one line per minute is printed, tests/data/motion_replay.golden
+// holds the expected output and make host-bench diffs against it. Change the
+// golden file in the same commit as anything that is meant to change payloads.
+// With -b the replay is repeated and the cost per sample is reported instead.
+// -s shortens the simulated minute, the captures are only seconds long and the
+// payload compares each minute against the previous one.
+//
+// Files that start with a sensor_data_header are read as records, only the imu
+// profile records (type 0-3) are used. Anything else is read as the raw accel +
+// gyro records of the MPU-6500 captures in the attic. Each file is a session of
+// its own, the last partial minute is closed at the end of the file.
+// Time is simulated from the sample index at IMU_ACTIVE_FREQ. The wake up
+// interrupt that sets the motion mask is stood in for by REPLAY_WOM_COUNTS.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sensor_data.h"
+#include "timedfifo.h"
+#include "shake_detect.h"
+#include "motion_features.h"
+
+#define REPLAY_HZ 25				// IMU_HZ_25
+#define REPLAY_FIFO_SAMPLES 28		// IMU_WTM_DEEP, the watermark while nothing is going on
+#define REPLAY_TICK_SAMPLES (REPLAY_HZ / 2)	// IMU_ACTIVE_INTERVAL, 500ms
+#define REPLAY_WOM_COUNTS 1024		// sample to sample change on any axis that counts as motion, 1/16g
+#define ROUNDS 20000
+
+extern int host_uart_quiet;		// tests/host/host_stubs.c
+
+typedef struct {
+	const char *name;
+	int16_t *xyz;
+	uint32_t samples;
+} stream_t;
+
+static stream_t _streams[16];
+static uint32_t _num_streams;
+static uint32_t _shakes;
+static uint32_t _minute_samples = 60 * REPLAY_HZ;
+
+static void
+_append(stream_t *s, const int16_t *xyz, uint32_t n)
+{
+	s->xyz = realloc(s->xyz, (s->samples + n) * 6);
+	memcpy(s->xyz + 3 * s->samples, xyz, n * 6);
+	s->samples += n;
+}
+
+static int
+_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	stream_t *s = &_streams[_num_streams];
+	struct sensor_data_header h;
+	uint16_t signature = 0;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	if (_num_streams == sizeof(_streams) / sizeof(_streams[0])) {
+		fprintf(stderr, "%s: too many files\n", path);
+		fclose(f);
+		return -1;
+	}
+	s->name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+
+	if (fread(&signature, sizeof(signature), 1, f) == 1 && signature == 0x55AA) {
+		rewind(f);
+		while (fread(&h, sizeof(h), 1, f) == 1 && h.signature == 0x55AA) {
+			uint8_t *payload = malloc(h.size);
+			if (!payload || fread(payload, 1, h.size, f) != h.size) {
+				free(payload);
+				break;
+			}
+			if (h.type <= SENSOR_DATA_IMU_PROFILE_3)
+				_append(s, (int16_t *)payload, h.size / 6);
+			free(payload);
+		}
+	} else {
+		int16_t record[6];
+		rewind(f);
+		while (fread(record, sizeof(record), 1, f) == 1)
+			_append(s, record, 1);
+	}
+	fclose(f);
+	if (s->samples)
+		_num_streams++;
+	return 0;
+}
+
+static void
+_on_shake(void)
+{
+	_shakes++;
+}
+
+static bool
+_moved(const int16_t *prev, const int16_t *xyz, uint32_t n)
+{
+	uint32_t i, k;
+	for (i = 0; i < n; i++, prev = xyz, xyz += 3)
+		for (k = 0; k < 3; k++)
+			if (abs(xyz[k] - prev[k]) > REPLAY_WOM_COUNTS)
+				return true;
+	return false;
+}
+
+static uint8_t
+_popcount(uint64_t v)
+{
+	uint8_t n = 0;
+	for (; v; v &= v - 1)
+		n++;
+	return n;
+}
+
+static void
+_close_minute(const stream_t *s, uint32_t minute, bool print)
+{
+	MotionPayload_t payload;
+	MotionFeaturesPayload_t features;
+	motion_summary_t f;
+
+	if (TF_GetCondensed(&payload)) {
+		if (!TF_GetFeatures(&features)) {
+			fprintf(stderr, "%s minute %u: features without a payload\n", s->name, minute);
+			exit(1);
+		}
+		motion_features_unpack(features.packed, &f);
+		if (f.max != payload.max || f.cos_theta != payload.cos_theta || f.motion_seconds != _popcount(payload.motion_mask)) {
+			fprintf(stderr, "%s minute %u: feature payload does not match\n", s->name, minute);
+			exit(1);
+		}
+		if (print) {
+			printf("%s minute %u: max %u cos_theta %u mask %016llx shakes %u\n", s->name, minute,
+					payload.max, payload.cos_theta, (unsigned long long)payload.motion_mask, _shakes);
+			printf("  coarse %04x active %u still %u energy %u/%u/%u crossings %u turns %u\n", f.coarse_mask,
+					f.active_seconds, f.longest_still, f.energy_p50, f.energy_p90, f.energy_max,
+					f.crossings, f.orientation_changes);
+		}
+	} else if (print) {
+		printf("%s minute %u: no motion, shakes %u\n", s->name, minute, _shakes);
+	}
+	TF_TickOneMinute();
+}
+
+// one session, drains as the fifo watermark would deliver them
+static void
+_replay(const stream_t *s, bool print)
+{
+	uint32_t mags[REPLAY_FIFO_SAMPLES];
+	uint32_t off = 0, minute = 0, minute_start = 0, next_tick = REPLAY_TICK_SAMPLES;
+
+	TF_Initialize();
+	ShakeDetectReset(SHAKING_MOTION_THRESHOLD);
+	_shakes = 0;
+
+	while (off < s->samples) {
+		uint32_t n = s->samples - off < REPLAY_FIFO_SAMPLES ? s->samples - off : REPLAY_FIFO_SAMPLES;
+		const int16_t *xyz = s->xyz + 3 * off;
+		uint32_t i;
+
+		// the minute timer fires between drains
+		if (n > minute_start + _minute_samples - off)
+			n = minute_start + _minute_samples - off;
+
+		TF_AccumulateSamples(xyz, n, mags);
+		for (i = 0; i < n; i++)
+			ShakeDetect(mags[i]);
+		if (_moved(off ? xyz - 3 : xyz, xyz, n))
+			TF_GetCurrent()->motion_mask |= 1ull << (((off + n - 1 - minute_start) / REPLAY_HZ) % 60);
+		off += n;
+
+		while (off >= next_tick) {
+			ShakeDetectDecWindow();
+			next_tick += REPLAY_TICK_SAMPLES;
+		}
+		if (off - minute_start == _minute_samples || off == s->samples) {
+			_close_minute(s, minute++, print);
+			minute_start = off;
+		}
+	}
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	bool bench = false;
+	uint32_t i, r, samples = 0;
+	double start, elapsed;
+	int argi = 1;
+
+	for (; argi < argc && argv[argi][0] == '-'; argi++) {
+		if (!strcmp(argv[argi], "-b"))
+			bench = true;
+		else if (!strcmp(argv[argi], "-s") && argi + 1 < argc && atoi(argv[argi + 1]) > 0)
+			_minute_samples = atoi(argv[++argi]) * REPLAY_HZ;
+		else
+			break;
+	}
+	for (; argi < argc; argi++)
+		_load(argv[argi]);
+	if (!_num_streams) {
+		fprintf(stderr, "usage: %s [-b] [-s seconds per minute] tests/data/sensor_data/*.bin ...\n", argv[0]);
+		return 1;
+	}
+
+	host_uart_quiet = 1;
+	set_shake_detection_callback(_on_shake);
+
+	if (!bench) {
+		for (i = 0; i < _num_streams; i++)
+			_replay(&_streams[i], true);
+		return 0;
+	}
+
+	for (i = 0; i < _num_streams; i++)
+		samples += _streams[i].samples;
+	start = _now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < _num_streams; i++)
+			_replay(&_streams[i], false);
+	elapsed = _now() - start;
+
+	printf("motion replay, %u samples in %u sessions\n", samples, _num_streams);
+	printf("  %.1f ns per sample, drains of %u, minute payload included\n",
+			elapsed * 1e9 / ((double)samples * ROUNDS), REPLAY_FIFO_SAMPLES);
+	return 0;
+}
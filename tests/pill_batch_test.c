@@ -0,0 +1,225 @@
+// vi:noet:sw=4 ts=4
+
+// Builds batched_pill_data frames with morpheus/pill_batch.c the way
+// ant_user.c does with ANT_PILL_BATCHING, decodes them again and compares
+// them against one MorpheusCommand per pill message.
+// Build and run from the top level:
+//make host && ./build/host/pill_batch_test
+//
+// The traffic is a window of pill messages as morpheus sees it: motion from a
+// few pills, the odd heartbeat, and a pill sending its stored minutes back to
+// back. Per message frames carry the pill's device id twice (deviceId and
+// pill_data.device_id) like _handle_pill encodes them. Every frame is one sspi
+// transaction and one wakeup of the cc3200.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "message_base.h"
+#include "pb_encode.h"
+#include "pb_decode.h"
+#include "morpheus_ble.pb.h"
+#include "pill_batch.h"
+
+#define PILL_BATCH_SIZE 192		// morpheus/app.h
+#define SSPI_CONTEXT 4			// length and address ahead of every sspi payload
+#define ROUNDS 20000
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static const char *_sense_id = "0123456789ABCDEF";
+
+typedef struct {
+	uint8_t pill;
+	uint8_t heartbeat;
+} traffic_t;
+
+// one pill every few seconds, pill 2 flushing 5 stored minutes in one go
+static const traffic_t _window[] = {
+	{ 0, 0 }, { 1, 0 }, { 2, 0 }, { 2, 0 }, { 2, 0 }, { 2, 0 }, { 2, 0 },
+	{ 3, 0 }, { 1, 1 }, { 4, 0 }, { 5, 0 }, { 0, 1 },
+};
+#define WINDOW (sizeof(_window) / sizeof(_window[0]))
+
+static void
+_fill(pill_data *pd, const traffic_t *t, uint32_t n)
+{
+	uint32_t i;
+	memset(pd, 0, sizeof(*pd));
+	snprintf(pd->device_id, sizeof(pd->device_id), "%016llX", 0x8C1D5E7A00000000ull + t->pill);
+	pd->has_rssi = true;
+	pd->rssi = -60 - t->pill;
+	pd->has_protocol_version = true;
+	if (t->heartbeat) {
+		pd->protocol_version = 4;
+		pd->has_battery_level = true;
+		pd->battery_level = 87;
+		pd->has_uptime = true;
+		pd->uptime = 123456 + n;
+		pd->has_firmware_build = true;
+		pd->firmware_build = 7;
+	} else {
+		// nonce and a MotionRecord_t
+		pd->protocol_version = 6;
+		pd->has_motion_data_entrypted = true;
+		pd->motion_data_entrypted.size = 20;
+		for (i = 0; i < 20; i++)
+			pd->motion_data_entrypted.bytes[i] = (uint8_t)(n * 31 + i * 7);
+	}
+}
+
+static bool
+_encode_string(pb_ostream_t *stream, const pb_field_t *field, void *const *arg)
+{
+	const char *str = *arg;
+	return pb_encode_tag_for_field(stream, field) && pb_encode_string(stream, (const uint8_t *)str, strlen(str));
+}
+
+// what _handle_pill publishes for one message today
+static size_t
+_encode_single(const pill_data *pd, uint8_t *buf, size_t len)
+{
+	MorpheusCommand c;
+	pb_ostream_t stream = pb_ostream_from_buffer(buf, len);
+	memset(&c, 0, sizeof(c));
+	c.version = 0;
+	c.type = pd->has_battery_level ? MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_HEARTBEAT
+			: MorpheusCommand_CommandType_MORPHEUS_COMMAND_PILL_DATA;
+	c.deviceId.funcs.encode = _encode_string;
+	c.deviceId.arg = (void *)pd->device_id;
+	c.has_pill_data = true;
+	c.pill_data = *pd;
+	return pb_encode(&stream, MorpheusCommand_fields, &c) ? stream.bytes_written : 0;
+}
+
+typedef struct {
+	pill_data entries[WINDOW];
+	uint32_t count;
+	char device_id[17];
+} decoded_t;
+
+static bool
+_decode_pill(pb_istream_t *stream, const pb_field_t *field, void **arg)
+{
+	decoded_t *d = *arg;
+	if (d->count == WINDOW)
+		return false;
+	return pb_decode(stream, pill_data_fields, &d->entries[d->count++]);
+}
+
+static bool
+_decode_id(pb_istream_t *stream, const pb_field_t *field, void **arg)
+{
+	decoded_t *d = *arg;
+	size_t len = stream->bytes_left;
+	if (len >= sizeof(d->device_id))
+		return false;
+	d->device_id[len] = 0;
+	return pb_read(stream, (uint8_t *)d->device_id, len);
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// one closed frame as the cc3200 gets it, decoded into d when given
+static void
+_emit(MSG_Data_t *frame, uint32_t *bytes, decoded_t *d)
+{
+	batched_pill_data b;
+	pb_istream_t stream;
+
+	*bytes += frame->len + SSPI_CONTEXT;
+	if (d) {
+		stream = pb_istream_from_buffer(MSG_Base_Buffer(frame), frame->len);
+		memset(&b, 0, sizeof(b));
+		b.pills.funcs.decode = _decode_pill;
+		b.pills.arg = d;
+		b.device_id.funcs.decode = _decode_id;
+		b.device_id.arg = d;
+		if (!pb_decode(&stream, batched_pill_data_fields, &b) || strcmp(d->device_id, _sense_id))
+			d->count = WINDOW + 1;
+	}
+	MSG_Base_ReleaseDataAtomic(frame);
+}
+
+// batches the window like _batch_pill, returns the number of frames
+static uint32_t
+_run_batched(uint32_t *bytes, decoded_t *d)
+{
+	pill_batch_t batch;
+	pill_data pd;
+	uint32_t i, frames = 0;
+
+	*bytes = 0;
+	if (d)
+		memset(d, 0, sizeof(*d));
+	pill_batch_open(&batch, PILL_BATCH_SIZE, _sense_id);
+	for (i = 0; i < WINDOW; i++) {
+		_fill(&pd, &_window[i], i);
+		if (pill_batch_add(&batch, batched_pill_data_pills_tag, &pd) == -1) {
+			_emit(pill_batch_close(&batch), bytes, d);
+			frames++;
+			pill_batch_open(&batch, PILL_BATCH_SIZE, _sense_id);
+			pill_batch_add(&batch, batched_pill_data_pills_tag, &pd);
+		}
+	}
+	_emit(pill_batch_close(&batch), bytes, d);
+	return frames + 1;
+}
+
+int main()
+{
+	static decoded_t d;
+	pill_batch_t batch;
+	pill_data pd;
+	uint8_t buf[pill_data_size + 64];
+	uint32_t i, r, single_bytes = 0, batched_bytes, frames;
+	double start, single_time, batched_time;
+	size_t free_bytes;
+
+	// empty frames are not sent, unknown tags are refused
+	CHECK(pill_batch_open(&batch, PILL_BATCH_SIZE, _sense_id));
+	CHECK(!pill_batch_close(&batch));		// nothing added, nothing sent
+	CHECK(pill_batch_open(&batch, PILL_BATCH_SIZE, _sense_id));
+	CHECK(pill_batch_add(&batch, 9, &pd) == -2);
+	pill_batch_close(&batch);
+	free_bytes = MSG_Base_FreeCount();		// the pool arena is carved out on first use
+
+	frames = _run_batched(&batched_bytes, &d);
+	CHECK(d.count == WINDOW);
+	for (i = 0; i < WINDOW; i++) {
+		_fill(&pd, &_window[i], i);
+		CHECK(!memcmp(&pd, &d.entries[i], sizeof(pd)));
+	}
+	CHECK(MSG_Base_FreeCount() == free_bytes);	// frames and views all released
+	printf("pill batch: %u messages round trip in %u frames\n", (unsigned)WINDOW, frames);
+
+	for (i = 0; i < WINDOW; i++) {
+		_fill(&pd, &_window[i], i);
+		single_bytes += _encode_single(&pd, buf, sizeof(buf)) + SSPI_CONTEXT;
+	}
+	printf("  per message: %u sspi transactions, %u bytes\n", (unsigned)WINDOW, single_bytes);
+	printf("  batched:     %u sspi transactions, %u bytes, frames of %u\n", frames, batched_bytes, PILL_BATCH_SIZE);
+
+	start = _now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < WINDOW; i++) {
+			_fill(&pd, &_window[i], i);
+			_encode_single(&pd, buf, sizeof(buf));	// _handle_pill sizes first, then encodes
+			_encode_single(&pd, buf, sizeof(buf));
+		}
+	single_time = _now() - start;
+	start = _now();
+	for (r = 0; r < ROUNDS; r++)
+		_run_batched(&batched_bytes, NULL);
+	batched_time = _now() - start;
+	printf("  encode per message: %.2f us single, %.2f us batched on this host\n",
+			single_time * 1e6 / (ROUNDS * WINDOW), batched_time * 1e6 / (ROUNDS * WINDOW));
+	return 0;
+}
@@ -0,0 +1,193 @@
+// vi:noet:sw=4 ts=4
+
+// Runs the interrupt driven SPI engine in common/spi.c against the SPI master
+// model in tests/host/nrf_spi.c, with a LIS2DH style register file on the bus.
+// Build and run from the top level:
+//make host && ./build/host/spi_async_test
+//
+// Checks ordering, chip select framing, received data and resubmission from the
+// completion callback, then times the engine per byte. The bus model clocks one
+// byte per step, so timings are the cpu cost of the engine and not of the bus.
+// It counts a stall whenever a byte of a frame had nothing queued behind it in
+// TXD, the engine keeps the double buffer full so there should be none.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf51.h"
+#include "nrf_gpio.h"
+#include "spi.h"
+
+#define CS_PIN 6
+#define FIFO_BYTES 192			// 32 samples of x, y, z
+#define SPI_BYTE_US 8			// one byte at 1 Mbps, what spi_one_byte spins for
+#define ROUNDS 200000
+
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+static uint8_t _regs[128];
+static uint8_t _addr;
+static uint8_t _read;
+static uint8_t _multi;
+
+// lis2dh: first byte is the register, bit 7 reads, bit 6 auto increments
+static uint8_t
+_lis2dh(uint8_t mosi, int first)
+{
+	uint8_t miso = 0xFF;
+	if (first) {
+		_addr = mosi & 0x3F;
+		_read = mosi & 0x80;
+		_multi = mosi & 0x40;
+		return miso;
+	}
+	if (_read)
+		miso = _regs[_addr];
+	else
+		_regs[_addr] = mosi;
+	if (_multi)
+		_addr = (_addr + 1) & 0x7F;
+	return miso;
+}
+
+static struct {
+	uint8_t order[8];
+	int32_t result[8];
+	uint32_t count;
+} _done;
+
+static void
+_on_done(int32_t result, void *ctx)
+{
+	if (_done.count < sizeof(_done.order)) {
+		_done.order[_done.count] = (uint8_t)(uintptr_t)ctx;
+		_done.result[_done.count] = result;
+	}
+	_done.count++;
+}
+
+static uint32_t
+_run_bus(void)
+{
+	uint32_t bytes = 0;
+	while (nrf_spi_host_step(NRF_SPI0))
+		bytes++;
+	return bytes;
+}
+
+// resubmits itself from the callback until the count runs out
+static spi_transaction_t _chain;
+static uint32_t _chain_left;
+
+static void
+_on_chain(int32_t result, void *ctx)
+{
+	if (result > 0 && _chain_left && --_chain_left)
+		spi_xfer_async(&_chain);
+}
+
+static double
+_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+	SPI_Context ctx, ctx1;
+	uint8_t wr[2] = { SPI_Write(0x20), 0x57 };
+	uint8_t rd_fifo = SPI_Read(0x28) | 0x40;
+	uint8_t rd_ctrl = SPI_Read(0x20);
+	uint8_t fifo[FIFO_BYTES], ctrl = 0;
+	spi_transaction_t t[3] = {
+		{ .ctx = &ctx, .tx = wr, .tx_len = sizeof(wr), .done = _on_done, .done_ctx = (void *)0 },
+		{ .ctx = &ctx, .tx = &rd_fifo, .tx_len = 1, .rx = fifo, .rx_len = sizeof(fifo), .done = _on_done, .done_ctx = (void *)1 },
+		{ .ctx = &ctx, .tx = &rd_ctrl, .tx_len = 1, .rx = &ctrl, .rx_len = 1, .done = _on_done, .done_ctx = (void *)2 },
+	};
+	uint32_t i, bytes, irqs, releases;
+	double start, elapsed;
+
+	CHECK(spi_init(SPI_Channel_0, SPI_Mode3, 1, 2, 3, CS_PIN, &ctx) == 0);
+	nrf_gpio_pin_set(CS_PIN);
+	nrf_spi_host_attach(NRF_SPI0, CS_PIN, _lis2dh);
+	for (i = 0; i < sizeof(_regs); i++)
+		_regs[i] = (uint8_t)(i * 7 + 1);
+
+	// rejected up front
+	{
+		spi_transaction_t empty = { .ctx = &ctx, .done = _on_done };
+		spi_transaction_t no_rx = { .ctx = &ctx, .rx_len = 4, .done = _on_done };
+		CHECK(spi_xfer_async(NULL) < 0);
+		CHECK(spi_xfer_async(&empty) < 0);
+		CHECK(spi_xfer_async(&no_rx) < 0);
+		CHECK(spi_init(SPI_Channel_1, SPI_Mode3, 1, 2, 3, CS_PIN + 1, &ctx1) == 0);
+		empty.ctx = &ctx1;
+		empty.tx = wr;
+		empty.tx_len = 1;
+		CHECK(spi_xfer_async(&empty) == -2);	// no vector for SPI1
+	}
+
+	// three queued before the bus moves, they complete in order with cs framing each one
+	releases = nrf_gpio_host_rising_edges[CS_PIN];
+	for (i = 0; i < 3; i++)
+		CHECK(spi_xfer_async(&t[i]) == 0);
+	CHECK(!(nrf_gpio_host_out & (1 << CS_PIN)));
+	CHECK(spi_command(&ctx, 0, NULL, 1, wr, 0, NULL) == -3);	// polling would eat READY
+	bytes = _run_bus();
+	CHECK(bytes == 2 + 1 + FIFO_BYTES + 1 + 1);
+	CHECK(nrf_spi_host_irqs(NRF_SPI0) == bytes);
+	CHECK(!nrf_spi_host_stalls(NRF_SPI0));
+	CHECK(_done.count == 3);
+	for (i = 0; i < 3; i++)
+		CHECK(_done.order[i] == i);
+	CHECK(_done.result[0] == 2 && _done.result[1] == FIFO_BYTES && _done.result[2] == 1);
+	CHECK(nrf_gpio_host_rising_edges[CS_PIN] - releases == 3);
+	CHECK(nrf_gpio_host_out & (1 << CS_PIN));
+	CHECK(ctrl == 0x57 && _regs[0x20] == 0x57);
+	for (i = 0; i < FIFO_BYTES; i++)
+		CHECK(fifo[i] == _regs[(0x28 + i) & 0x7F]);
+
+	// resubmitted from the callback, the engine never goes idle in between
+	_chain = t[2];
+	_chain.done = _on_chain;
+	_chain_left = 5;
+	releases = nrf_gpio_host_rising_edges[CS_PIN];
+	CHECK(spi_xfer_async(&_chain) == 0);
+	bytes = _run_bus();
+	CHECK(bytes == 5 * 2);
+	CHECK(nrf_gpio_host_rising_edges[CS_PIN] - releases == 5);
+
+	// blocking wrapper, sd_app_evt_wait on the host steps the bus
+	memset(fifo, 0, sizeof(fifo));
+	CHECK(spi_xfer_wait(&ctx, 1, &rd_fifo, FIFO_BYTES, fifo) == FIFO_BYTES);
+	CHECK(fifo[FIFO_BYTES - 1] == _regs[(0x28 + FIFO_BYTES - 1) & 0x7F]);
+	CHECK(!nrf_spi_host_stalls(NRF_SPI0));
+
+	// a disabled block never raises READY
+	ctx.spi_hw->ENABLE = SPI_ENABLE_ENABLE_Disabled;
+	CHECK(spi_xfer_async(&t[0]) == -3);
+	ctx.spi_hw->ENABLE = SPI_ENABLE_ENABLE_Enabled;
+
+	printf("spi async: ordering, framing, data and resubmission ok\n");
+
+	// cost of the engine for fifo bursts, bus time excluded as far as the model allows
+	bytes = nrf_spi_host_bytes(NRF_SPI0);
+	irqs = nrf_spi_host_irqs(NRF_SPI0);
+	start = _now();
+	for (i = 0; i < ROUNDS; i++) {
+		spi_xfer_async(&t[1]);
+		_run_bus();
+	}
+	elapsed = _now() - start;
+	bytes = nrf_spi_host_bytes(NRF_SPI0) - bytes;
+	irqs = nrf_spi_host_irqs(NRF_SPI0) - irqs;
+	printf("  %u-byte fifo burst: %u bytes, %u interrupts per burst\n", FIFO_BYTES, bytes / ROUNDS, irqs / ROUNDS);
+	printf("  blocking spi_xfer spins %u us per burst at 1 Mbps\n", (FIFO_BYTES + 1) * SPI_BYTE_US);
+	printf("  engine plus bus model: %.1f ns per byte, %.2f us per burst on this host\n",
+			elapsed * 1e9 / bytes, elapsed * 1e6 / ROUNDS);
+	return 0;
+}
@@ -0,0 +1,186 @@
+// vi:noet:sw=4 ts=4
+
+// Checks the store and forward ring in pill/timedfifo.c and replays a day of
+// minutes over a link that comes and goes, the way message_time.c drives it
+// with TF_STORE_AND_FORWARD.
+// Build and run from the top level:
+//make host && ./build/host/tf_store_test
+//
+// The link model is coarse: a send either gets through or is lost. Records go
+// full duplex and the ack is morpheus echoing every page, so a record sent
+// while the link is down is never acked and goes again with the next batch.
+// Now and then the last echo is lost after the record got through, the record
+// goes again and the server drops the copy by seq. The broadcast run shows
+// what acking on ANT's own "sent" would lose: it fires with no one listening.
+// Every minute has motion, so every minute is stored.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "timedfifo.h"
+
+#define DAY (24 * 60)
+#define CHECK(x) do { if (!(x)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #x); return 1; } } while (0)
+
+extern int host_uart_quiet;		// tests/host/host_stubs.c
+
+static void
+_store(uint32_t minute)
+{
+	uint8_t payload[10];
+	memset(payload, 0, sizeof(payload));
+	memcpy(payload, &minute, sizeof(minute));
+	TF_StoreMinute(payload, minute);
+}
+
+static uint32_t
+_minute_of(const MotionRecord_t *r)
+{
+	uint32_t minute;
+	memcpy(&minute, r->payload, sizeof(minute));
+	return minute;
+}
+
+// out of range for a stretch every few hours, e.g. the sleeper is away from the sense
+static int
+_link_up(uint32_t minute)
+{
+	return minute % 240 >= 10;
+}
+
+typedef struct {
+	uint32_t delivered;
+	uint32_t sends;
+	uint32_t wakeups;
+	uint32_t copies;	// got through before, the server drops them
+	uint32_t pending;	// never got through, still in the ring at the end of the day
+} sim_t;
+
+static sim_t
+_simulate(uint32_t interval, int broadcast)
+{
+	static uint8_t seen[DAY];
+	MotionRecord_t r;
+	sim_t sim = { 0 };
+	uint32_t minute;
+	uint8_t cursor;
+
+	memset(seen, 0, sizeof(seen));
+	TF_Initialize();
+	for (minute = 1; minute <= DAY; minute++) {
+		uint8_t batch = 0;
+		_store(minute - 1);
+		cursor = 0;
+		// message_time.c: every interval, every minute while there is a backlog
+		if (minute % interval && TF_StoredCount() < TF_CONDENSED_BUFFER_SIZE / 2)
+			continue;
+		sim.wakeups++;
+		while (batch < TF_SEND_BATCH_MAX && TF_GetStored(&cursor, minute, &r)) {
+			batch++;
+			sim.sends++;
+			if (!_link_up(minute)) {
+				if (broadcast)
+					TF_AckStored(r.seq);
+				continue;
+			}
+			// what the server does, the minute is arrival - age
+			if (!seen[minute - r.age]) {
+				seen[minute - r.age] = 1;
+				sim.delivered++;
+			} else {
+				sim.copies++;
+			}
+			// one in 16 records loses its last echo and goes again
+			if (broadcast || sim.sends % 16)
+				TF_AckStored(r.seq);
+		}
+	}
+	cursor = 0;
+	while (TF_GetStored(&cursor, DAY, &r))
+		sim.pending += !seen[DAY - r.age];
+	return sim;
+}
+
+int main()
+{
+	MotionRecord_t r;
+	uint8_t cursor;
+	uint32_t i;
+
+	host_uart_quiet = 1;
+
+	// oldest first, age from the minute stored
+	TF_Initialize();
+	CHECK(TF_StoredCount() == 0);
+	cursor = 0;
+	CHECK(!TF_GetStored(&cursor, 0, &r));
+	for (i = 0; i < 3; i++)
+		_store(100 + i);
+	cursor = 0;
+	for (i = 0; i < 3; i++) {
+		CHECK(TF_GetStored(&cursor, 105, &r));
+		CHECK(r.seq == i && r.age == 5 - i && _minute_of(&r) == 100 + i);
+	}
+	CHECK(!TF_GetStored(&cursor, 105, &r));
+
+	// out of order ack only trims once the older ones are in
+	TF_AckStored(1);
+	CHECK(TF_StoredCount() == 2);
+	cursor = 0;
+	CHECK(TF_GetStored(&cursor, 105, &r) && r.seq == 0);
+	CHECK(TF_GetStored(&cursor, 105, &r) && r.seq == 2);
+	TF_AckStored(0);
+	TF_AckStored(0);	// twice is harmless
+	TF_AckStored(77);	// unknown too
+	CHECK(TF_StoredCount() == 1);
+	cursor = 0;
+	CHECK(TF_GetStored(&cursor, 105, &r) && r.seq == 2);
+	CHECK(!TF_GetStored(&cursor, 105, &r));
+	TF_AckStored(2);
+	CHECK(TF_StoredCount() == 0);
+
+	// a full ring drops the oldest, ages saturate
+	TF_Initialize();
+	for (i = 0; i < TF_CONDENSED_BUFFER_SIZE + 3; i++)
+		_store(i);
+	CHECK(TF_StoredCount() == TF_CONDENSED_BUFFER_SIZE);
+	CHECK(TF_StoredDrops() == 3);
+	cursor = 0;
+	CHECK(TF_GetStored(&cursor, 1000, &r) && _minute_of(&r) == 3 && r.seq == 3 && r.age == 255);
+
+	// seq wraps without confusing the acks
+	TF_Initialize();
+	for (i = 0; i < 300; i++) {
+		_store(i);
+		cursor = 0;
+		CHECK(TF_GetStored(&cursor, i, &r) && _minute_of(&r) == i);
+		TF_AckStored(r.seq);
+		CHECK(TF_StoredCount() == 0);
+	}
+	printf("tf store: order, acks, overflow and wrap ok\n");
+
+	// a day with the link down 10 minutes in every 4 hours, the ring covers
+	// TF_CONDENSED_BUFFER_SIZE - TF_SEND_INTERVAL_MIN minutes
+	{
+		sim_t broadcast = _simulate(TF_SEND_INTERVAL_MIN, 1);
+		sim_t every = _simulate(1, 0), batched = _simulate(TF_SEND_INTERVAL_MIN, 0);
+		uint32_t up = 0, m;
+		for (m = 1; m <= DAY; m++)
+			up += _link_up(m);
+		printf("  link up %u of %u minutes\n", up, DAY);
+		printf("  no store:          %u minutes delivered, %u radio wakeups\n", up, DAY);
+		printf("  send each minute: %u minutes delivered, %u radio wakeups, %u records sent, %u copies\n",
+				every.delivered, every.wakeups, every.sends, every.copies);
+		printf("  every %u minutes:  %u minutes delivered, %u radio wakeups, %u records sent, %u copies\n",
+				TF_SEND_INTERVAL_MIN, batched.delivered, batched.wakeups, batched.sends, batched.copies);
+		printf("  broadcast acks:    %u minutes delivered, %u radio wakeups, %u records sent\n",
+				broadcast.delivered, broadcast.wakeups, broadcast.sends);
+		// acked on sending, a minute sent into an outage is gone
+		CHECK(broadcast.delivered < batched.delivered);
+		// whatever is missing is still in the ring, the day ends with the link down,
+		// a full ring only ever dropped copies that had got through
+		CHECK(every.delivered + every.pending == DAY && batched.delivered + batched.pending == DAY);
+	}
+	return 0;
+}